@@ -0,0 +1,306 @@
+//
+// cnpbayes-fit: fits the batch mixture models to many loci without R.
+//
+//   cnpbayes-fit [options] input.tsv
+//
+// The input is tab-delimited with a header line containing the columns
+// locus, sample, batch, and value (other columns are ignored).  Rows of
+// a locus need not be contiguous.  For every locus, each requested
+// model (SB, MB, SBP, MBP) is fit for each number of components in the
+// range, and three tab-delimited files are written:
+//
+//   <out>.models.tsv  locus, model, k, marginal_lik, loglik, logprior
+//   <out>.modes.tsv   locus, model, k, batch, component, theta, sigma2, p
+//   <out>.probz.tsv   locus, model, sample, component, prob for the
+//                     model with the largest marginal likelihood
+//
+// With --binary, the modes and probz of every model are also written to
+// <out>.cnpb (see src/modelfile.h; read by CNPBayes::readModels).
+//
+// The single-batch models (SB, SBP) ignore the batch column.
+//
+#include "fit.h"
+#include "modelfile.h"
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <map>
+#include <memory>
+#include <sstream>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+namespace {
+
+struct Locus {
+  std::string name ;
+  std::vector<std::string> sample ;
+  std::vector<std::string> batch ;
+  std::vector<double> y ;
+} ;
+
+struct Options {
+  std::vector<std::string> models ;
+  int kmin ;
+  int kmax ;
+  double df ;
+  unsigned int seed ;
+  std::string out ;
+  bool binary ;
+  FitOptions fit ;
+} ;
+
+void usage() {
+  std::cerr <<
+    "usage: cnpbayes-fit [options] input.tsv\n"
+    "  --models SB,MB,SBP,MBP  models to fit (default: all)\n"
+    "  --k MIN:MAX             number of components (default: 1:4)\n"
+    "  --df DF                 t degrees of freedom (default: 100)\n"
+    "  --burnin N              burnin iterations (default: 1000)\n"
+    "  --iter N                saved iterations (default: 1000)\n"
+    "  --thin N                thinning (default: 1)\n"
+    "  --nstarts N             starting values (default: 3)\n"
+    "  --root R                root of the Chib ordinates (default: 0.5)\n"
+    "  --threads N             threads for the starting values (default: 1)\n"
+    "  --seed N                seed (default: 1)\n"
+    "  --out PREFIX            output prefix (default: cnpbayes)\n"
+    "  --binary                also write all models to PREFIX.cnpb\n" ;
+}
+
+std::vector<std::string> split(const std::string& s, char sep) {
+  std::vector<std::string> fields ;
+  std::string field ;
+  std::istringstream in(s) ;
+  while(std::getline(in, field, sep)) fields.push_back(field) ;
+  if(!s.empty() && s[s.size() - 1] == sep) fields.push_back("") ;
+  return fields ;
+}
+
+int column(const std::vector<std::string>& header, const char* name) {
+  for(size_t j = 0; j < header.size(); ++j) if(header[j] == name) return j ;
+  throw std::runtime_error(std::string("input has no column '") + name + "'") ;
+}
+
+std::vector<Locus> read_loci(const char* path) {
+  std::ifstream in(path) ;
+  if(!in) throw std::runtime_error(std::string("cannot open ") + path) ;
+  std::string line ;
+  if(!std::getline(in, line)) throw std::runtime_error("empty input") ;
+  if(!line.empty() && line[line.size() - 1] == '\r') line.erase(line.size() - 1) ;
+  std::vector<std::string> header = split(line, '\t') ;
+  const size_t jl = column(header, "locus") ;
+  const size_t js = column(header, "sample") ;
+  const size_t jb = column(header, "batch") ;
+  const size_t jv = column(header, "value") ;
+  std::vector<Locus> loci ;
+  std::map<std::string, size_t> index ;
+  int lineno = 1 ;
+  while(std::getline(in, line)){
+    ++lineno ;
+    if(!line.empty() && line[line.size() - 1] == '\r') line.erase(line.size() - 1) ;
+    if(line.empty()) continue ;
+    std::vector<std::string> f = split(line, '\t') ;
+    if(f.size() < header.size()){
+      std::ostringstream msg ;
+      msg << "line " << lineno << ": expected " << header.size() << " fields" ;
+      throw std::runtime_error(msg.str()) ;
+    }
+    char* end ;
+    double v = std::strtod(f[jv].c_str(), &end) ;
+    if(end == f[jv].c_str()){
+      std::ostringstream msg ;
+      msg << "line " << lineno << ": value is not numeric" ;
+      throw std::runtime_error(msg.str()) ;
+    }
+    std::map<std::string, size_t>::iterator it = index.find(f[jl]) ;
+    if(it == index.end()){
+      it = index.insert(std::make_pair(f[jl], loci.size())).first ;
+      loci.push_back(Locus()) ;
+      loci.back().name = f[jl] ;
+    }
+    Locus& l = loci[it->second] ;
+    l.sample.push_back(f[js]) ;
+    l.batch.push_back(f[jb]) ;
+    l.y.push_back(v) ;
+  }
+  return loci ;
+}
+
+// batch codes 0, ..., B - 1 in order of appearance; labels in labels
+std::vector<int> batch_codes(const Locus& l, std::vector<std::string>& labels) {
+  std::map<std::string, int> code ;
+  std::vector<int> b(l.y.size()) ;
+  labels.clear() ;
+  for(size_t i = 0; i < l.y.size(); ++i){
+    std::map<std::string, int>::iterator it = code.find(l.batch[i]) ;
+    if(it == code.end()){
+      it = code.insert(std::make_pair(l.batch[i], (int) labels.size())).first ;
+      labels.push_back(l.batch[i]) ;
+    }
+    b[i] = it->second ;
+  }
+  return b ;
+}
+
+Options parse(int argc, char** argv, std::string& input) {
+  Options opt ;
+  opt.models = split("SB,MB,SBP,MBP", ',') ;
+  opt.kmin = 1 ;
+  opt.kmax = 4 ;
+  opt.df = 100.0 ;
+  opt.seed = 1 ;
+  opt.out = "cnpbayes" ;
+  opt.binary = false ;
+  for(int i = 1; i < argc; ++i){
+    std::string a = argv[i] ;
+    if(a == "-h" || a == "--help"){
+      usage() ;
+      std::exit(0) ;
+    }
+    if(a.compare(0, 2, "--") != 0){
+      input = a ;
+      continue ;
+    }
+    if(a == "--binary"){
+      opt.binary = true ;
+      continue ;
+    }
+    if(i + 1 >= argc) throw std::runtime_error("missing value for " + a) ;
+    std::string v = argv[++i] ;
+    if(a == "--models") opt.models = split(v, ',') ;
+    else if(a == "--k"){
+      if(std::sscanf(v.c_str(), "%d:%d", &opt.kmin, &opt.kmax) != 2)
+        opt.kmin = opt.kmax = std::atoi(v.c_str()) ;
+    }
+    else if(a == "--df") opt.df = std::atof(v.c_str()) ;
+    else if(a == "--burnin") opt.fit.burnin = std::atoi(v.c_str()) ;
+    else if(a == "--iter") opt.fit.iter = std::atoi(v.c_str()) ;
+    else if(a == "--thin") opt.fit.thin = std::atoi(v.c_str()) ;
+    else if(a == "--nstarts") opt.fit.nstarts = std::atoi(v.c_str()) ;
+    else if(a == "--root") opt.fit.root = std::atof(v.c_str()) ;
+    else if(a == "--threads") opt.fit.nthreads = std::atoi(v.c_str()) ;
+    else if(a == "--seed") opt.seed = std::strtoul(v.c_str(), NULL, 10) ;
+    else if(a == "--out") opt.out = v ;
+    else throw std::runtime_error("unknown option " + a) ;
+  }
+  if(input.empty()) throw std::runtime_error("no input file") ;
+  if(opt.kmin < 1 || opt.kmax < opt.kmin) throw std::runtime_error("bad range for --k") ;
+  for(size_t m = 0; m < opt.models.size(); ++m){
+    const std::string& nm = opt.models[m] ;
+    if(nm != "SB" && nm != "MB" && nm != "SBP" && nm != "MBP")
+      throw std::runtime_error("unknown model " + nm) ;
+  }
+  return opt ;
+}
+
+ModelRecord record(const std::string& locus, const std::string& model,
+                   const MixtureHyper& h, const FitOptions& opt, const FitResult& fit) {
+  ModelRecord r ;
+  r.locus = locus ;
+  r.model = model ;
+  r.N = fit.N ;
+  r.B = fit.B ;
+  r.K = fit.K ;
+  r.pooled = fit.pooled ;
+  r.hyper = h ;
+  r.iter = opt.iter ;
+  r.burnin = opt.burnin ;
+  r.thin = opt.thin ;
+  r.theta = fit.theta ;
+  r.sigma2 = fit.sigma2 ;
+  r.pi = fit.pi ;
+  r.mu = fit.mu ;
+  r.tau2 = fit.tau2 ;
+  r.nu0 = fit.nu0 ;
+  r.sigma2_0 = fit.sigma2_0 ;
+  r.loglik = fit.loglik ;
+  r.logprior = fit.logprior ;
+  r.marginal = fit.marginal ;
+  r.probz = fit.probz ;
+  return r ;
+}
+
+}
+
+int main(int argc, char** argv) {
+  try {
+    std::string input ;
+    Options opt = parse(argc, argv, input) ;
+    std::vector<Locus> loci = read_loci(input.c_str()) ;
+    // the two seeds of R's standalone generator must be non-zero
+    set_seed(opt.seed + 1u, 2u * opt.seed + 3u) ;
+    std::ofstream models((opt.out + ".models.tsv").c_str()) ;
+    std::ofstream modes((opt.out + ".modes.tsv").c_str()) ;
+    std::ofstream probs((opt.out + ".probz.tsv").c_str()) ;
+    if(!models || !modes || !probs) throw std::runtime_error("cannot write to " + opt.out) ;
+    models.precision(10) ;
+    modes.precision(10) ;
+    probs.precision(6) ;
+    models << "locus\tmodel\tk\tmarginal_lik\tloglik\tlogprior\n" ;
+    modes << "locus\tmodel\tk\tbatch\tcomponent\ttheta\tsigma2\tp\n" ;
+    probs << "locus\tmodel\tsample\tcomponent\tprob\n" ;
+    std::unique_ptr<ModelFileWriter> binary ;
+    if(opt.binary) binary.reset(new ModelFileWriter(opt.out + ".cnpb", CHAIN_DELTA, 8)) ;
+    for(size_t l = 0; l < loci.size(); ++l){
+      const Locus& locus = loci[l] ;
+      std::vector<std::string> labels ;
+      std::vector<int> batch = batch_codes(locus, labels) ;
+      std::vector<int> single(batch.size(), 0) ;
+      FitResult best ;
+      std::string best_name ;
+      bool have_best = false ;
+      for(size_t m = 0; m < opt.models.size(); ++m){
+        const std::string& nm = opt.models[m] ;
+        bool multi = nm == "MB" || nm == "MBP" ;
+        bool pooled = nm == "SBP" || nm == "MBP" ;
+        for(int K = opt.kmin; K <= opt.kmax; ++K){
+          std::ostringstream name ;
+          name << nm << K ;
+          FitResult fit ;
+          MixtureHyper h = default_hyper(K, opt.df) ;
+          try {
+            fit = fit_mixture(locus.y, multi ? batch : single, h, pooled, opt.fit) ;
+          } catch(std::exception& e) {
+            std::cerr << locus.name << " " << name.str() << ": " << e.what() << "\n" ;
+            models << locus.name << "\t" << nm << "\t" << K << "\tNA\tNA\tNA\n" ;
+            continue ;
+          }
+          models << locus.name << "\t" << nm << "\t" << K << "\t" << fit.marginal
+                 << "\t" << fit.loglik << "\t" << fit.logprior << "\n" ;
+          if(binary.get()) binary->add(record(locus.name, name.str(), h, opt.fit, fit), NULL) ;
+          for(int k = 0; k < K; ++k){
+            for(int b = 0; b < fit.B; ++b){
+              double s2 = pooled ? fit.sigma2[b] : fit.sigma2[b + fit.B * k] ;
+              modes << locus.name << "\t" << nm << "\t" << K << "\t"
+                    << (multi ? labels[b] : "all") << "\t" << k + 1 << "\t"
+                    << fit.theta[b + fit.B * k] << "\t" << s2 << "\t"
+                    << fit.pi[k] << "\n" ;
+            }
+          }
+          if(std::isfinite(fit.marginal) &&
+             (!have_best || fit.marginal > best.marginal)){
+            best = fit ;
+            best_name = name.str() ;
+            have_best = true ;
+          }
+        }
+      }
+      if(!have_best) continue ;
+      for(int k = 0; k < best.K; ++k){
+        for(int i = 0; i < best.N; ++i){
+          probs << locus.name << "\t" << best_name << "\t" << locus.sample[i]
+                << "\t" << k + 1 << "\t" << best.probz[i + best.N * k] << "\n" ;
+        }
+      }
+    }
+    if(binary.get()) binary->close() ;
+  } catch(std::exception& e) {
+    std::cerr << "cnpbayes-fit: " << e.what() << "\n" ;
+    usage() ;
+    return 1 ;
+  }
+  return 0 ;
+}
@@ -5,6 +5,81 @@
 
 using namespace Rcpp;
 
+// baf_loglik
+Rcpp::NumericMatrix baf_loglik(Rcpp::NumericMatrix B, Rcpp::NumericVector pb, Rcpp::NumericMatrix shapes, double p_outlier, int nthreads);
+RcppExport SEXP _CNPBayes_baf_loglik(SEXP BSEXP, SEXP pbSEXP, SEXP shapesSEXP, SEXP p_outlierSEXP, SEXP nthreadsSEXP) {
+BEGIN_RCPP
+    Rcpp::RObject rcpp_result_gen;
+    Rcpp::RNGScope rcpp_rngScope_gen;
+    Rcpp::traits::input_parameter< Rcpp::NumericMatrix >::type B(BSEXP);
+    Rcpp::traits::input_parameter< Rcpp::NumericVector >::type pb(pbSEXP);
+    Rcpp::traits::input_parameter< Rcpp::NumericMatrix >::type shapes(shapesSEXP);
+    Rcpp::traits::input_parameter< double >::type p_outlier(p_outlierSEXP);
+    Rcpp::traits::input_parameter< int >::type nthreads(nthreadsSEXP);
+    rcpp_result_gen = Rcpp::wrap(baf_loglik(B, pb, shapes, p_outlier, nthreads));
+    return rcpp_result_gen;
+END_RCPP
+}
+// baf_model_loglik
+Rcpp::NumericVector baf_model_loglik(Rcpp::NumericMatrix L, Rcpp::List probs, Rcpp::List states, double pwr);
+RcppExport SEXP _CNPBayes_baf_model_loglik(SEXP LSEXP, SEXP probsSEXP, SEXP statesSEXP, SEXP pwrSEXP) {
+BEGIN_RCPP
+    Rcpp::RObject rcpp_result_gen;
+    Rcpp::RNGScope rcpp_rngScope_gen;
+    Rcpp::traits::input_parameter< Rcpp::NumericMatrix >::type L(LSEXP);
+    Rcpp::traits::input_parameter< Rcpp::List >::type probs(probsSEXP);
+    Rcpp::traits::input_parameter< Rcpp::List >::type states(statesSEXP);
+    Rcpp::traits::input_parameter< double >::type pwr(pwrSEXP);
+    rcpp_result_gen = Rcpp::wrap(baf_model_loglik(L, probs, states, pwr));
+    return rcpp_result_gen;
+END_RCPP
+}
+// segment_diagnostics
+Rcpp::List segment_diagnostics(Rcpp::List chains, int nsplit, int nthreads);
+RcppExport SEXP _CNPBayes_segment_diagnostics(SEXP chainsSEXP, SEXP nsplitSEXP, SEXP nthreadsSEXP) {
+BEGIN_RCPP
+    Rcpp::RObject rcpp_result_gen;
+    Rcpp::RNGScope rcpp_rngScope_gen;
+    Rcpp::traits::input_parameter< Rcpp::List >::type chains(chainsSEXP);
+    Rcpp::traits::input_parameter< int >::type nsplit(nsplitSEXP);
+    Rcpp::traits::input_parameter< int >::type nthreads(nthreadsSEXP);
+    rcpp_result_gen = Rcpp::wrap(segment_diagnostics(chains, nsplit, nthreads));
+    return rcpp_result_gen;
+END_RCPP
+}
+// chib_blocks
+Rcpp::NumericMatrix chib_blocks(Rcpp::S4 object, bool pooled);
+RcppExport SEXP _CNPBayes_chib_blocks(SEXP objectSEXP, SEXP pooledSEXP) {
+BEGIN_RCPP
+    Rcpp::RObject rcpp_result_gen;
+    Rcpp::RNGScope rcpp_rngScope_gen;
+    Rcpp::traits::input_parameter< Rcpp::S4 >::type object(objectSEXP);
+    Rcpp::traits::input_parameter< bool >::type pooled(pooledSEXP);
+    rcpp_result_gen = Rcpp::wrap(chib_blocks(object, pooled));
+    return rcpp_result_gen;
+END_RCPP
+}
+// fit_native
+Rcpp::List fit_native(Rcpp::NumericVector y, Rcpp::IntegerVector batch, int K, bool pooled, double df, int burnin, int iter, int thin, int nstarts, double root, int nthreads);
+RcppExport SEXP _CNPBayes_fit_native(SEXP ySEXP, SEXP batchSEXP, SEXP KSEXP, SEXP pooledSEXP, SEXP dfSEXP, SEXP burninSEXP, SEXP iterSEXP, SEXP thinSEXP, SEXP nstartsSEXP, SEXP rootSEXP, SEXP nthreadsSEXP) {
+BEGIN_RCPP
+    Rcpp::RObject rcpp_result_gen;
+    Rcpp::RNGScope rcpp_rngScope_gen;
+    Rcpp::traits::input_parameter< Rcpp::NumericVector >::type y(ySEXP);
+    Rcpp::traits::input_parameter< Rcpp::IntegerVector >::type batch(batchSEXP);
+    Rcpp::traits::input_parameter< int >::type K(KSEXP);
+    Rcpp::traits::input_parameter< bool >::type pooled(pooledSEXP);
+    Rcpp::traits::input_parameter< double >::type df(dfSEXP);
+    Rcpp::traits::input_parameter< int >::type burnin(burninSEXP);
+    Rcpp::traits::input_parameter< int >::type iter(iterSEXP);
+    Rcpp::traits::input_parameter< int >::type thin(thinSEXP);
+    Rcpp::traits::input_parameter< int >::type nstarts(nstartsSEXP);
+    Rcpp::traits::input_parameter< double >::type root(rootSEXP);
+    Rcpp::traits::input_parameter< int >::type nthreads(nthreadsSEXP);
+    rcpp_result_gen = Rcpp::wrap(fit_native(y, batch, K, pooled, df, burnin, iter, thin, nstarts, root, nthreads));
+    return rcpp_result_gen;
+END_RCPP
+}
 // getK
 int getK(Rcpp::S4 hyperparams);
 RcppExport SEXP _CNPBayes_getK(SEXP hyperparamsSEXP) {
@@ -180,6 +255,55 @@ BEGIN_RCPP
     return rcpp_result_gen;
 END_RCPP
 }
+// write_model_file
+int write_model_file(std::string path, List records, int encoding, int bits);
+RcppExport SEXP _CNPBayes_write_model_file(SEXP pathSEXP, SEXP recordsSEXP, SEXP encodingSEXP, SEXP bitsSEXP) {
+BEGIN_RCPP
+    Rcpp::RObject rcpp_result_gen;
+    Rcpp::RNGScope rcpp_rngScope_gen;
+    Rcpp::traits::input_parameter< std::string >::type path(pathSEXP);
+    Rcpp::traits::input_parameter< List >::type records(recordsSEXP);
+    Rcpp::traits::input_parameter< int >::type encoding(encodingSEXP);
+    Rcpp::traits::input_parameter< int >::type bits(bitsSEXP);
+    rcpp_result_gen = Rcpp::wrap(write_model_file(path, records, encoding, bits));
+    return rcpp_result_gen;
+END_RCPP
+}
+// model_file_index
+List model_file_index(std::string path);
+RcppExport SEXP _CNPBayes_model_file_index(SEXP pathSEXP) {
+BEGIN_RCPP
+    Rcpp::RObject rcpp_result_gen;
+    Rcpp::RNGScope rcpp_rngScope_gen;
+    Rcpp::traits::input_parameter< std::string >::type path(pathSEXP);
+    rcpp_result_gen = Rcpp::wrap(model_file_index(path));
+    return rcpp_result_gen;
+END_RCPP
+}
+// read_model_file
+List read_model_file(std::string path, IntegerVector i, bool probz, bool chains);
+RcppExport SEXP _CNPBayes_read_model_file(SEXP pathSEXP, SEXP iSEXP, SEXP probzSEXP, SEXP chainsSEXP) {
+BEGIN_RCPP
+    Rcpp::RObject rcpp_result_gen;
+    Rcpp::RNGScope rcpp_rngScope_gen;
+    Rcpp::traits::input_parameter< std::string >::type path(pathSEXP);
+    Rcpp::traits::input_parameter< IntegerVector >::type i(iSEXP);
+    Rcpp::traits::input_parameter< bool >::type probz(probzSEXP);
+    Rcpp::traits::input_parameter< bool >::type chains(chainsSEXP);
+    rcpp_result_gen = Rcpp::wrap(read_model_file(path, i, probz, chains));
+    return rcpp_result_gen;
+END_RCPP
+}
+// sampler_interrupt
+SEXP sampler_interrupt();
+RcppExport SEXP _CNPBayes_sampler_interrupt() {
+BEGIN_RCPP
+    Rcpp::RObject rcpp_result_gen;
+    Rcpp::RNGScope rcpp_rngScope_gen;
+    rcpp_result_gen = Rcpp::wrap(sampler_interrupt());
+    return rcpp_result_gen;
+END_RCPP
+}
 // sample_components
 Rcpp::IntegerVector sample_components(Rcpp::IntegerVector x, int size, Rcpp::NumericVector prob);
 RcppExport SEXP _CNPBayes_sample_components(SEXP xSEXP, SEXP sizeSEXP, SEXP probSEXP) {
@@ -381,24 +505,26 @@ BEGIN_RCPP
 END_RCPP
 }
 // cpp_burnin
-Rcpp::S4 cpp_burnin(Rcpp::S4 object);
-RcppExport SEXP _CNPBayes_cpp_burnin(SEXP objectSEXP) {
+Rcpp::S4 cpp_burnin(Rcpp::S4 object, int start);
+RcppExport SEXP _CNPBayes_cpp_burnin(SEXP objectSEXP, SEXP startSEXP) {
 BEGIN_RCPP
     Rcpp::RObject rcpp_result_gen;
     Rcpp::RNGScope rcpp_rngScope_gen;
     Rcpp::traits::input_parameter< Rcpp::S4 >::type object(objectSEXP);
-    rcpp_result_gen = Rcpp::wrap(cpp_burnin(object));
+    Rcpp::traits::input_parameter< int >::type start(startSEXP);
+    rcpp_result_gen = Rcpp::wrap(cpp_burnin(object, start));
     return rcpp_result_gen;
 END_RCPP
 }
 // cpp_mcmc
-Rcpp::S4 cpp_mcmc(Rcpp::S4 object);
-RcppExport SEXP _CNPBayes_cpp_mcmc(SEXP objectSEXP) {
+Rcpp::S4 cpp_mcmc(Rcpp::S4 object, int start);
+RcppExport SEXP _CNPBayes_cpp_mcmc(SEXP objectSEXP, SEXP startSEXP) {
 BEGIN_RCPP
     Rcpp::RObject rcpp_result_gen;
     Rcpp::RNGScope rcpp_rngScope_gen;
     Rcpp::traits::input_parameter< Rcpp::S4 >::type object(objectSEXP);
-    rcpp_result_gen = Rcpp::wrap(cpp_mcmc(object));
+    Rcpp::traits::input_parameter< int >::type start(startSEXP);
+    rcpp_result_gen = Rcpp::wrap(cpp_mcmc(object, start));
     return rcpp_result_gen;
 END_RCPP
 }
@@ -515,26 +641,28 @@ BEGIN_RCPP
 END_RCPP
 }
 // burnin_multibatch_pvar
-Rcpp::S4 burnin_multibatch_pvar(Rcpp::S4 object, Rcpp::S4 mcmcp);
-RcppExport SEXP _CNPBayes_burnin_multibatch_pvar(SEXP objectSEXP, SEXP mcmcpSEXP) {
+Rcpp::S4 burnin_multibatch_pvar(Rcpp::S4 object, Rcpp::S4 mcmcp, int start);
+RcppExport SEXP _CNPBayes_burnin_multibatch_pvar(SEXP objectSEXP, SEXP mcmcpSEXP, SEXP startSEXP) {
 BEGIN_RCPP
     Rcpp::RObject rcpp_result_gen;
     Rcpp::RNGScope rcpp_rngScope_gen;
     Rcpp::traits::input_parameter< Rcpp::S4 >::type object(objectSEXP);
     Rcpp::traits::input_parameter< Rcpp::S4 >::type mcmcp(mcmcpSEXP);
-    rcpp_result_gen = Rcpp::wrap(burnin_multibatch_pvar(object, mcmcp));
+    Rcpp::traits::input_parameter< int >::type start(startSEXP);
+    rcpp_result_gen = Rcpp::wrap(burnin_multibatch_pvar(object, mcmcp, start));
     return rcpp_result_gen;
 END_RCPP
 }
 // mcmc_multibatch_pvar
-Rcpp::S4 mcmc_multibatch_pvar(Rcpp::S4 object, Rcpp::S4 mcmcp);
-RcppExport SEXP _CNPBayes_mcmc_multibatch_pvar(SEXP objectSEXP, SEXP mcmcpSEXP) {
+Rcpp::S4 mcmc_multibatch_pvar(Rcpp::S4 object, Rcpp::S4 mcmcp, int start);
+RcppExport SEXP _CNPBayes_mcmc_multibatch_pvar(SEXP objectSEXP, SEXP mcmcpSEXP, SEXP startSEXP) {
 BEGIN_RCPP
     Rcpp::RObject rcpp_result_gen;
     Rcpp::RNGScope rcpp_rngScope_gen;
     Rcpp::traits::input_parameter< Rcpp::S4 >::type object(objectSEXP);
     Rcpp::traits::input_parameter< Rcpp::S4 >::type mcmcp(mcmcpSEXP);
-    rcpp_result_gen = Rcpp::wrap(mcmc_multibatch_pvar(object, mcmcp));
+    Rcpp::traits::input_parameter< int >::type start(startSEXP);
+    rcpp_result_gen = Rcpp::wrap(mcmc_multibatch_pvar(object, mcmcp, start));
     return rcpp_result_gen;
 END_RCPP
 }
@@ -810,6 +938,90 @@ BEGIN_RCPP
     return rcpp_result_gen;
 END_RCPP
 }
+// sim_batch_data
+Rcpp::List sim_batch_data(Rcpp::IntegerVector batch, Rcpp::NumericMatrix theta, Rcpp::NumericVector sigma2, Rcpp::NumericVector p, bool pooled, double df, double outlier_prob, Rcpp::NumericVector outlier_range, int nthreads);
+RcppExport SEXP _CNPBayes_sim_batch_data(SEXP batchSEXP, SEXP thetaSEXP, SEXP sigma2SEXP, SEXP pSEXP, SEXP pooledSEXP, SEXP dfSEXP, SEXP outlier_probSEXP, SEXP outlier_rangeSEXP, SEXP nthreadsSEXP) {
+BEGIN_RCPP
+    Rcpp::RObject rcpp_result_gen;
+    Rcpp::RNGScope rcpp_rngScope_gen;
+    Rcpp::traits::input_parameter< Rcpp::IntegerVector >::type batch(batchSEXP);
+    Rcpp::traits::input_parameter< Rcpp::NumericMatrix >::type theta(thetaSEXP);
+    Rcpp::traits::input_parameter< Rcpp::NumericVector >::type sigma2(sigma2SEXP);
+    Rcpp::traits::input_parameter< Rcpp::NumericVector >::type p(pSEXP);
+    Rcpp::traits::input_parameter< bool >::type pooled(pooledSEXP);
+    Rcpp::traits::input_parameter< double >::type df(dfSEXP);
+    Rcpp::traits::input_parameter< double >::type outlier_prob(outlier_probSEXP);
+    Rcpp::traits::input_parameter< Rcpp::NumericVector >::type outlier_range(outlier_rangeSEXP);
+    Rcpp::traits::input_parameter< int >::type nthreads(nthreadsSEXP);
+    rcpp_result_gen = Rcpp::wrap(sim_batch_data(batch, theta, sigma2, p, pooled, df, outlier_prob, outlier_range, nthreads));
+    return rcpp_result_gen;
+END_RCPP
+}
+// sim_trio_data
+Rcpp::List sim_trio_data(Rcpp::IntegerVector batch, Rcpp::NumericMatrix theta, Rcpp::NumericVector sigma2, Rcpp::NumericVector p, Rcpp::NumericVector tensor, double nonmendelian, double df, double outlier_prob, Rcpp::NumericVector outlier_range, int nthreads);
+RcppExport SEXP _CNPBayes_sim_trio_data(SEXP batchSEXP, SEXP thetaSEXP, SEXP sigma2SEXP, SEXP pSEXP, SEXP tensorSEXP, SEXP nonmendelianSEXP, SEXP dfSEXP, SEXP outlier_probSEXP, SEXP outlier_rangeSEXP, SEXP nthreadsSEXP) {
+BEGIN_RCPP
+    Rcpp::RObject rcpp_result_gen;
+    Rcpp::RNGScope rcpp_rngScope_gen;
+    Rcpp::traits::input_parameter< Rcpp::IntegerVector >::type batch(batchSEXP);
+    Rcpp::traits::input_parameter< Rcpp::NumericMatrix >::type theta(thetaSEXP);
+    Rcpp::traits::input_parameter< Rcpp::NumericVector >::type sigma2(sigma2SEXP);
+    Rcpp::traits::input_parameter< Rcpp::NumericVector >::type p(pSEXP);
+    Rcpp::traits::input_parameter< Rcpp::NumericVector >::type tensor(tensorSEXP);
+    Rcpp::traits::input_parameter< double >::type nonmendelian(nonmendelianSEXP);
+    Rcpp::traits::input_parameter< double >::type df(dfSEXP);
+    Rcpp::traits::input_parameter< double >::type outlier_prob(outlier_probSEXP);
+    Rcpp::traits::input_parameter< Rcpp::NumericVector >::type outlier_range(outlier_rangeSEXP);
+    Rcpp::traits::input_parameter< int >::type nthreads(nthreadsSEXP);
+    rcpp_result_gen = Rcpp::wrap(sim_trio_data(batch, theta, sigma2, p, tensor, nonmendelian, df, outlier_prob, outlier_range, nthreads));
+    return rcpp_result_gen;
+END_RCPP
+}
+// init_starts
+Rcpp::List init_starts(Rcpp::NumericVector y, Rcpp::IntegerVector batch, int K, int nstarts, int ncandidates, int em_iter, double df, bool pooled, int nthreads);
+RcppExport SEXP _CNPBayes_init_starts(SEXP ySEXP, SEXP batchSEXP, SEXP KSEXP, SEXP nstartsSEXP, SEXP ncandidatesSEXP, SEXP em_iterSEXP, SEXP dfSEXP, SEXP pooledSEXP, SEXP nthreadsSEXP) {
+BEGIN_RCPP
+    Rcpp::RObject rcpp_result_gen;
+    Rcpp::RNGScope rcpp_rngScope_gen;
+    Rcpp::traits::input_parameter< Rcpp::NumericVector >::type y(ySEXP);
+    Rcpp::traits::input_parameter< Rcpp::IntegerVector >::type batch(batchSEXP);
+    Rcpp::traits::input_parameter< int >::type K(KSEXP);
+    Rcpp::traits::input_parameter< int >::type nstarts(nstartsSEXP);
+    Rcpp::traits::input_parameter< int >::type ncandidates(ncandidatesSEXP);
+    Rcpp::traits::input_parameter< int >::type em_iter(em_iterSEXP);
+    Rcpp::traits::input_parameter< double >::type df(dfSEXP);
+    Rcpp::traits::input_parameter< bool >::type pooled(pooledSEXP);
+    Rcpp::traits::input_parameter< int >::type nthreads(nthreadsSEXP);
+    rcpp_result_gen = Rcpp::wrap(init_starts(y, batch, K, nstarts, ncandidates, em_iter, df, pooled, nthreads));
+    return rcpp_result_gen;
+END_RCPP
+}
+// ks_merge_batches
+Rcpp::List ks_merge_batches(Rcpp::NumericVector x, Rcpp::IntegerVector batch, double THR, int nthreads);
+RcppExport SEXP _CNPBayes_ks_merge_batches(SEXP xSEXP, SEXP batchSEXP, SEXP THRSEXP, SEXP nthreadsSEXP) {
+BEGIN_RCPP
+    Rcpp::RObject rcpp_result_gen;
+    Rcpp::RNGScope rcpp_rngScope_gen;
+    Rcpp::traits::input_parameter< Rcpp::NumericVector >::type x(xSEXP);
+    Rcpp::traits::input_parameter< Rcpp::IntegerVector >::type batch(batchSEXP);
+    Rcpp::traits::input_parameter< double >::type THR(THRSEXP);
+    Rcpp::traits::input_parameter< int >::type nthreads(nthreadsSEXP);
+    rcpp_result_gen = Rcpp::wrap(ks_merge_batches(x, batch, THR, nthreads));
+    return rcpp_result_gen;
+END_RCPP
+}
+// ks_two_sample
+Rcpp::NumericVector ks_two_sample(Rcpp::NumericVector x, Rcpp::NumericVector y);
+RcppExport SEXP _CNPBayes_ks_two_sample(SEXP xSEXP, SEXP ySEXP) {
+BEGIN_RCPP
+    Rcpp::RObject rcpp_result_gen;
+    Rcpp::RNGScope rcpp_rngScope_gen;
+    Rcpp::traits::input_parameter< Rcpp::NumericVector >::type x(xSEXP);
+    Rcpp::traits::input_parameter< Rcpp::NumericVector >::type y(ySEXP);
+    rcpp_result_gen = Rcpp::wrap(ks_two_sample(x, y));
+    return rcpp_result_gen;
+END_RCPP
+}
 // family_member
 Rcpp::CharacterVector family_member(Rcpp::S4 object);
 RcppExport SEXP _CNPBayes_family_member(SEXP objectSEXP) {
@@ -1078,15 +1290,29 @@ BEGIN_RCPP
     return rcpp_result_gen;
 END_RCPP
 }
+// update_trios
+Rcpp::S4 update_trios(Rcpp::S4 xmod, int nthreads);
+RcppExport SEXP _CNPBayes_update_trios(SEXP xmodSEXP, SEXP nthreadsSEXP) {
+BEGIN_RCPP
+    Rcpp::RObject rcpp_result_gen;
+    Rcpp::RNGScope rcpp_rngScope_gen;
+    Rcpp::traits::input_parameter< Rcpp::S4 >::type xmod(xmodSEXP);
+    Rcpp::traits::input_parameter< int >::type nthreads(nthreadsSEXP);
+    rcpp_result_gen = Rcpp::wrap(update_trios(xmod, nthreads));
+    return rcpp_result_gen;
+END_RCPP
+}
 // trios_burnin
-Rcpp::S4 trios_burnin(Rcpp::S4 object, Rcpp::S4 mcmcp);
-RcppExport SEXP _CNPBayes_trios_burnin(SEXP objectSEXP, SEXP mcmcpSEXP) {
+Rcpp::S4 trios_burnin(Rcpp::S4 object, Rcpp::S4 mcmcp, int nthreads, int start);
+RcppExport SEXP _CNPBayes_trios_burnin(SEXP objectSEXP, SEXP mcmcpSEXP, SEXP nthreadsSEXP, SEXP startSEXP) {
 BEGIN_RCPP
     Rcpp::RObject rcpp_result_gen;
     Rcpp::RNGScope rcpp_rngScope_gen;
     Rcpp::traits::input_parameter< Rcpp::S4 >::type object(objectSEXP);
     Rcpp::traits::input_parameter< Rcpp::S4 >::type mcmcp(mcmcpSEXP);
-    rcpp_result_gen = Rcpp::wrap(trios_burnin(object, mcmcp));
+    Rcpp::traits::input_parameter< int >::type nthreads(nthreadsSEXP);
+    Rcpp::traits::input_parameter< int >::type start(startSEXP);
+    rcpp_result_gen = Rcpp::wrap(trios_burnin(object, mcmcp, nthreads, start));
     return rcpp_result_gen;
 END_RCPP
 }
@@ -1102,14 +1328,16 @@ BEGIN_RCPP
 END_RCPP
 }
 // trios_mcmc
-Rcpp::S4 trios_mcmc(Rcpp::S4 object, Rcpp::S4 mcmcp);
-RcppExport SEXP _CNPBayes_trios_mcmc(SEXP objectSEXP, SEXP mcmcpSEXP) {
+Rcpp::S4 trios_mcmc(Rcpp::S4 object, Rcpp::S4 mcmcp, int nthreads, int start);
+RcppExport SEXP _CNPBayes_trios_mcmc(SEXP objectSEXP, SEXP mcmcpSEXP, SEXP nthreadsSEXP, SEXP startSEXP) {
 BEGIN_RCPP
     Rcpp::RObject rcpp_result_gen;
     Rcpp::RNGScope rcpp_rngScope_gen;
     Rcpp::traits::input_parameter< Rcpp::S4 >::type object(objectSEXP);
     Rcpp::traits::input_parameter< Rcpp::S4 >::type mcmcp(mcmcpSEXP);
-    rcpp_result_gen = Rcpp::wrap(trios_mcmc(object, mcmcp));
+    Rcpp::traits::input_parameter< int >::type nthreads(nthreadsSEXP);
+    Rcpp::traits::input_parameter< int >::type start(startSEXP);
+    rcpp_result_gen = Rcpp::wrap(trios_mcmc(object, mcmcp, nthreads, start));
     return rcpp_result_gen;
 END_RCPP
 }
@@ -1127,6 +1355,11 @@ END_RCPP
 }
 
 static const R_CallMethodDef CallEntries[] = {
+    {"_CNPBayes_baf_loglik", (DL_FUNC) &_CNPBayes_baf_loglik, 5},
+    {"_CNPBayes_baf_model_loglik", (DL_FUNC) &_CNPBayes_baf_model_loglik, 4},
+    {"_CNPBayes_segment_diagnostics", (DL_FUNC) &_CNPBayes_segment_diagnostics, 3},
+    {"_CNPBayes_chib_blocks", (DL_FUNC) &_CNPBayes_chib_blocks, 2},
+    {"_CNPBayes_fit_native", (DL_FUNC) &_CNPBayes_fit_native, 11},
     {"_CNPBayes_getK", (DL_FUNC) &_CNPBayes_getK, 1},
     {"_CNPBayes_getDf", (DL_FUNC) &_CNPBayes_getDf, 1},
     {"_CNPBayes_unique_batch", (DL_FUNC) &_CNPBayes_unique_batch, 1},
@@ -1142,6 +1375,10 @@ static const R_CallMethodDef CallEntries[] = {
     {"_CNPBayes_compute_heavy_sums_batch", (DL_FUNC) &_CNPBayes_compute_heavy_sums_batch, 1},
     {"_CNPBayes_compute_heavy_means_batch", (DL_FUNC) &_CNPBayes_compute_heavy_means_batch, 1},
     {"_CNPBayes_log_ddirichlet_", (DL_FUNC) &_CNPBayes_log_ddirichlet_, 2},
+    {"_CNPBayes_write_model_file", (DL_FUNC) &_CNPBayes_write_model_file, 4},
+    {"_CNPBayes_model_file_index", (DL_FUNC) &_CNPBayes_model_file_index, 1},
+    {"_CNPBayes_read_model_file", (DL_FUNC) &_CNPBayes_read_model_file, 4},
+    {"_CNPBayes_sampler_interrupt", (DL_FUNC) &_CNPBayes_sampler_interrupt, 0},
     {"_CNPBayes_sample_components", (DL_FUNC) &_CNPBayes_sample_components, 3},
     {"_CNPBayes_compute_loglik", (DL_FUNC) &_CNPBayes_compute_loglik, 1},
     {"_CNPBayes_update_mu", (DL_FUNC) &_CNPBayes_update_mu, 1},
@@ -1160,8 +1397,8 @@ static const R_CallMethodDef CallEntries[] = {
     {"_CNPBayes_update_sigma2", (DL_FUNC) &_CNPBayes_update_sigma2, 1},
     {"_CNPBayes_update_predictive", (DL_FUNC) &_CNPBayes_update_predictive, 1},
     {"_CNPBayes_update_probz", (DL_FUNC) &_CNPBayes_update_probz, 1},
-    {"_CNPBayes_cpp_burnin", (DL_FUNC) &_CNPBayes_cpp_burnin, 1},
-    {"_CNPBayes_cpp_mcmc", (DL_FUNC) &_CNPBayes_cpp_mcmc, 1},
+    {"_CNPBayes_cpp_burnin", (DL_FUNC) &_CNPBayes_cpp_burnin, 2},
+    {"_CNPBayes_cpp_mcmc", (DL_FUNC) &_CNPBayes_cpp_mcmc, 2},
     {"_CNPBayes_sample_componentsP", (DL_FUNC) &_CNPBayes_sample_componentsP, 3},
     {"_CNPBayes_update_predictiveP", (DL_FUNC) &_CNPBayes_update_predictiveP, 1},
     {"_CNPBayes_loglik_multibatch_pvar", (DL_FUNC) &_CNPBayes_loglik_multibatch_pvar, 1},
@@ -1172,8 +1409,8 @@ static const R_CallMethodDef CallEntries[] = {
     {"_CNPBayes_stagetwo_multibatch_pvar", (DL_FUNC) &_CNPBayes_stagetwo_multibatch_pvar, 1},
     {"_CNPBayes_theta_multibatch_pvar", (DL_FUNC) &_CNPBayes_theta_multibatch_pvar, 1},
     {"_CNPBayes_sigma2_multibatch_pvar", (DL_FUNC) &_CNPBayes_sigma2_multibatch_pvar, 1},
-    {"_CNPBayes_burnin_multibatch_pvar", (DL_FUNC) &_CNPBayes_burnin_multibatch_pvar, 2},
-    {"_CNPBayes_mcmc_multibatch_pvar", (DL_FUNC) &_CNPBayes_mcmc_multibatch_pvar, 2},
+    {"_CNPBayes_burnin_multibatch_pvar", (DL_FUNC) &_CNPBayes_burnin_multibatch_pvar, 3},
+    {"_CNPBayes_mcmc_multibatch_pvar", (DL_FUNC) &_CNPBayes_mcmc_multibatch_pvar, 3},
     {"_CNPBayes_log_prob_theta", (DL_FUNC) &_CNPBayes_log_prob_theta, 2},
     {"_CNPBayes_marginal_theta_batch", (DL_FUNC) &_CNPBayes_marginal_theta_batch, 1},
     {"_CNPBayes_log_prob_sigma2", (DL_FUNC) &_CNPBayes_log_prob_sigma2, 2},
@@ -1198,6 +1435,11 @@ static const R_CallMethodDef CallEntries[] = {
     {"_CNPBayes_log_prob_nu0p", (DL_FUNC) &_CNPBayes_log_prob_nu0p, 2},
     {"_CNPBayes_reduced_nu0_pooled", (DL_FUNC) &_CNPBayes_reduced_nu0_pooled, 1},
     {"_CNPBayes_log_prob_s20p", (DL_FUNC) &_CNPBayes_log_prob_s20p, 1},
+    {"_CNPBayes_sim_batch_data", (DL_FUNC) &_CNPBayes_sim_batch_data, 9},
+    {"_CNPBayes_sim_trio_data", (DL_FUNC) &_CNPBayes_sim_trio_data, 10},
+    {"_CNPBayes_init_starts", (DL_FUNC) &_CNPBayes_init_starts, 9},
+    {"_CNPBayes_ks_merge_batches", (DL_FUNC) &_CNPBayes_ks_merge_batches, 4},
+    {"_CNPBayes_ks_two_sample", (DL_FUNC) &_CNPBayes_ks_two_sample, 2},
     {"_CNPBayes_family_member", (DL_FUNC) &_CNPBayes_family_member, 1},
     {"_CNPBayes_lookup_mprobs", (DL_FUNC) &_CNPBayes_lookup_mprobs, 3},
     {"_CNPBayes_update_trioPr", (DL_FUNC) &_CNPBayes_update_trioPr, 1},
@@ -1222,9 +1464,10 @@ static const R_CallMethodDef CallEntries[] = {
     {"_CNPBayes_update_sigma22", (DL_FUNC) &_CNPBayes_update_sigma22, 1},
     {"_CNPBayes_sample_trio_components", (DL_FUNC) &_CNPBayes_sample_trio_components, 3},
     {"_CNPBayes_predictive_trios", (DL_FUNC) &_CNPBayes_predictive_trios, 1},
-    {"_CNPBayes_trios_burnin", (DL_FUNC) &_CNPBayes_trios_burnin, 2},
+    {"_CNPBayes_update_trios", (DL_FUNC) &_CNPBayes_update_trios, 2},
+    {"_CNPBayes_trios_burnin", (DL_FUNC) &_CNPBayes_trios_burnin, 4},
     {"_CNPBayes_test_trio", (DL_FUNC) &_CNPBayes_test_trio, 1},
-    {"_CNPBayes_trios_mcmc", (DL_FUNC) &_CNPBayes_trios_mcmc, 2},
+    {"_CNPBayes_trios_mcmc", (DL_FUNC) &_CNPBayes_trios_mcmc, 4},
     {"_CNPBayes_z2cn", (DL_FUNC) &_CNPBayes_z2cn, 2},
     {NULL, NULL, 0}
 };
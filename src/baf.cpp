@@ -0,0 +1,134 @@
+#include "baf.h"
+#include <Rmath.h>
+#include <cmath>
+#include <limits>
+#include <vector>
+#include <algorithm>
+#ifdef _OPENMP
+#include <omp.h>
+#endif
+
+using namespace Rcpp ;
+
+BafMixture::BafMixture(const Rcpp::NumericMatrix& shapes, double p_outlier) :
+  p_outlier(p_outlier) {
+  if(shapes.nrow() != 8 || shapes.ncol() != 2)
+    stop("shapes must be the 8 x 2 matrix from shapeParams()") ;
+  for(int g = 0; g < 8; ++g){
+    a[g] = shapes(g, 0) ;
+    b[g] = shapes(g, 1) ;
+    lconst[g] = -R::lbeta(a[g], b[g]) ;
+  }
+}
+
+double BafMixture::ldens(double x, int g) const {
+  if(x < 0 || x > 1) return -std::numeric_limits<double>::infinity() ;
+  double l = lconst[g] ;
+  // skip the terms with unit shape so that x = 0 and x = 1 are handled
+  // as in dbeta
+  if(a[g] != 1) l += (a[g] - 1) * log(x) ;
+  if(b[g] != 1) l += (b[g] - 1) * log1p(-x) ;
+  return l ;
+}
+
+void BafMixture::loglik(double x, double pb, double* ll) const {
+  enum { NUL, BB, AA, AB, AAB, ABB, AAAB, ABBB } ;
+  double d[8] ;
+  for(int g = 0; g < 8; ++g) d[g] = exp(ldens(x, g)) ;
+  double p = pb ;
+  double q = 1 - pb ;
+  double p2 = p * p ;
+  double q2 = q * q ;
+  double w = 1 - p_outlier ;
+  ll[0] = log(d[NUL]) ;
+  ll[1] = log(p_outlier + w * (q * d[AA] + p * d[BB])) ;
+  ll[2] = log(p_outlier + w * (q2 * d[AA] + p2 * d[BB] + 2 * p * q * d[AB])) ;
+  ll[3] = log(p_outlier + w * (q2 * q * d[AA] + 3 * q2 * p * d[AAB] +
+                               3 * q * p2 * d[ABB] + p2 * p * d[BB])) ;
+  ll[4] = log(p_outlier + w * (q2 * q2 * d[AA] + 4 * q2 * q * p * d[AAAB] +
+                               6 * q2 * p2 * d[AB] + 4 * q * p2 * p * d[ABBB] +
+                               p2 * p2 * d[BB])) ;
+}
+
+//
+// Log likelihood of the BAFs of each sample under copy numbers 0, ..., 4:
+// the sum over SNPs (rows of B) of the log beta-mixture density, with
+// pb the B allele frequency of each SNP.  Missing BAFs are skipped.
+// Samples are processed in parallel; returns a samples x 5 matrix.
+//
+// [[Rcpp::export]]
+Rcpp::NumericMatrix baf_loglik(Rcpp::NumericMatrix B, Rcpp::NumericVector pb,
+                               Rcpp::NumericMatrix shapes,
+                               double p_outlier = 1e-4, int nthreads = 1) {
+  const int S = B.nrow() ;
+  const int N = B.ncol() ;
+  if(pb.size() != S) stop("pb must have one element per SNP (row of B)") ;
+  BafMixture mix(shapes, p_outlier) ;
+  NumericMatrix L(N, BAF_MAX_CN + 1) ;
+  const double* x = B.begin() ;
+  const double* p = pb.begin() ;
+  double* out = L.begin() ;
+#ifdef _OPENMP
+#pragma omp parallel for schedule(static) num_threads(std::max(1, nthreads))
+#endif
+  for(int j = 0; j < N; ++j){
+    double sum[BAF_MAX_CN + 1] = {0} ;
+    double ll[BAF_MAX_CN + 1] ;
+    const double* xj = x + (size_t) S * j ;
+    for(int i = 0; i < S; ++i){
+      if(ISNAN(xj[i])) continue ;
+      mix.loglik(xj[i], p[i], ll) ;
+      for(int c = 0; c <= BAF_MAX_CN; ++c) sum[c] += ll[c] ;
+    }
+    for(int c = 0; c <= BAF_MAX_CN; ++c) out[j + N * c] = sum[c] ;
+  }
+  return L ;
+}
+
+//
+// Scores candidate mappings of components to copy number.  L is the
+// samples x 5 matrix from baf_loglik.  For candidate m, probs[[m]] is
+// the samples x C matrix of copy number probabilities and states[[m]]
+// the C copy numbers of its columns.  The score is
+//
+//   sum_j log( sum_c P(j, c) * exp(pwr * L(j, state_c)) )
+//
+// computed on the log scale.
+//
+// [[Rcpp::export]]
+Rcpp::NumericVector baf_model_loglik(Rcpp::NumericMatrix L, Rcpp::List probs,
+                                     Rcpp::List states, double pwr = 0.1) {
+  const int N = L.nrow() ;
+  const int M = probs.size() ;
+  if(states.size() != M) stop("probs and states must be the same length") ;
+  NumericVector score(M) ;
+  for(int m = 0; m < M; ++m){
+    NumericMatrix P = probs[m] ;
+    IntegerVector cn = states[m] ;
+    const int C = cn.size() ;
+    if(P.nrow() != N || P.ncol() != C)
+      stop("each element of probs must be a samples x (number of states) matrix") ;
+    for(int c = 0; c < C; ++c){
+      if(cn[c] < 0 || cn[c] > BAF_MAX_CN)
+        stop("copy number states must be in 0, ..., 4") ;
+    }
+    double total = 0.0 ;
+    std::vector<double> t(C) ;
+    for(int j = 0; j < N; ++j){
+      double mx = R_NegInf ;
+      for(int c = 0; c < C; ++c){
+        t[c] = log(P(j, c)) + pwr * L(j, cn[c]) ;
+        if(t[c] > mx) mx = t[c] ;
+      }
+      if(mx == R_NegInf){
+        total = R_NegInf ;
+        break ;
+      }
+      double s = 0.0 ;
+      for(int c = 0; c < C; ++c) s += exp(t[c] - mx) ;
+      total += mx + log(s) ;
+    }
+    score[m] = total ;
+  }
+  return score ;
+}
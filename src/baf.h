@@ -0,0 +1,30 @@
+#ifndef _baf_H
+#define _baf_H
+#include <Rcpp.h>
+
+//
+// Beta-mixture likelihoods of B allele frequencies for copy numbers
+// 0, ..., 4 (see genotype_cnps.R).  Given the population frequency p of
+// the B allele, copy number c has genotypes with 0, ..., c B alleles and
+// binomial(c, p) genotype frequencies; each genotype has a beta density
+// for the BAF.  Copy number 0 is uniform.
+//
+// Rows of the shape matrix are in the order of shapeParams():
+// null, allB, zeroB, balanced, one-thirdB, two-thirdsB, one-fourthB,
+// three-fourthsB.
+//
+const int BAF_MAX_CN = 4 ;
+
+class BafMixture {
+  double a[8] ;
+  double b[8] ;
+  double lconst[8] ;  // -log(beta(a, b))
+  double p_outlier ;
+  double ldens(double x, int g) const ;
+public:
+  BafMixture(const Rcpp::NumericMatrix& shapes, double p_outlier) ;
+  // log density of x for copy numbers 0, ..., BAF_MAX_CN
+  void loglik(double x, double pb, double* ll) const ;
+} ;
+
+#endif
@@ -0,0 +1,192 @@
+#include "chains.h"
+#include <cmath>
+#include <algorithm>
+#ifdef _OPENMP
+#include <omp.h>
+#endif
+
+using namespace Rcpp ;
+
+double ess_ar(const double* x, int n) {
+  if(n < 2) return 0.0 ;
+  double mean = 0.0 ;
+  for(int i = 0; i < n; ++i) mean += x[i] ;
+  mean /= n ;
+  std::vector<double> d(n) ;
+  for(int i = 0; i < n; ++i) d[i] = x[i] - mean ;
+  // residuals of the regression on the iteration: a chain that is
+  // constant or linear has no spectral density (all.equal(sd, 0))
+  const double tbar = (n + 1) / 2.0 ;
+  double stt = 0.0 ;
+  double sty = 0.0 ;
+  for(int i = 0; i < n; ++i){
+    stt += (i + 1 - tbar) * (i + 1 - tbar) ;
+    sty += (i + 1 - tbar) * d[i] ;
+  }
+  const double slope = sty / stt ;
+  double rss = 0.0 ;
+  for(int i = 0; i < n; ++i){
+    double e = d[i] - slope * (i + 1 - tbar) ;
+    rss += e * e ;
+  }
+  if(sqrt(rss / (n - 1)) <= 1.5e-8) return 0.0 ;
+  // autocovariances (divisor n) up to ar's default maximum order
+  const int pmax = (int) std::floor(std::min(n - 1.0, 10.0 * log10((double) n))) ;
+  std::vector<double> r(pmax + 1) ;
+  for(int t = 0; t <= pmax; ++t){
+    double g = 0.0 ;
+    for(int i = 0; i + t < n; ++i) g += d[i] * d[i + t] ;
+    r[t] = g / n ;
+  }
+  // Durbin-Levinson recursion: coefficients and innovation variances
+  // of the AR(1), ..., AR(pmax) fits, keeping the order with the
+  // smallest AIC n log(v) + 2 p
+  std::vector<double> phi(pmax + 1, 0.0), prev(pmax + 1, 0.0), best ;
+  double v = r[0] ;
+  double aic = n * log(v) ;
+  int order = 0 ;
+  double vbest = v ;
+  for(int l = 1; l <= pmax; ++l){
+    double num = r[l] ;
+    for(int j = 1; j < l; ++j) num -= prev[j] * r[l - j] ;
+    const double a = num / v ;
+    phi[l] = a ;
+    for(int j = 1; j < l; ++j) phi[j] = prev[j] - a * prev[l - j] ;
+    v *= (1.0 - a * a) ;
+    const double aic_l = n * log(v) + 2.0 * l ;
+    if(aic_l < aic){
+      aic = aic_l ;
+      order = l ;
+      vbest = v ;
+      best.assign(phi.begin() + 1, phi.begin() + l + 1) ;
+    }
+    prev = phi ;
+  }
+  const double var_pred = vbest * n / (n - (order + 1.0)) ;
+  double sum_ar = 0.0 ;
+  for(size_t j = 0; j < best.size(); ++j) sum_ar += best[j] ;
+  const double spec = var_pred / ((1.0 - sum_ar) * (1.0 - sum_ar)) ;
+  // var(x) with divisor n - 1
+  const double var = r[0] * n / (n - 1.0) ;
+  return n * var / spec ;
+}
+
+//
+// chains is a list with one element per chain; each element is a list
+// of parameter blocks with the same dimensions for every chain.  Each
+// chain is divided into nsplit segments of floor(iter / nsplit) rows.
+// Segments with missing values are excluded.
+//
+// Returns the effective sample size of each parameter summed over the
+// segments (as coda::effectiveSize for an mcmc.list), and the within-
+// (W) and between-segment (B) covariance matrices of the parameters
+// used by the Gelman-Rubin diagnostics: W is the mean of the segment
+// covariance matrices and B is n times the covariance matrix of the
+// segment means, where n is the length of a segment.  The segment
+// means and variances (M x P) are returned for the degrees of freedom
+// of coda::gelman.diag.
+//
+// [[Rcpp::export]]
+Rcpp::List segment_diagnostics(Rcpp::List chains, int nsplit = 2, int nthreads = 1) {
+  const int C = chains.size() ;
+  if(C < 1) stop("no chains") ;
+  if(nsplit < 1) nsplit = 1 ;
+  // columns of each chain, and the number of rows
+  std::vector< std::vector<ChainColumn> > cols(C) ;
+  // blocks coerced to double must outlive the column pointers
+  std::vector<NumericVector> store ;
+  int iter = -1 ;
+  for(int c = 0; c < C; ++c){
+    List blocks = chains[c] ;
+    for(int j = 0; j < blocks.size(); ++j){
+      NumericVector b = blocks[j] ;
+      store.push_back(b) ;
+      int nr = b.size() ;
+      int nc = 1 ;
+      if(Rf_isMatrix(b)){
+        nr = Rf_nrows(b) ;
+        nc = Rf_ncols(b) ;
+      }
+      if(iter < 0) iter = nr ;
+      if(nr != iter) stop("chains must have the same number of iterations") ;
+      for(int l = 0; l < nc; ++l){
+        ChainColumn col = {b.begin() + (R_xlen_t) l * nr} ;
+        cols[c].push_back(col) ;
+      }
+    }
+    if(cols[c].size() != cols[0].size()) stop("chains must have the same parameters") ;
+  }
+  const int P = cols[0].size() ;
+  const int n = iter / nsplit ;
+  // segments without missing values
+  std::vector<ChainSegment> segs ;
+  for(int c = 0; c < C; ++c){
+    for(int s = 0; s < nsplit; ++s){
+      ChainSegment seg = {c, s * n} ;
+      bool ok = n > 0 ;
+      for(int j = 0; j < P && ok; ++j){
+        const double* x = cols[c][j].x + seg.start ;
+        for(int i = 0; i < n && ok; ++i) ok = !ISNAN(x[i]) ;
+      }
+      if(ok) segs.push_back(seg) ;
+    }
+  }
+  const int M = segs.size() ;
+  NumericVector ess(P) ;
+  NumericMatrix means(M, P) ;
+  NumericMatrix vars(M, P) ;
+#ifdef _OPENMP
+#pragma omp parallel for schedule(dynamic) num_threads(nthreads)
+#endif
+  for(int j = 0; j < P; ++j){
+    double total = 0.0 ;
+    for(int m = 0; m < M; ++m){
+      const double* x = cols[segs[m].chain][j].x + segs[m].start ;
+      double mean = 0.0 ;
+      for(int i = 0; i < n; ++i) mean += x[i] ;
+      mean /= n ;
+      double ss = 0.0 ;
+      for(int i = 0; i < n; ++i) ss += (x[i] - mean) * (x[i] - mean) ;
+      means(m, j) = mean ;
+      vars(m, j) = n > 1 ? ss / (n - 1) : NA_REAL ;
+      total += ess_ar(x, n) ;
+    }
+    ess[j] = total ;
+  }
+  NumericMatrix W(P, P) ;
+  NumericMatrix B(P, P) ;
+  if(M > 1 && n > 1){
+#ifdef _OPENMP
+#pragma omp parallel for schedule(dynamic) num_threads(nthreads)
+#endif
+    for(int j = 0; j < P; ++j){
+      for(int l = 0; l <= j; ++l){
+        double w = 0.0 ;
+        double mj = 0.0 ;
+        double ml = 0.0 ;
+        for(int m = 0; m < M; ++m){
+          const double* x = cols[segs[m].chain][j].x + segs[m].start ;
+          const double* y = cols[segs[m].chain][l].x + segs[m].start ;
+          double s = 0.0 ;
+          for(int i = 0; i < n; ++i) s += (x[i] - means(m, j)) * (y[i] - means(m, l)) ;
+          w += s / (n - 1) ;
+          mj += means(m, j) ;
+          ml += means(m, l) ;
+        }
+        mj /= M ;
+        ml /= M ;
+        double b = 0.0 ;
+        for(int m = 0; m < M; ++m) b += (means(m, j) - mj) * (means(m, l) - ml) ;
+        W(j, l) = W(l, j) = w / M ;
+        B(j, l) = B(l, j) = n * b / (M - 1) ;
+      }
+    }
+  }
+  return List::create(Named("ess") = ess,
+                      Named("W") = W,
+                      Named("B") = B,
+                      Named("means") = means,
+                      Named("vars") = vars,
+                      Named("niter") = n,
+                      Named("nchain") = M) ;
+}
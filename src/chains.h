@@ -0,0 +1,33 @@
+#ifndef _chains_H
+#define _chains_H
+#include <Rcpp.h>
+#include <vector>
+
+//
+// Convergence diagnostics computed in place on the chains of several
+// models.  A chain is a list of parameter blocks (numeric matrices or
+// vectors with one row per saved iteration); the columns of the blocks,
+// in order, are the parameters.  Each chain is divided into segments of
+// equal length (halves by default, as in mcmcList), and a segment is
+// described by the chain and its first row -- the draws are not copied
+// or bound together.
+//
+struct ChainSegment {
+  int chain ;
+  int start ;
+} ;
+
+struct ChainColumn {
+  const double* x ;  // first row of the column
+} ;
+
+//
+// Effective sample size of x[0], ..., x[n - 1] as in coda::effectiveSize:
+// n var(x) / S(0), where the spectral density at zero S(0) is that of an
+// autoregressive model fit by Yule-Walker with the order chosen by AIC
+// (coda::spectrum0.ar with stats::ar defaults).  Zero for a sequence
+// that is constant or linear in the iteration.
+//
+double ess_ar(const double* x, int n) ;
+
+#endif
@@ -0,0 +1,62 @@
+#include "chib.h"
+
+using namespace Rcpp ;
+
+template <class V, class L>
+static NumericMatrix chib_kernel(const MixtureState& s, const MixtureHyper& h,
+                                 List modes, int S, SamplerProfile* prof) {
+  typedef ChibEstimator<V, L> Chib ;
+  typename Chib::Star star ;
+  NumericVector theta = modes["theta"] ;
+  NumericVector sigma2 = modes["sigma2"] ;
+  NumericVector p = modes["mixprob"] ;
+  NumericVector mu = modes["mu"] ;
+  NumericVector tau2 = modes["tau2"] ;
+  star.theta.assign(theta.begin(), theta.end()) ;
+  star.sigma2.assign(sigma2.begin(), sigma2.end()) ;
+  star.pi.assign(p.begin(), p.end()) ;
+  star.mu.assign(mu.begin(), mu.end()) ;
+  star.tau2.assign(tau2.begin(), tau2.end()) ;
+  star.nu0 = as<int>(modes["nu0"]) ;
+  star.sigma2_0 = as<double>(modes["sigma2.0"]) ;
+  std::vector<double> logp ;
+  Chib::reduced_gibbs(s, h, star, S, logp, prof) ;
+  NumericMatrix out(S, CHIB_BLOCKS) ;
+  std::copy(logp.begin(), logp.end(), out.begin()) ;
+  return out ;
+}
+
+//
+// Log posterior ordinates of the reduced Gibbs samplers for Chib's
+// estimator (see chib.h): an iter x 7 matrix with columns theta,
+// sigma2, pi, mu, tau2, nu0, and s20.  The model is expected to hold
+// its modal values (useModes); iter is taken from the McmcParams.  With
+// McmcParams(profile=TRUE), the timings of the reduced samplers are
+// returned in the attribute 'profile' (see SamplerProfile::add_to).
+//
+// [[Rcpp::export]]
+Rcpp::NumericMatrix chib_blocks(Rcpp::S4 object, bool pooled) {
+  RNGScope scope ;
+  Rcpp::S4 mcmcp(object.slot("mcmc.params")) ;
+  int S = mcmcp.slot("iter") ;
+  List modes = object.slot("modes") ;
+  MixtureHyper h = hyper_from_model(object) ;
+  MixtureState s = state_from_model<double>(object, pooled) ;
+  bool normal = h.df >= NORMAL_LIMIT_DF ;
+  SamplerProfile prof(profiling(mcmcp)) ;
+  NumericMatrix logp ;
+  if(pooled){
+    if(normal) logp = chib_kernel<PooledVariance, NormalLimit>(s, h, modes, S, &prof) ;
+    else logp = chib_kernel<PooledVariance, StudentT>(s, h, modes, S, &prof) ;
+  } else if(s.B == 1){
+    if(normal) logp = chib_kernel<SingleBatchVariance, NormalLimit>(s, h, modes, S, &prof) ;
+    else logp = chib_kernel<SingleBatchVariance, StudentT>(s, h, modes, S, &prof) ;
+  } else {
+    if(normal) logp = chib_kernel<ComponentVariance, NormalLimit>(s, h, modes, S, &prof) ;
+    else logp = chib_kernel<ComponentVariance, StudentT>(s, h, modes, S, &prof) ;
+  }
+  colnames(logp) = CharacterVector::create("theta", "sigma2", "pi", "mu",
+                                           "tau2", "nu0", "s20") ;
+  if(prof.enabled) logp.attr("profile") = prof.add_to(List(), "chib") ;
+  return logp ;
+}
@@ -0,0 +1,254 @@
+#ifndef _chib_H
+#define _chib_H
+#include "sampler.h"
+#include <vector>
+#include <cmath>
+#include <algorithm>
+
+//
+// Chib's (1995) estimator of the marginal likelihood of a batch
+// t-mixture from the modal ordinates theta*, sigma2*, pi*, mu*, tau2*,
+// nu.0*, and sigma2.0*:
+//
+//   log p(y) = log p(y | *) + log p(*) - sum_j log p(block j* | y, blocks < j)
+//              + log K!
+//
+// The posterior ordinate of each block is averaged over a reduced Gibbs
+// run in which the earlier blocks are fixed at their modal ordinates.
+// Every run starts from the same state: the modal parameters with the z
+// and u of the model.  The ordinates of tau2 and sigma2.0 do not depend
+// on the remaining free parameters and are evaluated once.  Each
+// average is computed as log(mean(p^root)), where root < 1 reduces the
+// influence of extreme ordinates (see mlParams).
+//
+// The reduced samplers are those of marginal_theta_batch,
+// reduced_sigma_batch, ..., with the variance structure and likelihood
+// of MixtureSampler.
+//
+const int CHIB_BLOCKS = 7 ;
+
+template <class V, class L, class Real = double>
+class ChibEstimator {
+public:
+  typedef BasicMixtureState<Real> State ;
+  typedef MixtureSampler<V, L, Real> Sampler ;
+
+  // modal ordinates; the state passed to reduced_gibbs holds them
+  struct Star {
+    std::vector<double> theta ;
+    std::vector<double> sigma2 ;
+    std::vector<double> pi ;
+    std::vector<double> mu ;
+    std::vector<double> tau2 ;
+    int nu0 ;
+    double sigma2_0 ;
+  } ;
+
+  static double log_theta(const State& s, const MixtureHyper& h, const Star& star) {
+    const int B = s.B ;
+    double total = 0.0 ;
+    for(int k = 0; k < s.K; ++k){
+      double tau2_tilde = 1.0 / s.tau2[k] ;
+      for(int b = 0; b < B; ++b){
+        const int j = b + B * k ;
+        double sigma2_tilde = 1.0 / s.sigma2[variance_index<V>(b, k, B)] ;
+        double heavyn = s.sum_u[j] / h.df ;
+        double post_prec = tau2_tilde + heavyn * sigma2_tilde ;
+        double w1 = tau2_tilde / post_prec ;
+        double w2 = heavyn * sigma2_tilde / post_prec ;
+        double heavy_mean = s.sum_uy[j] / heavyn / h.df ;
+        double mu_n = w1 * s.mu[k] + w2 * heavy_mean ;
+        total += R::dnorm(star.theta[j], mu_n, std::sqrt(1.0 / post_prec), 1) ;
+      }
+    }
+    return total ;
+  }
+
+  static double log_sigma2(const State& s, const MixtureHyper& h, const Star& star) {
+    const int B = s.B ;
+    const int nv = star.sigma2.size() ;
+    std::vector<double> ss(nv, 0.0) ;
+    std::vector<double> nn(nv, 0.0) ;
+    for(int i = 0; i < s.N; ++i){
+      int b = batch_index<V>(s, i) ;
+      double r = s.y[i] - star.theta[b + B * s.z[i]] ;
+      ss[variance_index<V>(b, s.z[i], B)] += s.u[i] * r * r ;
+    }
+    for(int k = 0; k < s.K; ++k){
+      for(int b = 0; b < B; ++b) nn[variance_index<V>(b, k, B)] += s.n[b + B * k] ;
+    }
+    double total = 0.0 ;
+    for(int v = 0; v < nv; ++v){
+      double nu_n = s.nu0 + nn[v] ;
+      double sigma2_n = 1.0 / nu_n * (s.nu0 * s.sigma2_0 + ss[v] / h.df) ;
+      double shape = 0.5 * nu_n ;
+      double rate = shape * sigma2_n ;
+      total += R::dgamma(1.0 / star.sigma2[v], shape, 1.0 / rate, 1) ;
+    }
+    return total ;
+  }
+
+  // log Dirichlet density of pi* given the component counts
+  static double log_pi(const State& s, const MixtureHyper& h, const Star& star) {
+    double asum = 0.0 ;
+    double total = 0.0 ;
+    for(int k = 0; k < s.K; ++k){
+      double a = h.alpha[k] + s.zfreq[k] ;
+      asum += a ;
+      total += (a - 1.0) * std::log(star.pi[k]) - R::lgammafn(a) ;
+    }
+    return total + R::lgammafn(asum) ;
+  }
+
+  static double log_mu(const State& s, const MixtureHyper& h, const Star& star) {
+    const int B = s.B ;
+    double tau2_0_tilde = 1.0 / h.tau2_0 ;
+    double total = 0.0 ;
+    for(int k = 0; k < s.K; ++k){
+      double tau2_tilde = 1.0 / s.tau2[k] ;
+      double tau2_B_tilde = tau2_0_tilde + B * tau2_tilde ;
+      double w1 = tau2_0_tilde / tau2_B_tilde ;
+      double w2 = B * tau2_tilde / tau2_B_tilde ;
+      double n_k = 0.0 ;
+      double colsumtheta = 0.0 ;
+      for(int b = 0; b < B; ++b){
+        colsumtheta += s.n[b + B * k] * star.theta[b + B * k] ;
+        n_k += s.n[b + B * k] ;
+      }
+      double mu_n = w1 * h.mu0 + w2 * colsumtheta / n_k ;
+      total += R::dnorm(star.mu[k], mu_n, std::sqrt(1.0 / tau2_B_tilde), 1) ;
+    }
+    return total ;
+  }
+
+  static double log_tau2(int B, int K, const MixtureHyper& h, const Star& star) {
+    double eta_B = h.eta0 + B ;
+    double total = 0.0 ;
+    for(int k = 0; k < K; ++k){
+      double s2_k = 0.0 ;
+      for(int b = 0; b < B; ++b){
+        double d = star.theta[b + B * k] - star.mu[k] ;
+        s2_k += d * d ;
+      }
+      double m2_k = 1.0 / eta_B * (h.eta0 * h.m2_0 + s2_k) ;
+      total += R::dgamma(1.0 / star.tau2[k], 0.5 * eta_B,
+                         1.0 / (0.5 * eta_B * m2_k), 1) ;
+    }
+    return total ;
+  }
+
+  static double log_nu0(const State& s, const MixtureHyper& h, const Star& star) {
+    double prec = 0.0 ;
+    double lprec = 0.0 ;
+    for(size_t v = 0; v < star.sigma2.size(); ++v){
+      prec += 1.0 / star.sigma2[v] ;
+      lprec += std::log(1.0 / star.sigma2[v]) ;
+    }
+    const Nu0Grid& grid = nu0_grid(h.nu0_max) ;
+    return grid.log_prob(star.nu0, s.B * s.K, s.sigma2_0, prec, lprec, h.beta) ;
+  }
+
+  static double log_sigma20(int B, int K, const MixtureHyper& h, const Star& star) {
+    double prec = 0.0 ;
+    for(size_t v = 0; v < star.sigma2.size(); ++v) prec += 1.0 / star.sigma2[v] ;
+    double shape ;
+    double rate ;
+    sigma20_conditional(h.a, h.b, B * K, star.nu0, prec, shape, rate) ;
+    return R::dgamma(star.sigma2_0, shape, 1.0 / rate, 1) ;
+  }
+
+  //
+  // S x CHIB_BLOCKS log ordinates, column-major, in the order theta,
+  // sigma2, pi, mu, tau2, nu.0, sigma2.0.  start holds the modal
+  // ordinates and is not modified.  With an enabled prof, the updates
+  // are timed and the evaluation of the ordinates is charged to loglik.
+  //
+  static void reduced_gibbs(const State& start, const MixtureHyper& h,
+                            const Star& star, int S, std::vector<double>& logp,
+                            SamplerProfile* prof = NULL) {
+    logp.assign(S * CHIB_BLOCKS, 0.0) ;
+    for(int block = 0; block < CHIB_BLOCKS; ++block){
+      double* lp = &logp[S * block] ;
+      if(block == 4){
+        std::fill(lp, lp + S, log_tau2(start.B, start.K, h, star)) ;
+        continue ;
+      }
+      if(block == 6){
+        std::fill(lp, lp + S, log_sigma20(start.B, start.K, h, star)) ;
+        continue ;
+      }
+      State s(start) ;
+      for(int iter = 0; iter < S; ++iter){
+        {
+          ProfileTimer t(prof, PROF_Z) ;
+          Sampler::update_z(s, h) ;
+          Sampler::tabulate(s) ;
+        }
+        if(block < 1){
+          ProfileTimer t(prof, PROF_THETA) ;
+          Sampler::update_theta(s, h) ;
+        }
+        if(block < 2){
+          ProfileTimer t(prof, PROF_SIGMA2) ;
+          Sampler::update_sigma2(s, h) ;
+        }
+        if(block < 4){
+          {
+            ProfileTimer t(prof, PROF_MU) ;
+            Sampler::update_mu(s, h) ;
+          }
+          ProfileTimer t(prof, PROF_TAU2) ;
+          Sampler::update_tau2(s, h) ;
+        }
+        { ProfileTimer t(prof, PROF_SIGMA20) ; Sampler::update_sigma20(s, h) ; }
+        { ProfileTimer t(prof, PROF_NU0) ; Sampler::update_nu0(s, h) ; }
+        if(block < 3){
+          ProfileTimer t(prof, PROF_PI) ;
+          Sampler::update_p(s, h) ;
+        }
+        {
+          ProfileTimer t(prof, PROF_U) ;
+          Sampler::update_u(s, h) ;
+          Sampler::tabulate(s) ;
+        }
+        ProfileTimer t(prof, PROF_LOGLIK) ;
+        switch(block){
+        case 0: lp[iter] = log_theta(s, h, star) ; break ;
+        case 1: lp[iter] = log_sigma2(s, h, star) ; break ;
+        case 2: lp[iter] = log_pi(s, h, star) ; break ;
+        case 3: lp[iter] = log_mu(s, h, star) ; break ;
+        default: lp[iter] = log_nu0(s, h, star) ;
+        }
+      }
+    }
+  }
+
+  // log(mean(exp(root * x))) without overflow; NaNs are ignored
+  static double log_mean_root(const double* x, int S, double root) {
+    double m = R_NegInf ;
+    int n = 0 ;
+    for(int i = 0; i < S; ++i){
+      if(ISNAN(x[i])) continue ;
+      m = std::max(m, root * x[i]) ;
+      ++n ;
+    }
+    if(n == 0) return NA_REAL ;
+    if(!std::isfinite(m)) return m ;
+    double total = 0.0 ;
+    for(int i = 0; i < S; ++i){
+      if(!ISNAN(x[i])) total += std::exp(root * x[i] - m) ;
+    }
+    return m + std::log(total / n) ;
+  }
+
+  static double log_marginal(const std::vector<double>& logp, int S, double root,
+                             int K, double loglik, double logprior) {
+    double pstar = 0.0 ;
+    for(int block = 0; block < CHIB_BLOCKS; ++block){
+      pstar += log_mean_root(&logp[S * block], S, root) ;
+    }
+    return loglik + logprior - pstar + R::lgammafn(K + 1.0) ;
+  }
+} ;
+
+#endif
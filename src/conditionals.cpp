@@ -0,0 +1,107 @@
+#include "conditionals.h"
+#include <map>
+#include <cmath>
+
+Nu0Grid::Nu0Grid(int G) : G_(G), c_(G) {
+  for(int i = 0; i < G; ++i){
+    double half = 0.5 * (i + 1) ;
+    c_[i] = half * log(half) - R::lgammafn(half) ;
+  }
+}
+
+//
+// log p(nu.0=x | ...) = n * (x/2*log(sigma2.0*x/2) - lgamma(x/2))
+//                      + (x/2 - 1)*sum(log(1/sigma2))
+//                      - x*(beta + sigma2.0/2*sum(1/sigma2))
+//
+// n is the number of variance parameters (B*K for the batch model)
+//
+void Nu0Grid::log_conditional(double n, double sigma2_0, double prec,
+                              double lprec, double beta,
+                              std::vector<double>& lp) const {
+  lp.resize(G_) ;
+  double ls20 = log(sigma2_0) ;
+  double slope = beta + 0.5 * sigma2_0 * prec ;
+  for(int i = 0; i < G_; ++i){
+    double x = i + 1.0 ;
+    lp[i] = n * (0.5 * x * ls20 + c_[i]) + (0.5 * x - 1.0) * lprec - x * slope ;
+  }
+}
+
+int Nu0Grid::sample(double n, double sigma2_0, double prec,
+                    double lprec, double beta) const {
+  return sample(n, sigma2_0, prec, lprec, beta, R::unif_rand()) ;
+}
+
+int Nu0Grid::sample(double n, double sigma2_0, double prec,
+                    double lprec, double beta, double unif) const {
+  std::vector<double> lp ;
+  log_conditional(n, sigma2_0, prec, lprec, beta, lp) ;
+  double maxlp = lp[0] ;
+  for(int i = 1; i < G_; ++i) if(lp[i] > maxlp) maxlp = lp[i] ;
+  // subtract the maximum before exponentiating to avoid overflow
+  double total = 0.0 ;
+  for(int i = 0; i < G_; ++i){
+    lp[i] = exp(lp[i] - maxlp) ;
+    total += lp[i] ;
+  }
+  double u = unif * total ;
+  double cumprob = 0.0 ;
+  for(int i = 0; i < G_; ++i){
+    cumprob += lp[i] ;
+    if(u < cumprob) return i + 1 ;
+  }
+  return G_ ;
+}
+
+double Nu0Grid::log_prob(int nu0star, double n, double sigma2_0, double prec,
+                         double lprec, double beta) const {
+  if(nu0star < 1 || nu0star > G_) return R_NegInf ;
+  std::vector<double> lp ;
+  log_conditional(n, sigma2_0, prec, lprec, beta, lp) ;
+  double maxlp = lp[0] ;
+  for(int i = 1; i < G_; ++i) if(lp[i] > maxlp) maxlp = lp[i] ;
+  double total = 0.0 ;
+  for(int i = 0; i < G_; ++i) total += exp(lp[i] - maxlp) ;
+  return lp[nu0star - 1] - maxlp - log(total) ;
+}
+
+//
+// The cache is shared by all samplers; lookups and insertions are
+// serialized so that samplers running in parallel threads can use it.
+// Inserting into a std::map does not move the other grids, so the
+// returned reference stays valid.
+//
+const Nu0Grid& nu0_grid(int G) {
+  static std::map<int, Nu0Grid> grids ;
+  const Nu0Grid* grid ;
+#ifdef _OPENMP
+#pragma omp critical(nu0_grid_cache)
+#endif
+  {
+    std::map<int, Nu0Grid>::iterator it = grids.find(G) ;
+    if(it == grids.end()){
+      it = grids.insert(std::make_pair(G, Nu0Grid(G))).first ;
+    }
+    grid = &it->second ;
+  }
+  return *grid ;
+}
+
+#ifndef CNPBAYES_STANDALONE
+int getNu0Max(Rcpp::S4 hyperparams) {
+  if(!hyperparams.hasSlot("nu0_max")) return 100 ;
+  Rcpp::IntegerVector G = hyperparams.slot("nu0_max") ;
+  if(G.size() == 0 || G[0] < 1) return 100 ;
+  return G[0] ;
+}
+#endif
+
+//
+// sigma2.0 ~ gamma(a + n/2*nu.0, rate=b + nu.0/2*sum(1/sigma2))
+//
+void sigma20_conditional(double a, double b, double n, double nu0,
+                         double prec, double& shape, double& rate) {
+  shape = a + 0.5 * n * nu0 ;
+  rate = b + 0.5 * nu0 * prec ;
+}
@@ -0,0 +1,51 @@
+#ifndef _conditionals_H
+#define _conditionals_H
+#include "rmath.h"
+#include <vector>
+
+//
+// Full conditionals for the hyperparameters of the inverse-gamma
+// sampling distribution of the variances: nu.0 and sigma2.0.
+//
+// The conditional for nu.0 is evaluated on the grid 1, ..., G.  Terms
+// that depend only on the grid (lgamma(x/2), x/2*log(x/2)) are
+// tabulated once per grid size and shared by the batch, pooled, and
+// trio samplers and by the reduced Gibbs samplers used for the
+// marginal likelihood.
+//
+class Nu0Grid {
+public:
+  explicit Nu0Grid(int G) ;
+  int size() const { return G_ ; }
+  // log p(nu.0 = x | ...) up to a constant for x = 1, ..., G
+  void log_conditional(double n, double sigma2_0, double prec,
+                       double lprec, double beta,
+                       std::vector<double>& lp) const ;
+  // draw nu.0 by inverse-CDF on the log-scale probabilities
+  int sample(double n, double sigma2_0, double prec,
+             double lprec, double beta) const ;
+  // the same, given a uniform draw on (0, 1)
+  int sample(double n, double sigma2_0, double prec,
+             double lprec, double beta, double unif) const ;
+  // normalized log p(nu.0 = nu0star | ...)
+  double log_prob(int nu0star, double n, double sigma2_0, double prec,
+                  double lprec, double beta) const ;
+private:
+  int G_ ;
+  std::vector<double> c_ ; // x/2*log(x/2) - lgamma(x/2)
+} ;
+
+// cached grid for a given maximum value of nu.0; safe to call from
+// parallel threads
+const Nu0Grid& nu0_grid(int G) ;
+
+#ifndef CNPBAYES_STANDALONE
+// maximum value of nu.0 (slot 'nu0_max'; 100 for older objects)
+int getNu0Max(Rcpp::S4 hyperparams) ;
+#endif
+
+// shape and rate of the gamma conditional for sigma2.0
+void sigma20_conditional(double a, double b, double n, double nu0,
+                         double prec, double& shape, double& rate) ;
+
+#endif
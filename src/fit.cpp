@@ -0,0 +1,230 @@
+#include "fit.h"
+#include "starts.h"
+#include "chib.h"
+#include "rng.h"
+#include <stdexcept>
+
+MixtureHyper default_hyper(int K, double df) {
+  MixtureHyper h ;
+  h.K = K ;
+  h.mu0 = 0.0 ;
+  h.tau2_0 = 0.4 ;
+  h.eta0 = 32.0 ;
+  h.m2_0 = 0.5 ;
+  h.beta = 0.1 ;
+  h.a = 1.8 ;
+  h.b = 6.0 ;
+  h.df = df ;
+  h.nu0_max = 100 ;
+  h.alpha.assign(K, 1.0) ;
+  return h ;
+}
+
+namespace {
+
+//
+// State at a starting value, as .set_start: mu and tau2 are the means
+// and variances of theta across batches (tau2 is 10 * var(y) for a
+// single batch), nu.0 and sigma2.0 are those of modelValues2, and u is
+// drawn from its prior.
+//
+MixtureState state_from_start(const std::vector<double>& y, const std::vector<int>& batch,
+                              int B, int K, const StartState& start, const MixtureHyper& h) {
+  MixtureState s ;
+  s.N = y.size() ;
+  s.B = B ;
+  s.K = K ;
+  s.y = y ;
+  s.batch = batch ;
+  s.z = start.z ;
+  s.theta = start.theta ;
+  s.sigma2 = start.sigma2 ;
+  s.pi = start.p ;
+  double ybar = 0.0 ;
+  for(int i = 0; i < s.N; ++i) ybar += y[i] ;
+  ybar /= s.N ;
+  double vy = 0.0 ;
+  for(int i = 0; i < s.N; ++i) vy += (y[i] - ybar) * (y[i] - ybar) ;
+  vy = s.N > 1 ? vy / (s.N - 1) : 1.0 ;
+  s.mu.resize(K) ;
+  s.tau2.resize(K) ;
+  for(int k = 0; k < K; ++k){
+    double m = 0.0 ;
+    for(int b = 0; b < B; ++b) m += s.theta[b + B * k] ;
+    m /= B ;
+    double v = 0.0 ;
+    for(int b = 0; b < B; ++b){
+      double d = s.theta[b + B * k] - m ;
+      v += d * d ;
+    }
+    v = B > 1 ? v / (B - 1) : 0.0 ;
+    s.mu[k] = m ;
+    s.tau2[k] = std::isfinite(v) && v > 0.0 ? v : 10.0 * vy ;
+  }
+  s.nu0 = 3.5 ;
+  s.sigma2_0 = 0.25 ;
+  s.constraint = 0.0 ;
+  s.counter = 0 ;
+  s.u.resize(s.N) ;
+  for(int i = 0; i < s.N; ++i) s.u[i] = R::rchisq(h.df) ;
+  return s ;
+}
+
+template <class V, class L>
+void run_fit(const std::vector<double>& y, const std::vector<int>& batch, int B,
+             const MixtureHyper& h, const FitOptions& opt,
+             const std::vector<StartState>& starts, FitResult& fit) {
+  typedef MixtureSampler<V, L> Sampler ;
+  typedef ChibEstimator<V, L> Chib ;
+  const int K = h.K ;
+  //
+  // burnin from each start; keep the chain with the largest log likelihood
+  //
+  MixtureState best ;
+  double best_ll = R_NegInf ;
+  for(size_t j = 0; j < starts.size(); ++j){
+    MixtureState s = state_from_start(y, batch, B, K, starts[j], h) ;
+    if(L::normal) Sampler::update_u(s, h) ;
+    Sampler::tabulate(s) ;
+    for(int i = 0; i < opt.burnin; ++i) Sampler::sweep(s, h) ;
+    double ll = Sampler::loglik(s, h) ;
+    if(j == 0 || (std::isfinite(ll) && (!std::isfinite(best_ll) || ll > best_ll))){
+      best = s ;
+      best_ll = ll ;
+    }
+  }
+  MixtureState& s = best ;
+  //
+  // MCMC
+  //
+  const int N = s.N ;
+  std::vector<int> probz(N * K, 0) ;
+  MixtureMode<double> mode ;
+  for(int iter = 0; iter < opt.iter; ++iter){
+    Sampler::sweep(s, h, &probz[0]) ;
+    mode.update(s, Sampler::loglik(s, h), Sampler::logprior(s, h)) ;
+    for(int t = 1; t < opt.thin; ++t) Sampler::sweep(s, h) ;
+  }
+  fit.N = N ;
+  fit.B = B ;
+  fit.K = K ;
+  fit.pooled = V::pooled ;
+  fit.theta = mode.state.theta ;
+  fit.sigma2 = mode.state.sigma2 ;
+  fit.pi = mode.state.pi ;
+  fit.mu = mode.state.mu ;
+  fit.tau2 = mode.state.tau2 ;
+  fit.nu0 = mode.state.nu0 ;
+  fit.sigma2_0 = mode.state.sigma2_0 ;
+  fit.loglik = mode.loglik ;
+  fit.logprior = mode.logprior ;
+  fit.probz.resize(N * K) ;
+  for(int j = 0; j < N * K; ++j) fit.probz[j] = double(probz[j]) / opt.iter ;
+  //
+  // Chib's estimator from the modes, with z updated given the modal
+  // parameters (useModes)
+  //
+  typename Chib::Star star ;
+  star.theta = mode.state.theta ;
+  star.sigma2 = mode.state.sigma2 ;
+  star.pi = mode.state.pi ;
+  star.mu = mode.state.mu ;
+  star.tau2 = mode.state.tau2 ;
+  star.nu0 = (int) mode.state.nu0 ;
+  star.sigma2_0 = mode.state.sigma2_0 ;
+  s.theta = star.theta ;
+  s.sigma2 = star.sigma2 ;
+  s.pi = star.pi ;
+  s.tau2 = star.tau2 ;
+  s.nu0 = star.nu0 ;
+  s.sigma2_0 = star.sigma2_0 ;
+  Sampler::update_z(s, h) ;
+  Sampler::tabulate(s) ;
+  std::vector<double> logp ;
+  Chib::reduced_gibbs(s, h, star, opt.iter, logp) ;
+  fit.marginal = Chib::log_marginal(logp, opt.iter, opt.root, K,
+                                    fit.loglik, fit.logprior) ;
+}
+
+}
+
+FitResult fit_mixture(const std::vector<double>& y, const std::vector<int>& batch,
+                      const MixtureHyper& h, bool pooled, const FitOptions& opt) {
+  const int N = y.size() ;
+  if(N < 1) throw std::invalid_argument("no data") ;
+  if((int) batch.size() != N) throw std::invalid_argument("y and batch must be the same length") ;
+  if(opt.iter < 1) throw std::invalid_argument("iter must be positive") ;
+  int B = 0 ;
+  for(int i = 0; i < N; ++i) if(batch[i] + 1 > B) B = batch[i] + 1 ;
+  const uint64_t seed = substream_seed() ;
+  std::vector<StartState> starts =
+    find_starts(&y[0], &batch[0], N, h.K, opt.nstarts, opt.ncandidates,
+                opt.em_iter, h.df, pooled, opt.nthreads, seed) ;
+  FitResult fit ;
+  bool normal = h.df >= NORMAL_LIMIT_DF ;
+  if(pooled){
+    if(normal) run_fit<PooledVariance, NormalLimit>(y, batch, B, h, opt, starts, fit) ;
+    else run_fit<PooledVariance, StudentT>(y, batch, B, h, opt, starts, fit) ;
+  } else if(B == 1){
+    if(normal) run_fit<SingleBatchVariance, NormalLimit>(y, batch, B, h, opt, starts, fit) ;
+    else run_fit<SingleBatchVariance, StudentT>(y, batch, B, h, opt, starts, fit) ;
+  } else {
+    if(normal) run_fit<ComponentVariance, NormalLimit>(y, batch, B, h, opt, starts, fit) ;
+    else run_fit<ComponentVariance, StudentT>(y, batch, B, h, opt, starts, fit) ;
+  }
+  return fit ;
+}
+
+#ifndef CNPBAYES_STANDALONE
+//
+// fit_mixture for one locus from R; batch contains integer codes 1, ..., B.
+// Returns the modes, probz (N x K), and the log marginal likelihood.
+//
+// [[Rcpp::export]]
+Rcpp::List fit_native(Rcpp::NumericVector y, Rcpp::IntegerVector batch, int K,
+                      bool pooled = false, double df = 100,
+                      int burnin = 1000, int iter = 1000, int thin = 1,
+                      int nstarts = 3, double root = 0.5, int nthreads = 1) {
+  using namespace Rcpp ;
+  RNGScope scope ;
+  const int N = y.size() ;
+  if(batch.size() != N) stop("y and batch must be the same length") ;
+  std::vector<int> b0(N) ;
+  for(int i = 0; i < N; ++i){
+    if(batch[i] < 1) stop("batch codes must be positive integers") ;
+    b0[i] = batch[i] - 1 ;
+  }
+  FitOptions opt ;
+  opt.burnin = burnin ;
+  opt.iter = iter ;
+  opt.thin = thin ;
+  opt.nstarts = nstarts ;
+  opt.root = root ;
+  opt.nthreads = nthreads ;
+  std::vector<double> yy(y.begin(), y.end()) ;
+  FitResult fit = fit_mixture(yy, b0, default_hyper(K, df), pooled, opt) ;
+  NumericMatrix theta(fit.B, K) ;
+  std::copy(fit.theta.begin(), fit.theta.end(), theta.begin()) ;
+  NumericMatrix probz(N, K) ;
+  std::copy(fit.probz.begin(), fit.probz.end(), probz.begin()) ;
+  SEXP sigma2 ;
+  if(pooled){
+    sigma2 = wrap(fit.sigma2) ;
+  } else {
+    NumericMatrix s2(fit.B, K) ;
+    std::copy(fit.sigma2.begin(), fit.sigma2.end(), s2.begin()) ;
+    sigma2 = s2 ;
+  }
+  return List::create(Named("theta") = theta,
+                      Named("sigma2") = sigma2,
+                      Named("p") = wrap(fit.pi),
+                      Named("mu") = wrap(fit.mu),
+                      Named("tau2") = wrap(fit.tau2),
+                      Named("nu0") = fit.nu0,
+                      Named("sigma2.0") = fit.sigma2_0,
+                      Named("loglik") = fit.loglik,
+                      Named("logprior") = fit.logprior,
+                      Named("probz") = probz,
+                      Named("marginal") = fit.marginal) ;
+}
+#endif
@@ -0,0 +1,64 @@
+#ifndef _fit_H
+#define _fit_H
+#include "sampler.h"
+#include <vector>
+#include <string>
+#include <stdint.h>
+
+//
+// Fit of one batch mixture model without R: starting values (starts.h),
+// burnin, MCMC, and Chib's estimate of the marginal likelihood
+// (chib.h).  This is the driver of the command-line fitter (inst/cli);
+// the R interface runs the same kernels through the S4 models.
+//
+// Each of the nstarts starting values is run through the burnin and the
+// chain with the largest log likelihood at the end of the burnin is
+// continued for iter saved iterations.
+//
+struct FitOptions {
+  int burnin ;
+  int iter ;
+  int thin ;
+  int nstarts ;
+  int ncandidates ;
+  int em_iter ;
+  double root ;    // exponent of the reduced Gibbs ordinates (mlParams)
+  int nthreads ;   // for the starting values
+  FitOptions() : burnin(1000), iter(1000), thin(1), nstarts(3),
+                 ncandidates(20), em_iter(20), root(0.5), nthreads(1) {}
+} ;
+
+//
+// Modes and posterior probabilities.  theta is B x K column-major,
+// sigma2 is B x K (length B if pooled), and probz is N x K with the
+// components ordered by their mean in the first batch.
+//
+struct FitResult {
+  int N ;
+  int B ;
+  int K ;
+  bool pooled ;
+  std::vector<double> theta ;
+  std::vector<double> sigma2 ;
+  std::vector<double> pi ;
+  std::vector<double> mu ;
+  std::vector<double> tau2 ;
+  double nu0 ;
+  double sigma2_0 ;
+  double loglik ;
+  double logprior ;
+  std::vector<double> probz ;
+  double marginal ;
+} ;
+
+// default hyperparameters of HyperparametersMultiBatch(k=K, dfr=df)
+MixtureHyper default_hyper(int K, double df) ;
+
+//
+// y and batch (0-based, codes 0, ..., B - 1) are the data of one locus.
+// The generator must be seeded (set.seed in R, set_seed without R).
+//
+FitResult fit_mixture(const std::vector<double>& y, const std::vector<int>& batch,
+                      const MixtureHyper& h, bool pooled, const FitOptions& opt) ;
+
+#endif
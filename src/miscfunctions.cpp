@@ -434,8 +434,7 @@ Rcpp::NumericMatrix compute_u_sums_batch(Rcpp::S4 xmod) {
 // [[Rcpp::export]]
 Rcpp::NumericMatrix compute_heavy_sums_batch(Rcpp::S4 object) {
   RNGScope scope ;
-  Rcpp::S4 xmod = clone(object) ;
-  Rcpp::S4 model(xmod) ;
+  Rcpp::S4 model(object) ;
   NumericVector x = model.slot("data") ;
 
   int n = x.size() ;
@@ -449,12 +448,12 @@ Rcpp::NumericMatrix compute_heavy_sums_batch(Rcpp::S4 object) {
   int B = ub.size() ;
   // IntegerVector nn = model.slot("zfreq") ;
   NumericMatrix sums(B, K) ;
-  x = x * u ;
+  NumericVector xu = x * u ;
   for(int i = 0; i < n; i++){
       for(int b = 0; b < B; b++) {
           for(int k = 0; k < K; k++){
             if((z[i] == (k+1)) & (batch[i] == (b+1))){
-                  sums(b, k) += x[i] ;
+                  sums(b, k) += xu[i] ;
               }
           }
       }
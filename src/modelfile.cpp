@@ -0,0 +1,746 @@
+#include "modelfile.h"
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+#include <stdexcept>
+
+namespace {
+
+//
+// Little-endian encoding into and out of byte buffers
+//
+class ByteWriter {
+public:
+  std::vector<unsigned char> bytes ;
+  void u8(unsigned int x) { bytes.push_back((unsigned char) x) ; }
+  void u16(uint16_t x) { for(int i = 0; i < 2; ++i) u8((x >> (8 * i)) & 0xff) ; }
+  void u32(uint32_t x) { for(int i = 0; i < 4; ++i) u8((x >> (8 * i)) & 0xff) ; }
+  void u64(uint64_t x) { for(int i = 0; i < 8; ++i) u8((x >> (8 * i)) & 0xff) ; }
+  void i32(int x) { u32((uint32_t) x) ; }
+  void f64(double x) {
+    uint64_t u ;
+    std::memcpy(&u, &x, 8) ;
+    u64(u) ;
+  }
+  void str(const std::string& s) {
+    u32(s.size()) ;
+    bytes.insert(bytes.end(), s.begin(), s.end()) ;
+  }
+  void varint(uint64_t x) {
+    while(x >= 0x80){
+      u8((x & 0x7f) | 0x80) ;
+      x >>= 7 ;
+    }
+    u8(x) ;
+  }
+  void f64s(const std::vector<double>& x) {
+    for(size_t i = 0; i < x.size(); ++i) f64(x[i]) ;
+  }
+} ;
+
+class ByteReader {
+  const std::vector<unsigned char>& bytes ;
+  size_t pos ;
+  void need(size_t n) const {
+    if(pos + n > bytes.size()) throw std::runtime_error("truncated model file") ;
+  }
+public:
+  explicit ByteReader(const std::vector<unsigned char>& b) : bytes(b), pos(0) {}
+  bool done() const { return pos == bytes.size() ; }
+  unsigned int u8() {
+    need(1) ;
+    return bytes[pos++] ;
+  }
+  uint16_t u16() {
+    need(2) ;
+    uint16_t x = bytes[pos] | (bytes[pos + 1] << 8) ;
+    pos += 2 ;
+    return x ;
+  }
+  uint32_t u32() {
+    need(4) ;
+    uint32_t x = 0 ;
+    for(int i = 0; i < 4; ++i) x |= (uint32_t) bytes[pos + i] << (8 * i) ;
+    pos += 4 ;
+    return x ;
+  }
+  uint64_t u64() {
+    need(8) ;
+    uint64_t x = 0 ;
+    for(int i = 0; i < 8; ++i) x |= (uint64_t) bytes[pos + i] << (8 * i) ;
+    pos += 8 ;
+    return x ;
+  }
+  int i32() { return (int) u32() ; }
+  double f64() {
+    uint64_t u = u64() ;
+    double x ;
+    std::memcpy(&x, &u, 8) ;
+    return x ;
+  }
+  std::string str() {
+    uint32_t n = u32() ;
+    need(n) ;
+    std::string s(bytes.begin() + pos, bytes.begin() + pos + n) ;
+    pos += n ;
+    return s ;
+  }
+  uint64_t varint() {
+    uint64_t x = 0 ;
+    for(int shift = 0; shift < 64; shift += 7){
+      unsigned int b = u8() ;
+      x |= (uint64_t) (b & 0x7f) << shift ;
+      if(!(b & 0x80)) return x ;
+    }
+    throw std::runtime_error("corrupt varint in model file") ;
+  }
+  void f64s(std::vector<double>& x, size_t n) {
+    x.resize(n) ;
+    for(size_t i = 0; i < n; ++i) x[i] = f64() ;
+  }
+} ;
+
+uint64_t double_bits(double x) {
+  uint64_t u ;
+  std::memcpy(&u, &x, 8) ;
+  return u ;
+}
+
+double bits_double(uint64_t u) {
+  double x ;
+  std::memcpy(&x, &u, 8) ;
+  return x ;
+}
+
+//
+// One column of S draws, preceded by its byte length
+//
+void put_column(ByteWriter& w, const double* x, int S, int encoding) {
+  ByteWriter col ;
+  if(encoding == CHAIN_DELTA){
+    uint64_t prev = 0 ;
+    for(int s = 0; s < S; ++s){
+      uint64_t u = double_bits(x[s]) ;
+      col.varint(u ^ prev) ;
+      prev = u ;
+    }
+  } else if(encoding == CHAIN_FLOAT16){
+    for(int s = 0; s < S; ++s) col.u16(to_half(x[s])) ;
+  } else {
+    for(int s = 0; s < S; ++s) col.f64(x[s]) ;
+  }
+  w.u64(col.bytes.size()) ;
+  w.bytes.insert(w.bytes.end(), col.bytes.begin(), col.bytes.end()) ;
+}
+
+void get_column(ByteReader& r, double* x, int S, int encoding) {
+  uint64_t len = r.u64() ;
+  (void) len ;
+  if(encoding == CHAIN_DELTA){
+    uint64_t prev = 0 ;
+    for(int s = 0; s < S; ++s){
+      prev ^= r.varint() ;
+      x[s] = bits_double(prev) ;
+    }
+  } else if(encoding == CHAIN_FLOAT16){
+    for(int s = 0; s < S; ++s) x[s] = from_half(r.u16()) ;
+  } else {
+    for(int s = 0; s < S; ++s) x[s] = r.f64() ;
+  }
+}
+
+void put_chain(ByteWriter& w, const std::vector<double>& x, int S, int encoding) {
+  if(S == 0) {
+    w.u32(0) ;
+    return ;
+  }
+  if(x.size() % S != 0) throw std::runtime_error("chain length is not a multiple of the number of iterations") ;
+  const int p = x.size() / S ;
+  w.u32(p) ;
+  for(int j = 0; j < p; ++j) put_column(w, &x[S * j], S, encoding) ;
+}
+
+void get_chain(ByteReader& r, std::vector<double>& x, int S, int encoding) {
+  const int p = r.u32() ;
+  x.resize(S * p) ;
+  for(int j = 0; j < p; ++j) get_column(r, &x[S * j], S, encoding) ;
+}
+
+uint64_t zigzag(int64_t x) { return ((uint64_t) x << 1) ^ (uint64_t) (x >> 63) ; }
+
+int64_t unzigzag(uint64_t x) { return (int64_t) (x >> 1) ^ -(int64_t) (x & 1) ; }
+
+const char MAGIC[4] = {'C', 'N', 'P', 'B'} ;
+const int HEADER_BYTES = 24 ;
+
+void header(ByteWriter& w, int encoding, int bits, uint32_t n, uint64_t index) {
+  for(int i = 0; i < 4; ++i) w.u8(MAGIC[i]) ;
+  w.u16(MODEL_FILE_VERSION) ;
+  w.u8(encoding) ;
+  w.u8(bits) ;
+  w.u32(n) ;
+  w.u64(index) ;
+  w.u32(0) ;
+}
+
+}
+
+uint16_t to_half(double x) {
+  float f = (float) x ;
+  uint32_t u ;
+  std::memcpy(&u, &f, 4) ;
+  uint32_t sign = (u >> 16) & 0x8000 ;
+  uint32_t a = u & 0x7fffffff ;
+  if(a >= 0x7f800000) return sign | 0x7c00 | (a > 0x7f800000 ? 0x200 : 0) ;
+  // 65520 and above round to infinity
+  if(a >= 0x477ff000) return sign | 0x7c00 ;
+  if(a < 0x38800000){
+    // subnormal half (or zero)
+    if(a < 0x33000000) return sign ;
+    uint32_t e = a >> 23 ;
+    uint32_t m = (a & 0x7fffff) | 0x800000 ;
+    uint32_t shift = 126 - e ;
+    uint32_t h = m >> shift ;
+    uint32_t rem = m & ((1u << shift) - 1) ;
+    uint32_t half = 1u << (shift - 1) ;
+    if(rem > half || (rem == half && (h & 1))) ++h ;
+    return sign | h ;
+  }
+  uint32_t h = (((a >> 23) - 112) << 10) | ((a >> 13) & 0x3ff) ;
+  uint32_t rem = a & 0x1fff ;
+  if(rem > 0x1000 || (rem == 0x1000 && (h & 1))) ++h ;
+  return sign | h ;
+}
+
+double from_half(uint16_t h) {
+  int e = (h >> 10) & 0x1f ;
+  int m = h & 0x3ff ;
+  double x ;
+  if(e == 0) x = std::ldexp((double) m, -24) ;
+  else if(e == 31) x = m ? NA_REAL : R_PosInf ;
+  else x = std::ldexp((double) (m | 0x400), e - 25) ;
+  return (h & 0x8000) ? -x : x ;
+}
+
+ModelFileWriter::ModelFileWriter(const std::string& path_, int encoding_, int bits)
+  : out((path_ + ".tmp").c_str(), std::ios::binary | std::ios::trunc),
+    path(path_), tmp(path_ + ".tmp"),
+    encoding(encoding_), probz_bits(bits), offset(HEADER_BYTES) {
+  if(!out) throw std::runtime_error("cannot open " + tmp + " for writing") ;
+  if(encoding < CHAIN_RAW || encoding > CHAIN_FLOAT16)
+    throw std::runtime_error("unknown chain encoding") ;
+  if(probz_bits != 8 && probz_bits != 16)
+    throw std::runtime_error("probz must be quantised to 8 or 16 bits") ;
+  // placeholder, completed by close()
+  ByteWriter w ;
+  header(w, encoding, probz_bits, 0, 0) ;
+  write(w.bytes) ;
+}
+
+ModelFileWriter::~ModelFileWriter() {
+  // not closed: discard the records written so far
+  if(out.is_open()){
+    out.close() ;
+    std::remove(tmp.c_str()) ;
+  }
+}
+
+void ModelFileWriter::write(const std::vector<unsigned char>& bytes) {
+  out.write((const char*) &bytes[0], bytes.size()) ;
+  if(!out) throw std::runtime_error("error writing model file") ;
+}
+
+void ModelFileWriter::add(const ModelRecord& r, const ModelChains* chains) {
+  if(!out.is_open()) throw std::runtime_error("model file is closed") ;
+  const int K = r.K ;
+  const int nv = r.pooled ? r.B : r.B * K ;
+  if((int) r.theta.size() != r.B * K || (int) r.sigma2.size() != nv ||
+     (int) r.pi.size() != K || (int) r.mu.size() != K || (int) r.tau2.size() != K)
+    throw std::runtime_error("modes of " + r.locus + " " + r.model + " do not match the model specs") ;
+  if(!r.probz.empty() && (int) r.probz.size() != r.N * K)
+    throw std::runtime_error("probz of " + r.locus + " " + r.model + " is not N x K") ;
+  ModelFileEntry e ;
+  e.locus = r.locus ;
+  e.model = r.model ;
+  e.N = r.N ;
+  e.B = r.B ;
+  e.K = K ;
+  e.pooled = r.pooled ;
+  e.marginal = r.marginal ;
+  // specs, hyperparameters, and MCMC parameters
+  ByteWriter w ;
+  w.str(r.locus) ;
+  w.str(r.model) ;
+  w.i32(r.N) ;
+  w.i32(r.B) ;
+  w.i32(K) ;
+  w.u8(r.pooled) ;
+  w.f64(r.hyper.mu0) ;
+  w.f64(r.hyper.tau2_0) ;
+  w.f64(r.hyper.eta0) ;
+  w.f64(r.hyper.m2_0) ;
+  w.f64(r.hyper.beta) ;
+  w.f64(r.hyper.a) ;
+  w.f64(r.hyper.b) ;
+  w.f64(r.hyper.df) ;
+  w.i32(r.hyper.nu0_max) ;
+  w.u32(r.hyper.alpha.size()) ;
+  w.f64s(r.hyper.alpha) ;
+  w.i32(r.iter) ;
+  w.i32(r.burnin) ;
+  w.i32(r.thin) ;
+  e.spec = offset ;
+  e.modes = offset + w.bytes.size() ;
+  w.f64s(r.theta) ;
+  w.f64s(r.sigma2) ;
+  w.f64s(r.pi) ;
+  w.f64s(r.mu) ;
+  w.f64s(r.tau2) ;
+  w.f64(r.nu0) ;
+  w.f64(r.sigma2_0) ;
+  w.f64(r.loglik) ;
+  w.f64(r.logprior) ;
+  w.f64(r.marginal) ;
+  e.probz = 0 ;
+  if(!r.probz.empty()){
+    e.probz = offset + w.bytes.size() ;
+    const double scale = probz_bits == 8 ? 255.0 : 65535.0 ;
+    for(size_t j = 0; j < r.probz.size(); ++j){
+      double p = r.probz[j] ;
+      p = ISNAN(p) ? 0.0 : std::min(std::max(p, 0.0), 1.0) ;
+      uint32_t q = (uint32_t) std::floor(p * scale + 0.5) ;
+      if(probz_bits == 8) w.u8(q) ;
+      else w.u16(q) ;
+    }
+  }
+  e.chains = 0 ;
+  if(chains && chains->S > 0){
+    const int S = chains->S ;
+    e.chains = offset + w.bytes.size() ;
+    w.i32(S) ;
+    put_chain(w, chains->theta, S, encoding) ;
+    put_chain(w, chains->sigma2, S, encoding) ;
+    put_chain(w, chains->pi, S, encoding) ;
+    put_chain(w, chains->mu, S, encoding) ;
+    put_chain(w, chains->tau2, S, encoding) ;
+    put_chain(w, chains->nu0, S, encoding) ;
+    put_chain(w, chains->sigma2_0, S, encoding) ;
+    put_chain(w, chains->loglik, S, CHAIN_RAW) ;
+    put_chain(w, chains->logprior, S, CHAIN_RAW) ;
+    if(chains->zfreq.size() % S != 0) throw std::runtime_error("zfreq chain is not S x K") ;
+    const int p = chains->zfreq.size() / S ;
+    w.u32(p) ;
+    for(int j = 0; j < p; ++j){
+      int64_t prev = 0 ;
+      for(int s = 0; s < S; ++s){
+        int64_t x = chains->zfreq[S * j + s] ;
+        w.varint(zigzag(x - prev)) ;
+        prev = x ;
+      }
+    }
+  }
+  write(w.bytes) ;
+  offset += w.bytes.size() ;
+  e.end = offset ;
+  entries.push_back(e) ;
+}
+
+void ModelFileWriter::close() {
+  if(!out.is_open()) return ;
+  ByteWriter w ;
+  for(size_t i = 0; i < entries.size(); ++i){
+    const ModelFileEntry& e = entries[i] ;
+    w.str(e.locus) ;
+    w.str(e.model) ;
+    w.i32(e.N) ;
+    w.i32(e.B) ;
+    w.i32(e.K) ;
+    w.u8(e.pooled) ;
+    w.f64(e.marginal) ;
+    w.u64(e.spec) ;
+    w.u64(e.modes) ;
+    w.u64(e.probz) ;
+    w.u64(e.chains) ;
+    w.u64(e.end) ;
+  }
+  if(!w.bytes.empty()) write(w.bytes) ;
+  ByteWriter h ;
+  header(h, encoding, probz_bits, entries.size(), offset) ;
+  out.seekp(0) ;
+  write(h.bytes) ;
+  out.close() ;
+  if(out.fail()){
+    std::remove(tmp.c_str()) ;
+    throw std::runtime_error("error closing model file") ;
+  }
+  std::remove(path.c_str()) ;
+  if(std::rename(tmp.c_str(), path.c_str()) != 0){
+    std::remove(tmp.c_str()) ;
+    throw std::runtime_error("cannot rename " + tmp + " to " + path) ;
+  }
+}
+
+ModelFileReader::ModelFileReader(const std::string& path)
+  : in(path.c_str(), std::ios::binary) {
+  if(!in) throw std::runtime_error("cannot open " + path) ;
+  in.seekg(0, std::ios::end) ;
+  const uint64_t size = in.tellg() ;
+  if(size < (uint64_t) HEADER_BYTES) throw std::runtime_error(path + " is not a CNPBayes model file") ;
+  std::vector<unsigned char> h = section(0, HEADER_BYTES) ;
+  if(std::memcmp(&h[0], MAGIC, 4) != 0)
+    throw std::runtime_error(path + " is not a CNPBayes model file") ;
+  ByteReader r(h) ;
+  for(int i = 0; i < 4; ++i) r.u8() ;
+  version_ = r.u16() ;
+  if(version_ > MODEL_FILE_VERSION)
+    throw std::runtime_error(path + " was written by a newer version of CNPBayes") ;
+  encoding = r.u8() ;
+  probz_bits = r.u8() ;
+  const uint32_t n = r.u32() ;
+  const uint64_t index = r.u64() ;
+  if(index < (uint64_t) HEADER_BYTES || index > size)
+    throw std::runtime_error(path + " is incomplete (the writer was not closed)") ;
+  std::vector<unsigned char> bytes = section(index, size) ;
+  ByteReader ir(bytes) ;
+  entries.resize(n) ;
+  for(uint32_t i = 0; i < n; ++i){
+    ModelFileEntry& e = entries[i] ;
+    e.locus = ir.str() ;
+    e.model = ir.str() ;
+    e.N = ir.i32() ;
+    e.B = ir.i32() ;
+    e.K = ir.i32() ;
+    e.pooled = ir.u8() ;
+    e.marginal = ir.f64() ;
+    e.spec = ir.u64() ;
+    e.modes = ir.u64() ;
+    e.probz = ir.u64() ;
+    e.chains = ir.u64() ;
+    e.end = ir.u64() ;
+  }
+}
+
+std::vector<unsigned char> ModelFileReader::section(uint64_t from, uint64_t to) const {
+  std::vector<unsigned char> bytes(to - from) ;
+  if(bytes.empty()) return bytes ;
+  in.clear() ;
+  in.seekg(from) ;
+  in.read((char*) &bytes[0], bytes.size()) ;
+  if(!in) throw std::runtime_error("truncated model file") ;
+  return bytes ;
+}
+
+// the next section of entry i after the one starting at from
+uint64_t ModelFileReader::section_end(size_t i, uint64_t from) const {
+  const ModelFileEntry& e = entries[i] ;
+  const uint64_t next[4] = {e.modes, e.probz, e.chains, e.end} ;
+  for(int j = 0; j < 4; ++j) if(next[j] > from) return next[j] ;
+  return e.end ;
+}
+
+void ModelFileReader::read_spec(size_t i, ModelRecord& rec) const {
+  const ModelFileEntry& e = entries.at(i) ;
+  std::vector<unsigned char> bytes = section(e.spec, e.modes) ;
+  ByteReader r(bytes) ;
+  rec.locus = r.str() ;
+  rec.model = r.str() ;
+  rec.N = r.i32() ;
+  rec.B = r.i32() ;
+  rec.K = r.i32() ;
+  rec.pooled = r.u8() ;
+  rec.hyper.K = rec.K ;
+  rec.hyper.mu0 = r.f64() ;
+  rec.hyper.tau2_0 = r.f64() ;
+  rec.hyper.eta0 = r.f64() ;
+  rec.hyper.m2_0 = r.f64() ;
+  rec.hyper.beta = r.f64() ;
+  rec.hyper.a = r.f64() ;
+  rec.hyper.b = r.f64() ;
+  rec.hyper.df = r.f64() ;
+  rec.hyper.nu0_max = r.i32() ;
+  r.f64s(rec.hyper.alpha, r.u32()) ;
+  rec.iter = r.i32() ;
+  rec.burnin = r.i32() ;
+  rec.thin = r.i32() ;
+}
+
+void ModelFileReader::read_modes(size_t i, ModelRecord& rec) const {
+  const ModelFileEntry& e = entries.at(i) ;
+  std::vector<unsigned char> bytes = section(e.modes, section_end(i, e.modes)) ;
+  ByteReader r(bytes) ;
+  const int K = e.K ;
+  r.f64s(rec.theta, e.B * K) ;
+  r.f64s(rec.sigma2, e.pooled ? e.B : e.B * K) ;
+  r.f64s(rec.pi, K) ;
+  r.f64s(rec.mu, K) ;
+  r.f64s(rec.tau2, K) ;
+  rec.nu0 = r.f64() ;
+  rec.sigma2_0 = r.f64() ;
+  rec.loglik = r.f64() ;
+  rec.logprior = r.f64() ;
+  rec.marginal = r.f64() ;
+}
+
+bool ModelFileReader::read_probz(size_t i, ModelRecord& rec) const {
+  const ModelFileEntry& e = entries.at(i) ;
+  rec.probz.clear() ;
+  if(e.probz == 0) return false ;
+  std::vector<unsigned char> bytes = section(e.probz, section_end(i, e.probz)) ;
+  ByteReader r(bytes) ;
+  const size_t n = (size_t) e.N * e.K ;
+  const double scale = probz_bits == 8 ? 255.0 : 65535.0 ;
+  rec.probz.resize(n) ;
+  for(size_t j = 0; j < n; ++j){
+    rec.probz[j] = (probz_bits == 8 ? r.u8() : r.u16()) / scale ;
+  }
+  return true ;
+}
+
+bool ModelFileReader::read_chains(size_t i, ModelChains& c) const {
+  const ModelFileEntry& e = entries.at(i) ;
+  c = ModelChains() ;
+  if(e.chains == 0) return false ;
+  std::vector<unsigned char> bytes = section(e.chains, e.end) ;
+  ByteReader r(bytes) ;
+  const int S = r.i32() ;
+  c.S = S ;
+  get_chain(r, c.theta, S, encoding) ;
+  get_chain(r, c.sigma2, S, encoding) ;
+  get_chain(r, c.pi, S, encoding) ;
+  get_chain(r, c.mu, S, encoding) ;
+  get_chain(r, c.tau2, S, encoding) ;
+  get_chain(r, c.nu0, S, encoding) ;
+  get_chain(r, c.sigma2_0, S, encoding) ;
+  get_chain(r, c.loglik, S, CHAIN_RAW) ;
+  get_chain(r, c.logprior, S, CHAIN_RAW) ;
+  const int p = r.u32() ;
+  c.zfreq.resize(S * p) ;
+  for(int j = 0; j < p; ++j){
+    int64_t prev = 0 ;
+    for(int s = 0; s < S; ++s){
+      prev += unzigzag(r.varint()) ;
+      c.zfreq[S * j + s] = (int) prev ;
+    }
+  }
+  return true ;
+}
+
+#ifndef CNPBAYES_STANDALONE
+//
+// Bindings for writeModels and readModels.  A record is a list with the
+// elements locus, model, N, B, K, pooled, hyper (a list of the
+// hyperparameters), mcmc (iter, burnin, thin), modes, probz (N x K
+// probabilities or NULL), and chains (a list of S x p matrices or NULL).
+//
+namespace {
+
+using namespace Rcpp ;
+
+std::vector<double> dbl(SEXP x) {
+  NumericVector v(x) ;
+  return std::vector<double>(v.begin(), v.end()) ;
+}
+
+ModelRecord record_from_list(List x) {
+  ModelRecord r ;
+  r.locus = as<std::string>(x["locus"]) ;
+  r.model = as<std::string>(x["model"]) ;
+  r.N = as<int>(x["N"]) ;
+  r.B = as<int>(x["B"]) ;
+  r.K = as<int>(x["K"]) ;
+  r.pooled = as<bool>(x["pooled"]) ;
+  List hp = x["hyper"] ;
+  r.hyper.K = r.K ;
+  r.hyper.mu0 = as<double>(hp["mu.0"]) ;
+  r.hyper.tau2_0 = as<double>(hp["tau2.0"]) ;
+  r.hyper.eta0 = as<double>(hp["eta.0"]) ;
+  r.hyper.m2_0 = as<double>(hp["m2.0"]) ;
+  r.hyper.beta = as<double>(hp["beta"]) ;
+  r.hyper.a = as<double>(hp["a"]) ;
+  r.hyper.b = as<double>(hp["b"]) ;
+  r.hyper.df = as<double>(hp["dfr"]) ;
+  r.hyper.nu0_max = as<int>(hp["nu0_max"]) ;
+  r.hyper.alpha = dbl(hp["alpha"]) ;
+  List mp = x["mcmc"] ;
+  r.iter = as<int>(mp["iter"]) ;
+  r.burnin = as<int>(mp["burnin"]) ;
+  r.thin = as<int>(mp["thin"]) ;
+  List m = x["modes"] ;
+  r.theta = dbl(m["theta"]) ;
+  r.sigma2 = dbl(m["sigma2"]) ;
+  r.pi = dbl(m["p"]) ;
+  r.mu = dbl(m["mu"]) ;
+  r.tau2 = dbl(m["tau2"]) ;
+  r.nu0 = as<double>(m["nu.0"]) ;
+  r.sigma2_0 = as<double>(m["sigma2.0"]) ;
+  r.loglik = as<double>(m["loglik"]) ;
+  r.logprior = as<double>(m["logprior"]) ;
+  r.marginal = as<double>(m["marginal_lik"]) ;
+  if(!Rf_isNull(x["probz"])) r.probz = dbl(x["probz"]) ;
+  return r ;
+}
+
+ModelChains chains_from_list(List x) {
+  ModelChains c ;
+  c.S = as<int>(x["S"]) ;
+  c.theta = dbl(x["theta"]) ;
+  c.sigma2 = dbl(x["sigma2"]) ;
+  c.pi = dbl(x["p"]) ;
+  c.mu = dbl(x["mu"]) ;
+  c.tau2 = dbl(x["tau2"]) ;
+  c.nu0 = dbl(x["nu.0"]) ;
+  c.sigma2_0 = dbl(x["sigma2.0"]) ;
+  c.loglik = dbl(x["loglik"]) ;
+  c.logprior = dbl(x["logprior"]) ;
+  IntegerVector zf = as<IntegerVector>(x["zfreq"]) ;
+  c.zfreq.assign(zf.begin(), zf.end()) ;
+  return c ;
+}
+
+NumericMatrix matrix(const std::vector<double>& x, int nrow) {
+  const int ncol = nrow > 0 ? x.size() / nrow : 0 ;
+  NumericMatrix m(nrow, ncol) ;
+  std::copy(x.begin(), x.end(), m.begin()) ;
+  return m ;
+}
+
+}
+
+// [[Rcpp::export]]
+int write_model_file(std::string path, List records, int encoding, int bits) {
+  try {
+    ModelFileWriter w(path, encoding, bits) ;
+    for(int i = 0; i < records.size(); ++i){
+      List x = records[i] ;
+      ModelRecord r = record_from_list(x) ;
+      if(Rf_isNull(x["chains"])){
+        w.add(r, NULL) ;
+      } else {
+        ModelChains c = chains_from_list(x["chains"]) ;
+        w.add(r, &c) ;
+      }
+    }
+    w.close() ;
+  } catch(std::exception& e) {
+    stop(e.what()) ;
+  }
+  return records.size() ;
+}
+
+// [[Rcpp::export]]
+List model_file_index(std::string path) {
+  try {
+    ModelFileReader rd(path) ;
+    const std::vector<ModelFileEntry>& idx = rd.index() ;
+    const int n = idx.size() ;
+    CharacterVector locus(n), model(n) ;
+    IntegerVector N(n), B(n), K(n) ;
+    LogicalVector pooled(n), has_probz(n), has_chains(n) ;
+    NumericVector marginal(n) ;
+    for(int i = 0; i < n; ++i){
+      locus[i] = idx[i].locus ;
+      model[i] = idx[i].model ;
+      N[i] = idx[i].N ;
+      B[i] = idx[i].B ;
+      K[i] = idx[i].K ;
+      pooled[i] = idx[i].pooled ;
+      marginal[i] = idx[i].marginal ;
+      has_probz[i] = idx[i].probz != 0 ;
+      has_chains[i] = idx[i].chains != 0 ;
+    }
+    List x = List::create(Named("locus") = locus,
+                          Named("model") = model,
+                          Named("N") = N,
+                          Named("B") = B,
+                          Named("K") = K,
+                          Named("pooled") = pooled,
+                          Named("marginal_lik") = marginal,
+                          Named("has_probz") = has_probz,
+                          Named("has_chains") = has_chains) ;
+    x.attr("version") = rd.version() ;
+    x.attr("encoding") = rd.chain_encoding() ;
+    x.attr("bits") = rd.bits() ;
+    return x ;
+  } catch(std::exception& e) {
+    stop(e.what()) ;
+  }
+  return List() ;
+}
+
+//
+// Records i (1-based) of the file.  Only the requested sections are read.
+//
+// [[Rcpp::export]]
+List read_model_file(std::string path, IntegerVector i, bool probz, bool chains) {
+  try {
+    ModelFileReader rd(path) ;
+    const int n = rd.index().size() ;
+    List out(i.size()) ;
+    for(int j = 0; j < i.size(); ++j){
+      if(i[j] < 1 || i[j] > n) stop("record index out of range") ;
+      const size_t r = i[j] - 1 ;
+      ModelRecord rec ;
+      rd.read_spec(r, rec) ;
+      rd.read_modes(r, rec) ;
+      const int B = rec.B ;
+      List hyper = List::create(Named("mu.0") = rec.hyper.mu0,
+                                Named("tau2.0") = rec.hyper.tau2_0,
+                                Named("eta.0") = rec.hyper.eta0,
+                                Named("m2.0") = rec.hyper.m2_0,
+                                Named("alpha") = wrap(rec.hyper.alpha),
+                                Named("beta") = rec.hyper.beta,
+                                Named("a") = rec.hyper.a,
+                                Named("b") = rec.hyper.b,
+                                Named("dfr") = rec.hyper.df,
+                                Named("nu0_max") = rec.hyper.nu0_max) ;
+      List mcmc = List::create(Named("iter") = rec.iter,
+                               Named("burnin") = rec.burnin,
+                               Named("thin") = rec.thin) ;
+      List modes = List::create(Named("theta") = matrix(rec.theta, B),
+                                Named("sigma2") = matrix(rec.sigma2, B),
+                                Named("p") = wrap(rec.pi),
+                                Named("mu") = wrap(rec.mu),
+                                Named("tau2") = wrap(rec.tau2),
+                                Named("nu.0") = rec.nu0,
+                                Named("sigma2.0") = rec.sigma2_0,
+                                Named("loglik") = rec.loglik,
+                                Named("logprior") = rec.logprior,
+                                Named("marginal_lik") = rec.marginal) ;
+      List x = List::create(Named("locus") = rec.locus,
+                            Named("model") = rec.model,
+                            Named("N") = rec.N,
+                            Named("B") = B,
+                            Named("K") = rec.K,
+                            Named("pooled") = rec.pooled,
+                            Named("hyper") = hyper,
+                            Named("mcmc") = mcmc,
+                            Named("modes") = modes,
+                            Named("probz") = R_NilValue,
+                            Named("chains") = R_NilValue) ;
+      if(probz && rd.read_probz(r, rec)) x["probz"] = matrix(rec.probz, rec.N) ;
+      ModelChains c ;
+      if(chains && rd.read_chains(r, c)){
+        const int S = c.S ;
+        IntegerMatrix zfreq(S, S > 0 ? c.zfreq.size() / S : 0) ;
+        std::copy(c.zfreq.begin(), c.zfreq.end(), zfreq.begin()) ;
+        x["chains"] = List::create(Named("S") = S,
+                                   Named("theta") = matrix(c.theta, S),
+                                   Named("sigma2") = matrix(c.sigma2, S),
+                                   Named("p") = matrix(c.pi, S),
+                                   Named("mu") = matrix(c.mu, S),
+                                   Named("tau2") = matrix(c.tau2, S),
+                                   Named("nu.0") = wrap(c.nu0),
+                                   Named("sigma2.0") = wrap(c.sigma2_0),
+                                   Named("loglik") = wrap(c.loglik),
+                                   Named("logprior") = wrap(c.logprior),
+                                   Named("zfreq") = zfreq) ;
+      }
+      out[j] = x ;
+    }
+    return out ;
+  } catch(std::exception& e) {
+    stop(e.what()) ;
+  }
+  return List() ;
+}
+#endif
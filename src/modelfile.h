@@ -0,0 +1,160 @@
+#ifndef _modelfile_H
+#define _modelfile_H
+#include "sampler.h"
+#include <fstream>
+#include <string>
+#include <vector>
+#include <stdint.h>
+
+//
+// Versioned binary files of fitted models.
+//
+// A file holds one record per (locus, model) with the model specs,
+// hyperparameters, and MCMC parameters, the modal ordinates, and
+// optionally the posterior probabilities of the mixture components
+// (probz) and the chains.  An index at the end of the file gives the
+// byte offset of each section of each record, so that the modes or the
+// probabilities of a subset of the loci are read without reading the
+// rest of the file.  All numbers are little-endian.
+//
+//   header   "CNPB", uint16 version, uint8 chain encoding, uint8 probz
+//            bits, uint32 number of records, uint64 index offset,
+//            uint32 reserved (24 bytes)
+//   records  spec | modes | probz (optional) | chains (optional)
+//   index    per record: locus, model, N, B, K, pooled, marginal
+//            likelihood, and the offsets of the four sections and of
+//            the end of the record (0 for an absent section)
+//
+// Strings are a uint32 length followed by the bytes.  The modes are
+// float64.  probz is quantised to 8 or 16 bits: p is stored as
+// round(p * (2^bits - 1)), so that each probability is within
+// 1 / (2 * 255) (8 bits) or 1 / (2 * 65535) (16 bits) of its value.
+//
+// Each chain is stored by column (iterations contiguous), with the
+// byte length of the column preceding it.  The parameter chains are
+// encoded by one of
+//
+//   CHAIN_RAW      float64
+//   CHAIN_DELTA    lossless: each value is XOR-ed with the previous
+//                  value of the column and written as a LEB128 varint,
+//                  so that the shared sign, exponent, and leading
+//                  mantissa bits of successive draws cost nothing
+//   CHAIN_FLOAT16  lossy: IEEE half precision (about 3 significant
+//                  digits); for plotting and rough summaries
+//
+// The log likelihood and log prior chains are always float64 and the
+// component frequencies (zfreq) are always zigzag delta varints.
+//
+const uint16_t MODEL_FILE_VERSION = 1 ;
+
+enum ChainEncoding { CHAIN_RAW = 0, CHAIN_DELTA = 1, CHAIN_FLOAT16 = 2 } ;
+
+struct ModelRecord {
+  std::string locus ;
+  std::string model ;   // SB3, MBP2, ...
+  int N ;
+  int B ;
+  int K ;
+  bool pooled ;
+  MixtureHyper hyper ;
+  int iter ;
+  int burnin ;
+  int thin ;
+  // modes; theta is B x K, sigma2 is B x K (B if pooled)
+  std::vector<double> theta ;
+  std::vector<double> sigma2 ;
+  std::vector<double> pi ;
+  std::vector<double> mu ;
+  std::vector<double> tau2 ;
+  double nu0 ;
+  double sigma2_0 ;
+  double loglik ;
+  double logprior ;
+  double marginal ;
+  // N x K posterior probabilities; empty if not stored
+  std::vector<double> probz ;
+} ;
+
+//
+// S x p matrices, column-major.  S = 0 when the chains were not stored.
+//
+struct ModelChains {
+  int S ;
+  std::vector<double> theta ;
+  std::vector<double> sigma2 ;
+  std::vector<double> pi ;
+  std::vector<double> mu ;
+  std::vector<double> tau2 ;
+  std::vector<double> nu0 ;
+  std::vector<double> sigma2_0 ;
+  std::vector<double> loglik ;
+  std::vector<double> logprior ;
+  std::vector<int> zfreq ;
+  ModelChains() : S(0) {}
+} ;
+
+struct ModelFileEntry {
+  std::string locus ;
+  std::string model ;
+  int N ;
+  int B ;
+  int K ;
+  bool pooled ;
+  double marginal ;
+  uint64_t spec ;
+  uint64_t modes ;
+  uint64_t probz ;
+  uint64_t chains ;
+  uint64_t end ;
+} ;
+
+//
+// Records are written as they are added to a temporary file next to
+// path; close() writes the index, completes the header, and renames the
+// file to path.  A writer destroyed without close() (e.g., after add()
+// threw) removes the temporary file, so that an incomplete file is never
+// left at path.  Errors throw std::runtime_error.
+//
+class ModelFileWriter {
+  std::ofstream out ;
+  std::string path ;
+  std::string tmp ;
+  int encoding ;
+  int probz_bits ;
+  std::vector<ModelFileEntry> entries ;
+  uint64_t offset ;
+  void write(const std::vector<unsigned char>& bytes) ;
+public:
+  ModelFileWriter(const std::string& path, int encoding, int probz_bits) ;
+  ~ModelFileWriter() ;
+  // chains may be NULL
+  void add(const ModelRecord& r, const ModelChains* chains) ;
+  void close() ;
+} ;
+
+class ModelFileReader {
+  mutable std::ifstream in ;
+  uint16_t version_ ;
+  int encoding ;
+  int probz_bits ;
+  std::vector<ModelFileEntry> entries ;
+  std::vector<unsigned char> section(uint64_t from, uint64_t to) const ;
+  uint64_t section_end(size_t i, uint64_t from) const ;
+public:
+  explicit ModelFileReader(const std::string& path) ;
+  int version() const { return version_ ; }
+  int chain_encoding() const { return encoding ; }
+  int bits() const { return probz_bits ; }
+  const std::vector<ModelFileEntry>& index() const { return entries ; }
+  // each fills its part of the record of entry i
+  void read_spec(size_t i, ModelRecord& r) const ;
+  void read_modes(size_t i, ModelRecord& r) const ;
+  bool read_probz(size_t i, ModelRecord& r) const ;
+  bool read_chains(size_t i, ModelChains& c) const ;
+} ;
+
+// IEEE 754 binary16 conversions (round to nearest even)
+uint16_t to_half(double x) ;
+double from_half(uint16_t h) ;
+
+#endif
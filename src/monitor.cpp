@@ -0,0 +1,80 @@
+#include "monitor.h"
+#include <Rinternals.h>
+#include <R_ext/Utils.h>
+
+using namespace Rcpp ;
+
+// the last interruption, until read by sampler_interrupt()
+static bool interrupted = false ;
+static std::string interrupted_phase ;
+static int interrupted_iter = 0 ;
+static int interrupted_total = 0 ;
+
+static void check_interrupt(void*) {
+  R_CheckUserInterrupt() ;
+}
+
+// R_CheckUserInterrupt longjmps on an interrupt; R_ToplevelExec
+// contains the jump and returns FALSE instead
+static bool user_interrupt() {
+  return R_ToplevelExec(check_interrupt, NULL) == FALSE ;
+}
+
+static int mcmc_int(Rcpp::S4 mcmcp, const char* name, int value) {
+  if(!mcmcp.hasSlot(name)) return value ;
+  IntegerVector x = mcmcp.slot(name) ;
+  return x.size() > 0 && x[0] != NA_INTEGER ? x[0] : value ;
+}
+
+SamplerMonitor::SamplerMonitor(Rcpp::S4 mcmcp, const std::string& phase_,
+                               int total_) :
+  phase(phase_), total(total_), progress(mcmc_int(mcmcp, "progress", 0)),
+  interval(mcmc_int(mcmcp, "checkpoint_interval", 0)),
+  last_check(std::chrono::steady_clock::now()) {
+  if(mcmcp.hasSlot("checkpoint")){
+    CharacterVector f = mcmcp.slot("checkpoint") ;
+    if(f.size() > 0 && !CharacterVector::is_na(f[0])) file = as<std::string>(f[0]) ;
+  }
+}
+
+void SamplerMonitor::checkpoint(Rcpp::S4 model, int done) const {
+  // the RNG state of R is only current after PutRNGstate
+  PutRNGstate() ;
+  Environment ns = Environment::namespace_env("CNPBayes") ;
+  Function save = ns[".save_checkpoint"] ;
+  save(model, file, phase, done, total) ;
+  GetRNGstate() ;
+}
+
+bool SamplerMonitor::poll(int done) {
+  if(progress > 0 && (done % progress == 0 || done == total)){
+    Environment ns = Environment::namespace_env("CNPBayes") ;
+    Function report = ns[".sampler_progress"] ;
+    report(phase, done, total) ;
+  }
+  if(done >= total) return false ;
+  std::chrono::steady_clock::time_point now = std::chrono::steady_clock::now() ;
+  std::chrono::duration<double> d = now - last_check ;
+  if(d.count() < INTERRUPT_SECONDS) return false ;
+  last_check = now ;
+  if(!user_interrupt()) return false ;
+  interrupted = true ;
+  interrupted_phase = phase ;
+  interrupted_iter = done ;
+  interrupted_total = total ;
+  return true ;
+}
+
+//
+// NULL, or the phase ('burnin' or 'mcmc') and the number of completed
+// iterations of the last interrupted sampler.  Reading the
+// interruption clears it.
+//
+// [[Rcpp::export]]
+SEXP sampler_interrupt() {
+  if(!interrupted) return R_NilValue ;
+  interrupted = false ;
+  return List::create(Named("phase") = interrupted_phase,
+                      Named("iter") = interrupted_iter,
+                      Named("total") = interrupted_total) ;
+}
@@ -0,0 +1,47 @@
+#ifndef _monitor_H
+#define _monitor_H
+#include <Rcpp.h>
+#include <chrono>
+#include <string>
+
+//
+// Progress reports, checkpoints, and cooperative interruption of the
+// samplers.  A sampler calls poll() after each completed iteration -- a
+// burnin sweep, or a saved iteration together with its thinning sweeps.
+//
+//  - every McmcParams(progress=) iterations, the R function
+//    .sampler_progress(phase, iter, total) is called;
+//
+//  - every McmcParams(checkpoint_interval=) iterations, when
+//    McmcParams(checkpoint=) names a file, the sampler writes its state
+//    to the model and checkpoint() saves the model, the number of
+//    completed iterations, and the state of the random number generator
+//    (see resumeMcmc);
+//
+//  - at most every INTERRUPT_SECONDS, the sampler checks for a user
+//    interrupt without unwinding the C++ stack.  An interrupted sampler
+//    stops, returns the state and the chains reached so far, and records
+//    the interruption for sampler_interrupt().
+//
+const double INTERRUPT_SECONDS = 0.2 ;
+
+class SamplerMonitor {
+  std::string phase ;
+  int total ;
+  int progress ;
+  int interval ;
+  std::string file ;
+  std::chrono::steady_clock::time_point last_check ;
+public:
+  SamplerMonitor(Rcpp::S4 mcmcp, const std::string& phase, int total) ;
+  bool checkpoint_due(int done) const {
+    return interval > 0 && !file.empty() && done < total && done % interval == 0 ;
+  }
+  // model must hold the state after done iterations
+  void checkpoint(Rcpp::S4 model, int done) const ;
+  // progress and interrupt after done iterations; true if the sampler
+  // should stop
+  bool poll(int done) ;
+} ;
+
+#endif
@@ -1,4 +1,6 @@
 #include "miscfunctions.h" // for rdirichlet
+#include "conditionals.h"
+#include "sampler.h"
 #include <Rmath.h>
 
 using namespace Rcpp ;
@@ -25,8 +27,7 @@ Rcpp::IntegerVector sample_components(Rcpp::IntegerVector x, int size, Rcpp::Num
 // [[Rcpp::export]]
 Rcpp::NumericVector compute_loglik(Rcpp::S4 xmod){
   RNGScope scope ;
-  Rcpp::S4 model_(xmod);
-  Rcpp::S4 model = clone(model_);
+  Rcpp::S4 model(xmod);
   int K = getK(model.slot("hyperparams")) ;
   NumericVector x = model.slot("data") ;
   int N = x.size() ;
@@ -79,8 +80,7 @@ Rcpp::NumericVector compute_loglik(Rcpp::S4 xmod){
 // [[Rcpp::export]]
 Rcpp::NumericVector update_mu(Rcpp::S4 xmod){
   RNGScope scope ;
-  Rcpp::S4 model_(xmod);
-  Rcpp::S4 model = clone(model_);
+  Rcpp::S4 model(xmod);
   Rcpp::S4 hypp(model.slot("hyperparams")) ;
   int K = getK(hypp) ;
   double tau2_0 = hypp.slot("tau2.0") ;
@@ -143,7 +143,7 @@ Rcpp::NumericVector update_mu(Rcpp::S4 xmod){
 // [[Rcpp::export]]
 Rcpp::NumericVector update_tau2(Rcpp::S4 xmod){
   RNGScope scope ;
-  Rcpp::S4 model(clone(xmod));
+  Rcpp::S4 model(xmod);
   Rcpp::S4 hypp(model.slot("hyperparams")) ;
   double m2_0 = hypp.slot("m2.0") ;
   int K = getK(hypp) ;
@@ -175,34 +175,22 @@ Rcpp::NumericVector update_tau2(Rcpp::S4 xmod){
 // [[Rcpp::export]]
 Rcpp::NumericVector update_sigma20(Rcpp::S4 xmod){
     RNGScope scope ;
-    Rcpp::S4 model(clone(xmod));
+    Rcpp::S4 model(xmod) ;
     Rcpp::S4 hypp(model.slot("hyperparams")) ;
-    int K = getK(hypp) ;
-    IntegerVector batch = model.slot("batch") ;
-    IntegerVector ub = unique_batch(batch) ;
-    int B = ub.size() ;
-    NumericVector a = hypp.slot("a") ;
-    NumericVector b = hypp.slot("b") ;
-    NumericVector nu_0 = model.slot("nu.0") ;  
+    double a = hypp.slot("a") ;
+    double b = hypp.slot("b") ;
+    double nu_0 = model.slot("nu.0") ;
     NumericMatrix sigma2 = model.slot("sigma2") ;
     Rcpp::NumericVector sigma2_0_old = model.slot("sigma2.0");
-    NumericVector prec(1) ;
-
-    for(int i = 0; i < B; ++i){
-        for(int k = 0; k < K; ++k){
-            prec[0] += 1.0/sigma2(i, k) ;
-        }
+    double prec = 0.0 ;
+    for(int i = 0; i < sigma2.size(); ++i){
+        prec += 1.0/sigma2[i] ;
     }
-
-    NumericVector a_k(1) ;
-    NumericVector b_k(1) ;
-    a_k[0] = a[0] + 0.5*(K * B)*nu_0[0] ;
-    b_k[0] = b[0] + 0.5*nu_0[0]*prec[0] ;
+    double shape ;
     double rate ;
-    rate = 1.0/b_k[0] ;
-    //return b_k ;
+    sigma20_conditional(a, b, sigma2.size(), nu_0, prec, shape, rate) ;
     NumericVector sigma2_0(1) ;
-    sigma2_0[0] = as<double>(rgamma(1, a_k[0], rate)) ;
+    sigma2_0[0] = R::rgamma(shape, 1.0/rate) ;
     double constraint = model.slot(".internal.constraint");
     if (constraint > 0) {
         if (sigma2_0[0] < constraint) {
@@ -220,48 +208,21 @@ Rcpp::NumericVector update_sigma20(Rcpp::S4 xmod){
 // [[Rcpp::export]]
 Rcpp::NumericVector update_nu0(Rcpp::S4 xmod){
   RNGScope scope ;
-  Rcpp::S4 model(clone(xmod)) ;
+  Rcpp::S4 model(xmod) ;
   Rcpp::S4 hypp(model.slot("hyperparams")) ;
-  int K = getK(hypp) ;
   NumericMatrix sigma2 = model.slot("sigma2") ;
-  int B = sigma2.nrow() ;  
-  double sigma2_0 = model.slot("sigma2.0") ;  
+  double sigma2_0 = model.slot("sigma2.0") ;
   double prec = 0.0;
   double lprec = 0.0 ;
   double betas = hypp.slot("beta") ;
-  for(int i = 0; i < B; ++i){
-    for(int k = 0; k < K; ++k){
-      prec += 1.0/sigma2(i, k) ;
-      lprec += log(1.0/sigma2(i, k)) ;
-    }
+  for(int i = 0; i < sigma2.size(); ++i){
+    prec += 1.0/sigma2[i] ;
+    lprec += log(1.0/sigma2[i]) ;
   }
-  NumericVector x(100) ;  
-  for(int i = 0; i < 100; i++)  x[i] = i+1 ;
-  NumericVector lpnu0(100);
-  NumericVector y1(100) ;
-  NumericVector y2(100) ;
-  NumericVector y3(100) ;
-  NumericVector prob(100) ;
-  y1 = (B*K)*(0.5*x*log(sigma2_0*0.5*x) - lgamma(x*0.5)) ;
-  y2 = (0.5*x - 1.0) * lprec ;
-  y3 = x*(betas + 0.5*sigma2_0*prec) ;
-  lpnu0 =  y1 + y2 - y3 ;
-  prob = exp(lpnu0) ; // - maxprob) ;
-  prob = prob/sum(prob) ;
+  const Nu0Grid& grid = nu0_grid(getNu0Max(hypp)) ;
   NumericVector nu0(1) ;
-  //int u ;
-  NumericVector u(1) ;
-  double cumprob = 0.0;
-  // sample x with probability prob
-  for(int i = 0; i < 100; i++){
-    cumprob += prob[i] ;
-    u = runif(1) ;
-    if (u[0] < cumprob){
-      nu0[0] = x[i] ;
-      break ;
-    }
-  }
-  return nu0 ;  
+  nu0[0] = grid.sample(sigma2.size(), sigma2_0, prec, lprec, betas) ;
+  return nu0 ;
 }
 
 // [[Rcpp::export]]
@@ -308,7 +269,7 @@ Rcpp::NumericMatrix update_multinomialPr(Rcpp::S4 xmod) {
 // [[Rcpp::export]]
 Rcpp::NumericVector update_p(Rcpp::S4 xmod) {
   RNGScope scope ;
-  Rcpp::S4 model(clone(xmod)) ;
+  Rcpp::S4 model(xmod) ;
   Rcpp::S4 hypp(model.slot("hyperparams")) ;
   int K = getK(hypp) ;
   // IntegerVector z = model.slot("z") ;  
@@ -463,7 +424,7 @@ Rcpp::NumericVector compute_logprior(Rcpp::S4 xmod) {
     RNGScope scope;
     
     // Get model/accessories
-    Rcpp::S4 model(clone(xmod)) ;
+    Rcpp::S4 model(xmod) ;
     Rcpp::S4 hypp(model.slot("hyperparams"));
 
     // get hyperparameters
@@ -490,7 +451,7 @@ Rcpp::NumericVector compute_logprior(Rcpp::S4 xmod) {
 // [[Rcpp::export]]
 Rcpp::NumericVector stageTwoLogLikBatch(Rcpp::S4 xmod) {
   RNGScope scope ;
-  Rcpp::S4 model(clone(xmod)) ;
+  Rcpp::S4 model(xmod) ;
   NumericMatrix theta = model.slot("theta") ;
   NumericVector tau2 = model.slot("tau2") ;
   NumericVector mu = model.slot("mu") ;
@@ -518,7 +479,7 @@ Rcpp::NumericVector stageTwoLogLikBatch(Rcpp::S4 xmod) {
 // [[Rcpp::export]]
 Rcpp::NumericMatrix update_theta(Rcpp::S4 xmod){
   RNGScope scope ;
-  Rcpp::S4 model(clone(xmod)) ;
+  Rcpp::S4 model(xmod) ;
   Rcpp::S4 hypp(model.slot("hyperparams")) ;
   int K = getK(hypp) ;
   NumericVector x = model.slot("data") ;
@@ -561,7 +522,7 @@ Rcpp::NumericMatrix update_theta(Rcpp::S4 xmod){
 // [[Rcpp::export]]
 Rcpp::NumericMatrix update_sigma2(Rcpp::S4 xmod){
     Rcpp::RNGScope scope;
-    Rcpp::S4 model(clone(xmod)) ;
+    Rcpp::S4 model(xmod) ;
     // get model
     // get parameter estimates
     Rcpp::NumericMatrix theta = model.slot("theta");
@@ -671,13 +632,14 @@ Rcpp::IntegerVector order_(Rcpp::NumericVector x) {
 // [[Rcpp::export]]
 Rcpp::IntegerMatrix update_probz(Rcpp::S4 xmod){
   RNGScope scope ;
-  Rcpp::S4 model(clone(xmod)) ;
+  Rcpp::S4 model(xmod) ;
   Rcpp::S4 hypp(model.slot("hyperparams")) ;
   int K = hypp.slot("k") ;
   IntegerVector z = model.slot("z") ;
   NumericMatrix theta = model.slot("theta") ;
   int N = z.size() ;
-  IntegerMatrix pZ = model.slot("probz") ;
+  // the counts are returned in a copy
+  IntegerMatrix pZ = clone(IntegerMatrix(model.slot("probz"))) ;
   //
   // update probz such that the z value corresponding to the lowest
   // mean is 1, the second lowest mean is 2, etc.
@@ -700,177 +662,15 @@ Rcpp::IntegerMatrix update_probz(Rcpp::S4 xmod){
   return pZ ;
 }
 
+// start > 0 resumes from a checkpoint (see resumeMcmc)
 // [[Rcpp::export]]
-Rcpp::S4 cpp_burnin(Rcpp::S4 object) {
-  RNGScope scope ;
-  Rcpp::S4 model(clone(object)) ;
-  Rcpp::S4 hypp(model.slot("hyperparams")) ;
-  int K = getK(hypp) ;
-  Rcpp::S4 params(model.slot("mcmc.params")) ;
-  IntegerVector up = params.slot("param_updates") ;
-  int S = params.slot("burnin") ;
-  NumericVector x = model.slot("data") ;
-  int N = x.size() ;
-  double df = getDf(model.slot("hyperparams")) ;
-  //
-  // S = the number of burnin iterations
-  // *No need to have a zero based index here*
-  //
-  for(int s = 1; s < S; ++s){
-    model.slot("z") = update_z(model) ;
-    model.slot("zfreq") = tableZ(K, model.slot("z")) ;
-    model.slot("theta") = update_theta(model) ;
-    model.slot("sigma2") = update_sigma2(model) ;
-    model.slot("mu") = update_mu(model) ;
-    model.slot("tau2") = update_tau2(model) ;
-    model.slot("sigma2.0") = update_sigma20(model) ;
-    model.slot("nu.0") = update_nu0(model) ;
-    model.slot("pi") = update_p(model) ;
-    model.slot("u") = Rcpp::rchisq(N, df) ;
-  }
-  // compute log prior probability from last iteration of burnin
-  // compute log likelihood from last iteration of burnin
-  NumericVector lls2(1);
-  NumericVector ll(1);
-  lls2 = stageTwoLogLikBatch(model);
-  ll = compute_loglik(model);
-  ll = ll + lls2;
-  model.slot("loglik") = ll;
-  model.slot("logprior") = compute_logprior(model) ;
-  return model ;
+Rcpp::S4 cpp_burnin(Rcpp::S4 object, int start = 0) {
+  Rcpp::S4 params(object.slot("mcmc.params")) ;
+  return burnin_sampler(object, params, false, start) ;
 }
 
 // [[Rcpp::export]]
-Rcpp::S4 cpp_mcmc(Rcpp::S4 object) {
-  RNGScope scope ;
-  Rcpp::S4 model(clone(object)) ;
-  Rcpp::S4 chain(model.slot("mcmc.chains")) ;
-  Rcpp::S4 hypp(model.slot("hyperparams")) ;
-  Rcpp::S4 params(model.slot("mcmc.params")) ;
-  IntegerVector up = params.slot("param_updates") ;
-  int T = params.slot("thin") ;
-  T = T - 1;
-  int S = params.slot("iter") ;
-  S = S - 1;
-  NumericVector x = model.slot("data") ;
-  int N = x.size() ;
-  double df = getDf(model.slot("hyperparams")) ;
-  NumericMatrix thetac = chain.slot("theta") ;
-  NumericMatrix sigma2c = chain.slot("sigma2") ;
-  NumericMatrix th = model.slot("theta");
-  int B = th.nrow();
-  int K = th.ncol();
-  NumericMatrix s2(B, K);
-  NumericMatrix pmix = chain.slot("pi") ;
-  NumericMatrix zfreq = chain.slot("zfreq") ;
-  NumericMatrix mu = chain.slot("mu") ;
-  NumericMatrix tau2 = chain.slot("tau2") ;
-  NumericVector nu0 = chain.slot("nu.0") ;
-  NumericVector sigma2_0 = chain.slot("sigma2.0") ;
-  NumericVector loglik_ = chain.slot("loglik") ;
-  NumericVector logprior_ = chain.slot("logprior") ;
-  NumericMatrix predictive_ = chain.slot("predictive") ;
-  IntegerMatrix zstar_ = chain.slot("zstar") ;
-  NumericVector p(K) ;
-  NumericVector m(K) ; //mu
-  NumericVector t2(K) ;//tau2
-  NumericVector n0(1) ;//nu0
-  IntegerVector z(N) ;
-  NumericVector u(N) ;
-  NumericVector s20(1) ; //sigma2_0
-  NumericVector lls2(1) ;  // stage 2 log lik
-  NumericVector ll(1) ;
-  NumericVector lp(1) ;
-  IntegerVector tmp(K) ;
-  IntegerVector zf(K) ;
-  Rcpp::NumericVector ystar = NumericVector(B*K);
-  Rcpp::IntegerVector zstar = IntegerVector(B*K);
-  //
-  // This for-loop uses a zero-based index
-  //
-  // For each parameter update
-  //       a.  update values in 'current value' slots
-  //       b.  update chain
-  //
-  // The current value at simulation s is the s-1 row of the chain.
-  //
-  for(int s = 0; s < (S + 1); ++s){
-    z = update_z(model) ;
-    model.slot("z") = z ;
-    tmp = tableZ(K, z) ;
-    model.slot("zfreq") = tmp ;
-    zfreq(s, _) = tmp ;
-    model.slot("probz") = update_probz(model) ;
-    model.slot("theta") = update_theta(model) ;
-    thetac(s, _) = as<Rcpp::NumericVector>(model.slot("theta")) ;
-    model.slot("sigma2") = update_sigma2(model) ;
-    sigma2c(s, _) = as<Rcpp::NumericVector>(model.slot("sigma2"));
-    p = update_p(model) ;
-    model.slot("pi") = p ;
-    pmix(s, _) = p ;
-    m = update_mu(model) ;
-    model.slot("mu") = m ;
-    mu(s, _) = m ;
-    t2 = update_tau2(model) ;
-    model.slot("tau2") = t2 ;
-    tau2(s, _) = t2 ;
-    n0 = update_nu0(model) ;
-    model.slot("nu.0") = n0 ;
-    nu0[s] = n0[0] ;
-    s20 = update_sigma20(model) ;
-    model.slot("sigma2.0") = s20 ;
-    s20 = model.slot("sigma2.0") ;
-    sigma2_0[s] = s20[0] ;
-    ll = compute_loglik(model) ;
-    lls2 = stageTwoLogLikBatch(model) ;
-    ll = ll + lls2 ;
-    loglik_[s] = ll[0] ;
-    model.slot("loglik") = ll ;
-
-    lp = compute_logprior(model) ;
-    logprior_[s] = lp[0] ;
-    model.slot("logprior") = lp ;
-    u = Rcpp::rchisq(N, df) ;
-    model.slot("u") = u;
-    //
-    // posterior predictive
-    //  - for each simulation, simulate ystar from current values in chain
-    //
-    model = update_predictive(model);
-    ystar = model.slot("predictive");
-    zstar = model.slot("zstar");
-    predictive_(s, _) = ystar ;
-    zstar_(s, _) = zstar ;
-    //
-    // There is no thinning if thin parameter is less than 1
-    // (T = thin parameter -1)
-    //
-    for(int t = 0; t < T; ++t){
-      model.slot("z") = update_z(model) ;
-      model.slot("zfreq") = tableZ(K, model.slot("z")) ;
-      model.slot("theta") = update_theta(model) ;
-      model.slot("sigma2") = update_sigma2(model) ;
-      model.slot("pi") = update_p(model) ;
-      model.slot("mu") = update_mu(model) ;
-      model.slot("tau2") = update_tau2(model) ;
-      model.slot("nu.0") = update_nu0(model) ;
-      model.slot("sigma2.0") = update_sigma20(model) ;
-      model.slot("u") = Rcpp::rchisq(N, df) ;
-    }
-  }
-  //
-  // assign chains back to object
-  //
-  chain.slot("theta") = thetac ;
-  chain.slot("sigma2") = sigma2c ;
-  chain.slot("pi") = pmix ;
-  chain.slot("mu") = mu ;
-  chain.slot("tau2") = tau2 ;
-  chain.slot("nu.0") = nu0 ;
-  chain.slot("sigma2.0") = sigma2_0 ;
-  chain.slot("zfreq") = zfreq ;
-  chain.slot("loglik") = loglik_ ;
-  chain.slot("logprior") = logprior_ ;
-  model.slot("mcmc.chains") = chain ;
-  return model ;
+Rcpp::S4 cpp_mcmc(Rcpp::S4 object, int start = 0) {
+  Rcpp::S4 params(object.slot("mcmc.params")) ;
+  return mcmc_sampler(object, params, false, start) ;
 }
@@ -1,5 +1,7 @@
 #include "miscfunctions.h" // for rdirichlet
 #include "multibatch.h" // getK
+#include "conditionals.h"
+#include "sampler.h"
 #include <Rmath.h>
 #include <Rcpp.h>
 
@@ -129,37 +131,26 @@ Rcpp::NumericVector loglik_multibatch_pvar(Rcpp::S4 xmod){
 // [[Rcpp::export]]
 Rcpp::NumericVector sigma20_multibatch_pvar(Rcpp::S4 xmod){
     RNGScope scope ;
-    Rcpp::S4 model_(xmod);
-    Rcpp::S4 model = clone(model_);
+    Rcpp::S4 model(xmod) ;
     Rcpp::S4 hypp(model.slot("hyperparams")) ;
     int K = getK(hypp) ;
-    IntegerVector batch = model.slot("batch") ;
-    IntegerVector ub = unique_batch(batch) ;
-    int B = ub.size() ;
-    NumericVector a = hypp.slot("a") ;
-    NumericVector b = hypp.slot("b") ;
-    NumericVector nu_0 = model.slot("nu.0") ;
+    double a = hypp.slot("a") ;
+    double b = hypp.slot("b") ;
+    double nu_0 = model.slot("nu.0") ;
+    // sigma2 is a vector of length B (B = number batches)
     NumericVector sigma2 = model.slot("sigma2") ;
+    int B = sigma2.size() ;
     Rcpp::NumericVector sigma2_0_old = model.slot("sigma2.0");
-    NumericVector prec(1) ;
-
+    double prec = 0.0 ;
     for(int i = 0; i < B; ++i){
-      //for(int k = 0; k < K; ++k){
-      //prec[0] += 1.0/sigma2(i, k) ;
-      prec[0] += 1.0/sigma2[i] ;
-      //  }
+      prec += 1.0/sigma2[i] ;
     }
-
-    NumericVector a_k(1) ;
-    NumericVector b_k(1) ;
-    // is this right?
-    a_k[0] = a[0] + 0.5*(K * B)*nu_0[0] ;
-    b_k[0] = b[0] + 0.5*nu_0[0]*prec[0] ;
+    double shape ;
     double rate ;
-    rate = 1.0/b_k[0] ;
-    //return b_k ;
+    // is this right?
+    sigma20_conditional(a, b, K * B, nu_0, prec, shape, rate) ;
     NumericVector sigma2_0(1) ;
-    sigma2_0[0] = as<double>(rgamma(1, a_k[0], rate)) ;
+    sigma2_0[0] = R::rgamma(shape, 1.0/rate) ;
     double constraint = model.slot(".internal.constraint");
     if (constraint > 0) {
         if (sigma2_0[0] < constraint) {
@@ -177,8 +168,7 @@ Rcpp::NumericVector sigma20_multibatch_pvar(Rcpp::S4 xmod){
 // [[Rcpp::export]]
 Rcpp::NumericVector nu0_multibatch_pvar(Rcpp::S4 xmod){
   RNGScope scope ;
-  Rcpp::S4 model_(xmod);
-  Rcpp::S4 model = clone(model_);
+  Rcpp::S4 model(xmod) ;
   Rcpp::S4 hypp(model.slot("hyperparams")) ;
   int K = getK(hypp) ;
   NumericVector sigma2 = model.slot("sigma2") ;
@@ -188,39 +178,12 @@ Rcpp::NumericVector nu0_multibatch_pvar(Rcpp::S4 xmod){
   double lprec = 0.0 ;
   double betas = hypp.slot("beta") ;
   for(int i = 0; i < B; ++i){
-    //for(int k = 0; k < K; ++k){
-    //prec += 1.0/sigma2(i, k) ;
     prec += 1.0/sigma2[i] ;
-    //lprec += log(1.0/sigma2(i, k)) ;
     lprec += log(1.0/sigma2[i]);
-    //}
   }
-  NumericVector x(100) ;
-  for(int i = 0; i < 100; i++)  x[i] = i+1 ;
-  NumericVector lpnu0(100);
-  NumericVector y1(100) ;
-  NumericVector y2(100) ;
-  NumericVector y3(100) ;
-  NumericVector prob(100) ;
-  y1 = (B*K)*(0.5*x*log(sigma2_0*0.5*x) - lgamma(x*0.5)) ;
-  y2 = (0.5*x - 1.0) * lprec ;
-  y3 = x*(betas + 0.5*sigma2_0*prec) ;
-  lpnu0 =  y1 + y2 - y3 ;
-  prob = exp(lpnu0) ; // - maxprob) ;
-  prob = prob/sum(prob) ;
+  const Nu0Grid& grid = nu0_grid(getNu0Max(hypp)) ;
   NumericVector nu0(1) ;
-  //int u ;
-  NumericVector u(1) ;
-  double cumprob = 0.0;
-  // sample x with probability prob
-  for(int i = 0; i < 100; i++){
-    cumprob += prob[i] ;
-    u = runif(1) ;
-    if (u[0] < cumprob){
-      nu0[0] = x[i] ;
-      break ;
-    }
-  }
+  nu0[0] = grid.sample(B * K, sigma2_0, prec, lprec, betas) ;
   return nu0 ;
 }
 
@@ -441,169 +404,11 @@ Rcpp::NumericVector sigma2_multibatch_pvar(Rcpp::S4 xmod){
 }
 
 // [[Rcpp::export]]
-Rcpp::S4 burnin_multibatch_pvar(Rcpp::S4 object, Rcpp::S4 mcmcp) {
-  RNGScope scope ;
-  Rcpp::S4 model(clone(object)) ;
-  Rcpp::S4 hypp(model.slot("hyperparams")) ;
-  int K = getK(hypp) ;
-  Rcpp::S4 params(mcmcp) ;
-  IntegerVector up = params.slot("param_updates") ;
-  int S = params.slot("burnin") ;
-  NumericVector x = model.slot("data") ;
-  int N = x.size() ;
-  double df = getDf(model.slot("hyperparams")) ;
-  if( S < 1 ){
-    return model ;
-  }
-  for(int s = 0; s < S; ++s){
-    model.slot("z") = z_multibatch_pvar(model) ;
-    model.slot("zfreq") = tableZ(K, model.slot("z")) ;
-    model.slot("theta") = theta_multibatch_pvar(model) ;
-    model.slot("sigma2") = sigma2_multibatch_pvar(model) ;
-    model.slot("mu") = update_mu(model) ;
-    model.slot("tau2") = update_tau2(model) ;
-    model.slot("sigma2.0") = sigma20_multibatch_pvar(model) ;
-    model.slot("nu.0") = nu0_multibatch_pvar(model) ;
-    model.slot("pi") = update_p(model) ;
-    model.slot("u") = Rcpp::rchisq(N, df) ;
-  }
-  // compute log prior probability from last iteration of burnin
-  // compute log likelihood from last iteration of burnin
-  NumericVector ll(1);
-  NumericVector lls2(1);
-  ll = loglik_multibatch_pvar(model);
-  lls2 = stagetwo_multibatch_pvar(model);
-  ll = ll + lls2;
-  model.slot("loglik") = ll ;
-  model.slot("logprior") = compute_logprior(model) ;
-  return model ;
+Rcpp::S4 burnin_multibatch_pvar(Rcpp::S4 object, Rcpp::S4 mcmcp, int start = 0) {
+  return burnin_sampler(object, mcmcp, true, start) ;
 }
 
 // [[Rcpp::export]]
-Rcpp::S4 mcmc_multibatch_pvar(Rcpp::S4 object, Rcpp::S4 mcmcp) {
-  RNGScope scope ;
-  Rcpp::S4 model(clone(object)) ;
-  Rcpp::S4 chain(model.slot("mcmc.chains")) ;
-  Rcpp::S4 hypp(model.slot("hyperparams")) ;
-  Rcpp::S4 params(mcmcp) ;
-  IntegerVector up = params.slot("param_updates") ;
-  int K = getK(hypp) ;
-  int T = params.slot("thin") ;
-  int S = params.slot("iter") ;
-  S--; // decrement so that S is a zero-based index
-  T--;
-  NumericVector x = model.slot("data") ;
-  int N = x.size() ;
-  double df = getDf(model.slot("hyperparams")) ;
-  NumericMatrix theta = chain.slot("theta") ;
-  int B = theta.nrow();
-  NumericMatrix sigma2 = chain.slot("sigma2") ;
-  NumericMatrix pmix = chain.slot("pi") ;
-  NumericMatrix zfreq = chain.slot("zfreq") ;
-  NumericMatrix mu = chain.slot("mu") ;
-  NumericMatrix tau2 = chain.slot("tau2") ;
-  NumericVector nu0 = chain.slot("nu.0") ;
-  NumericVector sigma2_0 = chain.slot("sigma2.0") ;
-  NumericVector loglik_ = chain.slot("loglik") ;
-  NumericVector logprior_ = chain.slot("logprior") ;
-  NumericMatrix predictive_ = chain.slot("predictive") ;
-  IntegerMatrix zstar_ = chain.slot("zstar") ;
-  NumericVector th(K) ;
-  NumericVector s2(K) ;
-  NumericVector p(K) ;
-  NumericVector m(K) ; //mu
-  NumericVector t2(K) ;//tau2
-  NumericVector n0(1) ;//nu0
-  IntegerVector z(N) ;
-  NumericVector u(N) ;
-  NumericVector s20(1) ; //sigma2_0
-  NumericVector ll(1) ;
-  NumericVector lls2(1) ;
-  NumericVector lp(1) ;
-  IntegerVector tmp(K) ;
-  IntegerVector zf(K) ;
-  Rcpp::NumericVector ystar = NumericVector(B*K);
-  Rcpp::IntegerVector zstar = IntegerVector(B*K);
-  //
-  // This for-loop uses a zero-based index
-  //
-  // For each parameter update
-  //       a.  update values in 'current value' slots
-  //       b.  update chain
-  //
-  // The current value at simulation s is the s-1 row of the chain.
-  //
-  for(int s = 0; s < (S + 1); ++s){
-    z = z_multibatch_pvar(model) ;
-    model.slot("z") = z ;
-    tmp = tableZ(K, z) ;
-    model.slot("probz") = update_probz(model) ;
-    model.slot("zfreq") = tmp ;
-    // mean and prec only change if z is updated
-    zfreq(s, _) = tmp ;
-    th = as<Rcpp::NumericVector>(theta_multibatch_pvar(model));
-    model.slot("theta") = th ;
-    theta(s, _) = th ;
-    s2 = sigma2_multibatch_pvar(model);
-    model.slot("sigma2") = s2 ;
-    sigma2(s, _) = s2 ;
-    p = update_p(model) ;
-    model.slot("pi") = p ;
-    pmix(s, _) = p ;
-    m = update_mu(model) ;
-    model.slot("mu") = m ;
-    mu(s, _) = m ;
-    t2 = update_tau2(model) ;
-    model.slot("tau2") = t2 ;
-    tau2(s, _) = t2 ;
-    n0 = nu0_multibatch_pvar(model) ;
-    model.slot("nu.0") = n0 ;
-    nu0[s] = n0[0] ;
-    s20 = sigma20_multibatch_pvar(model) ;
-    model.slot("sigma2.0") = s20 ;
-    sigma2_0[s] = s20[0] ;
-    ll = loglik_multibatch_pvar(model) ;
-    lls2 = stagetwo_multibatch_pvar(model) ;
-    ll = ll + lls2 ;
-    loglik_[s] = ll[0] ;
-    model.slot("loglik") = ll ;
-    lp = compute_logprior(model) ;
-    logprior_[s] = lp[0] ;
-    model.slot("logprior") = lp ;
-    u = Rcpp::rchisq(N, df) ;
-    model.slot("u") = u ;
-    model = update_predictiveP(model);
-    ystar = model.slot("predictive");
-    zstar = model.slot("zstar");
-    predictive_(s, _) = ystar ;
-    zstar_(s, _) = zstar ;
-    // Thinning
-    for(int t = 0; t < T; ++t){
-      model.slot("z") = z_multibatch_pvar(model) ;
-      model.slot("zfreq") = tableZ(K, model.slot("z")) ;
-      model.slot("theta") = theta_multibatch_pvar(model) ;
-      model.slot("sigma2") = sigma2_multibatch_pvar(model) ;
-      model.slot("pi") = update_p(model) ;
-      model.slot("mu") = update_mu(model) ;
-      model.slot("tau2") = update_tau2(model) ;
-      model.slot("nu.0") = nu0_multibatch_pvar(model) ;
-      model.slot("sigma2.0") = sigma20_multibatch_pvar(model) ;
-      model.slot("u") = Rcpp::rchisq(N, df) ;
-    }
-  }
-  //
-  // assign chains back to object
-  //
-  chain.slot("theta") = theta ;
-  chain.slot("sigma2") = sigma2 ;
-  chain.slot("pi") = pmix ;
-  chain.slot("mu") = mu ;
-  chain.slot("tau2") = tau2 ;
-  chain.slot("nu.0") = nu0 ;
-  chain.slot("sigma2.0") = sigma2_0 ;
-  chain.slot("zfreq") = zfreq ;
-  chain.slot("loglik") = loglik_ ;
-  chain.slot("logprior") = logprior_ ;
-  model.slot("mcmc.chains") = chain ;
-  return model ;
+Rcpp::S4 mcmc_multibatch_pvar(Rcpp::S4 object, Rcpp::S4 mcmcp, int start = 0) {
+  return mcmc_sampler(object, mcmcp, true, start) ;
 }
@@ -1,5 +1,6 @@
 #include "miscfunctions.h" // for rdirichlet, tableZ, ...
 #include "multibatch.h"
+#include "conditionals.h"
 #include <Rcpp.h>
 #include <Rmath.h>
 
@@ -462,44 +463,24 @@ double log_prob_nu0(Rcpp::S4 xmod, int nu0star) {
   Rcpp::RNGScope scope;
   // get model and accessories
   Rcpp::S4 model(xmod);
-  Rcpp::S4 mcmcp = model.slot("mcmc.params");
   Rcpp::S4 hypp = model.slot("hyperparams");
   Rcpp::List modes = model.slot("modes");
   // get modal ordinates
-  Rcpp::NumericMatrix sigma2_ = Rcpp::as<Rcpp::NumericMatrix>(modes["sigma2"]);
-  Rcpp::NumericMatrix sigma2star = clone(sigma2_);
+  Rcpp::NumericMatrix sigma2star = Rcpp::as<Rcpp::NumericMatrix>(modes["sigma2"]);
   // hyperparameters
-  int K = hypp.slot("k");
   double betas = hypp.slot("beta");
-  int B = sigma2star.nrow() ;
   Rcpp::NumericVector s20=model.slot("sigma2.0") ;
-  //
-  // compute p(nu0*, ) from *normalized* probabilities
-  //
-  Rcpp::NumericVector d(100) ;  // 100 is the maximum allowed value for nu_0
-  Rcpp::NumericVector lpnu0(100);
   double prec = 0.0;
   double lprec = 0.0;
-  d = Rcpp::seq_len(100);
-  for (int b = 0; b < B; ++b) {
-    for (int k = 0; k < K; ++k) {
-      prec += 1.0 / sigma2star(b, k);
-      lprec += log(1.0 / sigma2star(b, k));
-    }
+  for (int i = 0; i < sigma2star.size(); ++i) {
+    prec += 1.0 / sigma2star[i];
+    lprec += log(1.0 / sigma2star[i]);
   }
-  Rcpp::NumericVector y1(100);
-  Rcpp::NumericVector y2(100);
-  Rcpp::NumericVector y3(100);
-  y1 = B * K * (0.5 * d * log(s20[0] * 0.5 * d) - lgamma(d * 0.5));
-  y2 = (0.5 * d - 1.0) * lprec;
-  y3 = d * (betas + 0.5 * s20[0] * prec);
-  lpnu0 = y1 + y2 - y3;
-  Rcpp::NumericVector prob(100);
-  prob = exp(lpnu0); // - maxprob);
-  prob = prob / sum(prob);  // this is now normalized
-  //p_nu0[s] = prob[nu0star];
-  double log_p = log(prob[nu0star]) ;
-  return log_p ;
+  //
+  // compute p(nu0*, ) from *normalized* probabilities
+  //
+  const Nu0Grid& grid = nu0_grid(getNu0Max(hypp)) ;
+  return grid.log_prob(nu0star, sigma2star.size(), s20[0], prec, lprec, betas) ;
 }
 
 // [[Rcpp::export]]
@@ -544,35 +525,25 @@ double log_prob_s20(Rcpp::S4 xmod) {
   Rcpp::RNGScope scope;
   // get model and accessories
   Rcpp::S4 model(xmod);
-  Rcpp::S4 mcmcp = model.slot("mcmc.params");
-  Rcpp::S4 chains = model.slot("mcmc.chains");
   Rcpp::S4 hypp = model.slot("hyperparams");
   Rcpp::List modes = model.slot("modes");
-  Rcpp::IntegerVector batch = model.slot("batch");
-  Rcpp::IntegerVector ub = unique_batch(batch);
-  int B = ub.size();
   // get ordinal modes.
   Rcpp::IntegerVector nu0_ = Rcpp::as<Rcpp::IntegerVector>(modes["nu0"]);
-  Rcpp::NumericMatrix sigma2_ = Rcpp::as<Rcpp::NumericMatrix>(modes["sigma2"]);
-  Rcpp::NumericMatrix sigma2star = clone(sigma2_);
+  Rcpp::NumericMatrix sigma2star = Rcpp::as<Rcpp::NumericMatrix>(modes["sigma2"]);
   Rcpp::NumericVector s20_ = Rcpp::as<Rcpp::NumericVector>(modes["sigma2.0"]);
-  Rcpp::NumericVector s20star = clone(s20_);
-  double nu0star = clone(nu0_)[0];
+  double nu0star = nu0_[0];
   // get hyperparameters
-  int K = hypp.slot("k");
   double a = hypp.slot("a");
   double b = hypp.slot("b");
   // calculate a_k, b_k
   double prec = 0.0;
-  for (int b = 0; b < B; ++b) {
-    for (int k = 0; k < K; ++k) {
-      prec += 1.0 / sigma2star(b, k);
-    }
+  for (int i = 0; i < sigma2star.size(); ++i) {
+    prec += 1.0 / sigma2star[i];
   }
-  double a_k = a + 0.5 * K * B * nu0star;
-  double b_k = b + 0.5 * nu0star * prec;
-  Rcpp::NumericVector logp_s20 = dgamma(s20star, a_k, 1.0 / b_k, true);
-  return logp_s20[0] ;
+  double a_k ;
+  double b_k ;
+  sigma20_conditional(a, b, sigma2star.size(), nu0star, prec, a_k, b_k) ;
+  return R::dgamma(s20_[0], a_k, 1.0 / b_k, true) ;
 }
 
 // [[Rcpp::export]]
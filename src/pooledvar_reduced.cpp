@@ -2,6 +2,7 @@
 #include "multibatch.h"
 #include "multibatch_reduced.h"
 #include "multibatch_pooledvar.h"
+#include "conditionals.h"
 #include <Rcpp.h>
 #include <Rmath.h>
 
@@ -311,40 +312,24 @@ Rcpp::NumericVector reduced_tau2_pooled(Rcpp::S4 xmod) {
 double log_prob_nu0p(Rcpp::S4 xmod, int nu0star) {
     Rcpp::RNGScope scope;
     // get model and accessories
-    Rcpp::S4 model_(xmod);
-    Rcpp::S4 model = clone(model_);
-    Rcpp::S4 mcmcp = model.slot("mcmc.params");
+    Rcpp::S4 model(xmod);
     Rcpp::S4 hypp = model.slot("hyperparams");
     Rcpp::List modes = model.slot("modes");
     // get modal ordinates
-    Rcpp::NumericVector sigma2_ = Rcpp::as<Rcpp::NumericVector>(modes["sigma2"]);
-    Rcpp::NumericVector sigma2star = clone(sigma2_);
+    Rcpp::NumericVector sigma2star = Rcpp::as<Rcpp::NumericVector>(modes["sigma2"]);
     // hyperparameters
     int K = hypp.slot("k");
     double betas = hypp.slot("beta");
     int B = sigma2star.size() ;
     Rcpp::NumericVector s20 = model.slot("sigma2.0");
-    Rcpp::NumericVector d(100) ;  // 100 is the maximum allowed value for nu_0
-    Rcpp::NumericVector lpnu0(100);
     double prec = 0.0;
     double lprec = 0.0;
-    d = Rcpp::seq_len(100);
     for (int b = 0; b < B; ++b) {
       prec += 1.0/sigma2star[b];
       lprec += log(1.0 / sigma2star[b]);
     }
-    Rcpp::NumericVector y1(100);
-    Rcpp::NumericVector y2(100);
-    Rcpp::NumericVector y3(100);
-    y1 = B * K * (0.5 * d * log(s20[0] * 0.5 * d) - lgamma(d * 0.5));
-    y2 = (0.5 * d - 1.0) * lprec;
-    y3 = d * (betas + 0.5 * s20[0] * prec);
-    lpnu0 = y1 + y2 - y3;
-    Rcpp::NumericVector prob(100);
-    prob = exp(lpnu0); //
-    prob = prob / sum(prob);  // this is now normalized
-    double log_p = log(prob[nu0star]) ;
-    return log_p ;
+    const Nu0Grid& grid = nu0_grid(getNu0Max(hypp)) ;
+    return grid.log_prob(nu0star, B * K, s20[0], prec, lprec, betas) ;
 }
 
 // [[Rcpp::export]]
@@ -389,7 +374,6 @@ double log_prob_s20p(Rcpp::S4 xmod) {
   Rcpp::RNGScope scope;
   // get model and accessories
   Rcpp::S4 model(xmod);
-  Rcpp::S4 mcmcp = model.slot("mcmc.params");
   Rcpp::S4 hypp = model.slot("hyperparams");
   Rcpp::List modes = model.slot("modes");
   Rcpp::IntegerVector batch = model.slot("batch");
@@ -397,11 +381,9 @@ double log_prob_s20p(Rcpp::S4 xmod) {
   int B = ub.size();
   // get ordinal modes.
   Rcpp::IntegerVector nu0_ = Rcpp::as<Rcpp::IntegerVector>(modes["nu0"]);
-  Rcpp::NumericVector sigma2_ = Rcpp::as<Rcpp::NumericVector>(modes["sigma2"]);
+  Rcpp::NumericVector sigma2star = Rcpp::as<Rcpp::NumericVector>(modes["sigma2"]);
   Rcpp::NumericVector s20_ = Rcpp::as<Rcpp::NumericVector>(modes["sigma2.0"]);
-  Rcpp::NumericVector sigma2star = clone(sigma2_);
-  Rcpp::NumericVector s20star = clone(s20_);
-  double nu0star = clone(nu0_)[0];
+  double nu0star = nu0_[0];
   // get hyperparameters
   int K = hypp.slot("k");
   double a = hypp.slot("a");
@@ -411,9 +393,8 @@ double log_prob_s20p(Rcpp::S4 xmod) {
   for (int b = 0; b < B; ++b) {
     prec += 1.0 / sigma2star[b];
   }
-  double a_k = a + 0.5 * K * B * nu0star;
-  double b_k = b + 0.5 * nu0star * prec;
-  Rcpp::NumericVector p_s20 = dgamma(s20star, a_k, 1.0 / b_k, true);
-  double logp = p_s20[0];
-  return logp ;
+  double a_k ;
+  double b_k ;
+  sigma20_conditional(a, b, K * B, nu0star, prec, a_k, b_k) ;
+  return R::dgamma(s20_[0], a_k, 1.0 / b_k, true) ;
 }
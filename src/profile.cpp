@@ -0,0 +1,25 @@
+#include "profile.h"
+
+#ifndef CNPBAYES_STANDALONE
+using namespace Rcpp ;
+
+Rcpp::List SamplerProfile::add_to(Rcpp::List profiles, const std::string& phase) const {
+  NumericMatrix m(PROF_STEPS, 2) ;
+  bool found = profiles.containsElementNamed(phase.c_str()) ;
+  if(found){
+    NumericMatrix old = profiles[phase] ;
+    if(old.nrow() == PROF_STEPS && old.ncol() == 2) m = clone(old) ;
+  }
+  for(int j = 0; j < PROF_STEPS; ++j){
+    m(j, 0) += calls[j] ;
+    m(j, 1) += seconds[j] ;
+  }
+  CharacterVector rows(PROF_STEPS) ;
+  for(int j = 0; j < PROF_STEPS; ++j) rows[j] = PROFILE_NAMES[j] ;
+  m.attr("dimnames") = List::create(rows, CharacterVector::create("calls", "seconds")) ;
+  List out = clone(profiles) ;
+  if(found) out[phase] = m ;
+  else out.push_back(m, phase) ;
+  return out ;
+}
+#endif
@@ -0,0 +1,72 @@
+#ifndef _profile_H
+#define _profile_H
+#include "rmath.h"
+#include <string>
+
+//
+// Cumulative wall time and number of calls of each conditional update
+// of the samplers.  Profiling is enabled at run time by
+// McmcParams(profile=TRUE); a disabled profile costs one branch per
+// update.  Defining CNPBAYES_NO_PROFILE at compile time removes the
+// timers altogether.
+//
+// The z update includes the tabulation of the component counts and, for
+// trio models, the Mendelian indicators.  loglik includes the log prior.
+//
+#ifndef CNPBAYES_NO_PROFILE
+#include <chrono>
+#endif
+
+enum ProfileStep {
+  PROF_Z, PROF_THETA, PROF_SIGMA2, PROF_MU, PROF_TAU2, PROF_NU0,
+  PROF_SIGMA20, PROF_PI, PROF_U, PROF_LOGLIK, PROF_PREDICTIVE,
+  PROF_PROBZ, PROF_STEPS
+} ;
+
+const char* const PROFILE_NAMES[PROF_STEPS] = {
+  "z", "theta", "sigma2", "mu", "tau2", "nu.0", "sigma2.0", "pi", "u",
+  "loglik", "predictive", "probz"
+} ;
+
+struct SamplerProfile {
+  bool enabled ;
+  double seconds[PROF_STEPS] ;
+  double calls[PROF_STEPS] ;
+  explicit SamplerProfile(bool on = false) : enabled(on) {
+    for(int j = 0; j < PROF_STEPS; ++j) seconds[j] = calls[j] = 0.0 ;
+  }
+#ifndef CNPBAYES_STANDALONE
+  //
+  // Adds the counts to those of phase in the list of profiles (see
+  // McmcChains@profile) and returns the list.  Each phase is a
+  // PROF_STEPS x 2 matrix with columns calls and seconds.
+  //
+  Rcpp::List add_to(Rcpp::List profiles, const std::string& phase) const ;
+#endif
+} ;
+
+//
+// Times the enclosing scope and charges it to one update
+//
+class ProfileTimer {
+#ifndef CNPBAYES_NO_PROFILE
+  SamplerProfile* prof ;
+  int step ;
+  std::chrono::steady_clock::time_point start ;
+public:
+  ProfileTimer(SamplerProfile* p, int j) : prof(p && p->enabled ? p : NULL), step(j) {
+    if(prof) start = std::chrono::steady_clock::now() ;
+  }
+  ~ProfileTimer() {
+    if(!prof) return ;
+    std::chrono::duration<double> d = std::chrono::steady_clock::now() - start ;
+    prof->seconds[step] += d.count() ;
+    prof->calls[step] += 1.0 ;
+  }
+#else
+public:
+  ProfileTimer(SamplerProfile*, int) {}
+#endif
+} ;
+
+#endif
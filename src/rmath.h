@@ -0,0 +1,61 @@
+#ifndef _rmath_H
+#define _rmath_H
+
+//
+// Random number generation and densities for the sampling core.
+//
+// In the package the core uses R's generator and nmath through Rcpp,
+// so that set.seed() determines the results.  The core (sampler.h,
+// conditionals, starts, summaries, chib.h, fit, simulate) also builds
+// without R when CNPBAYES_STANDALONE is defined; it then links against
+// the standalone nmath library (libRmath) and is seeded by set_seed().
+// The Rcpp bindings in the same files are compiled only in the package.
+//
+#ifndef CNPBAYES_STANDALONE
+
+#include <Rcpp.h>
+
+#else
+
+#include <cmath>
+#include <limits>
+#define MATHLIB_STANDALONE
+#define R_NO_REMAP_RMATH
+#include <Rmath.h>
+
+#ifndef R_PosInf
+#define R_PosInf (std::numeric_limits<double>::infinity())
+#endif
+#ifndef R_NegInf
+#define R_NegInf (-std::numeric_limits<double>::infinity())
+#endif
+#ifndef R_NaN
+#define R_NaN (std::numeric_limits<double>::quiet_NaN())
+#endif
+#ifndef NA_REAL
+#define NA_REAL (std::numeric_limits<double>::quiet_NaN())
+#endif
+#ifndef ISNAN
+#define ISNAN(x) (std::isnan(x))
+#endif
+
+// the subset of Rcpp's R:: namespace used by the core
+namespace R {
+  inline double unif_rand() { return ::unif_rand() ; }
+  inline double norm_rand() { return ::norm_rand() ; }
+  inline double rnorm(double mu, double sigma) { return ::Rf_rnorm(mu, sigma) ; }
+  inline double rgamma(double shape, double scale) { return ::Rf_rgamma(shape, scale) ; }
+  inline double rchisq(double df) { return ::Rf_rchisq(df) ; }
+  inline double dnorm(double x, double mu, double sigma, int lg) {
+    return ::Rf_dnorm4(x, mu, sigma, lg) ;
+  }
+  inline double dgamma(double x, double shape, double scale, int lg) {
+    return ::Rf_dgamma(x, shape, scale, lg) ;
+  }
+  inline double dgeom(double x, double p, int lg) { return ::Rf_dgeom(x, p, lg) ; }
+  inline double lgammafn(double x) { return ::Rf_lgammafn(x) ; }
+}
+
+#endif
+
+#endif
@@ -0,0 +1,90 @@
+#ifndef _rng_H
+#define _rng_H
+#include "rmath.h"
+#include <stdint.h>
+#include <cmath>
+
+//
+// Independent streams of uniform random numbers for updates that run in
+// parallel.  A stream is keyed by a seed drawn from R's generator, so
+// that set.seed() determines the results, and by an integer id such as
+// the index of a family.  The draws for a given (seed, id) do not depend
+// on the number of threads or on the order in which streams are used.
+//
+// The generator is splitmix64.  The normal, gamma, and chi-square
+// draws are computed from its uniforms and differ from those of R.
+//
+class Substream {
+  uint64_t state ;
+  static uint64_t mix(uint64_t z) {
+    z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9ULL ;
+    z = (z ^ (z >> 27)) * 0x94d049bb133111ebULL ;
+    return z ^ (z >> 31) ;
+  }
+public:
+  Substream(uint64_t seed, uint64_t id) :
+    state(mix(seed ^ mix(id + 0x9e3779b97f4a7c15ULL))) {}
+  uint64_t next() {
+    state += 0x9e3779b97f4a7c15ULL ;
+    return mix(state) ;
+  }
+  // uniform on (0, 1)
+  double unif() {
+    return ((next() >> 11) + 0.5) * (1.0 / 9007199254740992.0) ;
+  }
+  // standard normal (Box-Muller)
+  double norm() {
+    double r = std::sqrt(-2.0 * std::log(unif())) ;
+    return r * std::cos(6.283185307179586 * unif()) ;
+  }
+  // gamma with unit scale (Marsaglia and Tsang)
+  double gamma(double shape) {
+    if(shape < 1.0) return gamma(shape + 1.0) * std::pow(unif(), 1.0 / shape) ;
+    const double d = shape - 1.0 / 3.0 ;
+    const double c = 1.0 / std::sqrt(9.0 * d) ;
+    for(;;){
+      double x = norm() ;
+      double v = 1.0 + c * x ;
+      if(v <= 0.0) continue ;
+      v = v * v * v ;
+      double u = unif() ;
+      if(std::log(u) < 0.5 * x * x + d - d * v + d * std::log(v)) return d * v ;
+    }
+  }
+  double chisq(double df) {
+    return 2.0 * gamma(0.5 * df) ;
+  }
+} ;
+
+//
+// R's generator with the interface of Substream, so that an update
+// templated on the generator draws the same values as the R:: functions
+// when it is called with an RGenerator.
+//
+struct RGenerator {
+  double unif() { return R::unif_rand() ; }
+  double norm() { return R::norm_rand() ; }
+  double gamma(double shape) { return R::rgamma(shape, 1.0) ; }
+  double chisq(double df) { return R::rchisq(df) ; }
+} ;
+
+// as R::rnorm and R::rgamma, for either generator
+template <class G>
+inline double draw_norm(G& g, double mean, double sd) {
+  if(!std::isfinite(mean) || sd == 0.0) return mean ;
+  return mean + sd * g.norm() ;
+}
+
+template <class G>
+inline double draw_gamma(G& g, double shape, double scale) {
+  return scale * g.gamma(shape) ;
+}
+
+// 64-bit seed from R's generator; call within an RNGScope
+inline uint64_t substream_seed() {
+  uint64_t hi = (uint64_t) (unif_rand() * 4294967296.0) ;
+  uint64_t lo = (uint64_t) (unif_rand() * 4294967296.0) ;
+  return (hi << 32) | lo ;
+}
+
+#endif
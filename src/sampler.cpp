@@ -0,0 +1,628 @@
+#include "sampler.h"
+#include "miscfunctions.h"
+#include "summaries.h"
+#include "monitor.h"
+#include <cmath>
+
+using namespace Rcpp ;
+
+MixtureHyper hyper_from_model(Rcpp::S4 model) {
+  Rcpp::S4 hypp(model.slot("hyperparams")) ;
+  MixtureHyper h ;
+  h.K = getK(hypp) ;
+  h.mu0 = hypp.slot("mu.0") ;
+  h.tau2_0 = hypp.slot("tau2.0") ;
+  h.eta0 = hypp.slot("eta.0") ;
+  h.m2_0 = hypp.slot("m2.0") ;
+  h.beta = hypp.slot("beta") ;
+  h.a = hypp.slot("a") ;
+  h.b = hypp.slot("b") ;
+  h.df = getDf(hypp) ;
+  h.nu0_max = getNu0Max(hypp) ;
+  NumericVector alpha = hypp.slot("alpha") ;
+  h.alpha.assign(alpha.begin(), alpha.end()) ;
+  return h ;
+}
+
+template <class Real>
+BasicMixtureState<Real> state_from_model(Rcpp::S4 model, bool pooled) {
+  BasicMixtureState<Real> s ;
+  NumericVector x = model.slot("data") ;
+  NumericMatrix theta = model.slot("theta") ;
+  NumericVector sigma2 = model.slot("sigma2") ;
+  IntegerVector batch = model.slot("batch") ;
+  IntegerVector z = model.slot("z") ;
+  NumericVector u = model.slot("u") ;
+  NumericVector p = model.slot("pi") ;
+  NumericVector mu = model.slot("mu") ;
+  NumericVector tau2 = model.slot("tau2") ;
+  s.N = x.size() ;
+  s.B = theta.nrow() ;
+  s.K = theta.ncol() ;
+  s.y.assign(x.begin(), x.end()) ;
+  s.u.assign(u.begin(), u.end()) ;
+  s.batch.resize(s.N) ;
+  s.z.resize(s.N) ;
+  for(int i = 0; i < s.N; ++i){
+    s.batch[i] = batch[i] - 1 ;
+    s.z[i] = z[i] - 1 ;
+  }
+  s.theta.assign(theta.begin(), theta.end()) ;
+  s.sigma2.assign(sigma2.begin(), sigma2.end()) ;
+  s.pi.assign(p.begin(), p.end()) ;
+  s.mu.assign(mu.begin(), mu.end()) ;
+  s.tau2.assign(tau2.begin(), tau2.end()) ;
+  s.nu0 = model.slot("nu.0") ;
+  s.sigma2_0 = model.slot("sigma2.0") ;
+  s.constraint = model.slot(".internal.constraint") ;
+  s.counter = model.slot(".internal.counter") ;
+  return s ;
+}
+
+template <class Real>
+void state_to_model(const BasicMixtureState<Real>& s, Rcpp::S4 model, bool pooled) {
+  IntegerVector z(s.N) ;
+  for(int i = 0; i < s.N; ++i) z[i] = s.z[i] + 1 ;
+  NumericMatrix theta(s.B, s.K) ;
+  std::copy(s.theta.begin(), s.theta.end(), theta.begin()) ;
+  model.slot("z") = z ;
+  model.slot("zfreq") = wrap(s.zfreq) ;
+  model.slot("theta") = theta ;
+  if(pooled){
+    model.slot("sigma2") = wrap(s.sigma2) ;
+  } else {
+    NumericMatrix sigma2(s.B, s.K) ;
+    std::copy(s.sigma2.begin(), s.sigma2.end(), sigma2.begin()) ;
+    model.slot("sigma2") = sigma2 ;
+  }
+  model.slot("pi") = wrap(s.pi) ;
+  model.slot("mu") = wrap(s.mu) ;
+  model.slot("tau2") = wrap(s.tau2) ;
+  model.slot("nu.0") = NumericVector::create(s.nu0) ;
+  model.slot("sigma2.0") = NumericVector::create(s.sigma2_0) ;
+  model.slot("u") = NumericVector(s.u.begin(), s.u.end()) ;
+  model.slot(".internal.counter") = s.counter ;
+}
+
+template MixtureState state_from_model<double>(Rcpp::S4, bool) ;
+template MixtureStateF state_from_model<float>(Rcpp::S4, bool) ;
+template void state_to_model<double>(const MixtureState&, Rcpp::S4, bool) ;
+template void state_to_model<float>(const MixtureStateF&, Rcpp::S4, bool) ;
+
+bool singlePrecision(Rcpp::S4 mcmcp) {
+  if(!mcmcp.hasSlot("precision")) return false ;
+  CharacterVector precision = mcmcp.slot("precision") ;
+  return precision.size() > 0 && precision[0] == "single" ;
+}
+
+bool profiling(Rcpp::S4 mcmcp) {
+  if(!mcmcp.hasSlot("profile")) return false ;
+  LogicalVector profile = mcmcp.slot("profile") ;
+  return profile.size() > 0 && profile[0] == TRUE ;
+}
+
+std::vector<double> temperatures(Rcpp::S4 mcmcp) {
+  if(!mcmcp.hasSlot("temperatures")) return std::vector<double>(1, 1.0) ;
+  NumericVector temps = mcmcp.slot("temperatures") ;
+  if(temps.size() == 0) return std::vector<double>(1, 1.0) ;
+  return std::vector<double>(temps.begin(), temps.end()) ;
+}
+
+int samplerThreads() {
+  SEXP opt = Rf_GetOption1(Rf_install("CNPBayes.nthreads")) ;
+  if(Rf_isNull(opt) || Rf_length(opt) < 1) return 1 ;
+  int n = Rf_asInteger(opt) ;
+  return n == NA_INTEGER || n < 1 ? 1 : n ;
+}
+
+//
+// The hot replicas of a ReplicaExchange are kept in the 'replicas' slot
+// of the chains between the burnin and the saved iterations (and between
+// calls of the samplers), as a list with the temperature and the
+// parameters of each replica.  A list that does not match the
+// temperatures or the dimensions of the model is ignored.
+//
+template <class Real>
+static std::vector<BasicMixtureState<Real> >
+replicas_from_chain(Rcpp::S4 chain, const BasicMixtureState<Real>& cold,
+                    const std::vector<double>& temps) {
+  std::vector<BasicMixtureState<Real> > states ;
+  if(temps.size() < 2 || !chain.hasSlot("replicas")) return states ;
+  List reps = chain.slot("replicas") ;
+  if(reps.size() != (int) temps.size() - 1) return states ;
+  for(int j = 0; j < reps.size(); ++j){
+    List x = reps[j] ;
+    double temp = x["temp"] ;
+    IntegerVector z = x["z"] ;
+    NumericVector u = x["u"] ;
+    NumericVector theta = x["theta"] ;
+    NumericVector sigma2 = x["sigma2"] ;
+    NumericVector p = x["pi"] ;
+    NumericVector mu = x["mu"] ;
+    NumericVector tau2 = x["tau2"] ;
+    if(temp != temps[j + 1] || z.size() != cold.N || u.size() != cold.N ||
+       theta.size() != (int) cold.theta.size() ||
+       sigma2.size() != (int) cold.sigma2.size() || p.size() != cold.K){
+      states.clear() ;
+      return states ;
+    }
+    BasicMixtureState<Real> s ;
+    s.z.resize(cold.N) ;
+    for(int i = 0; i < cold.N; ++i) s.z[i] = z[i] - 1 ;
+    s.u.assign(u.begin(), u.end()) ;
+    s.theta.assign(theta.begin(), theta.end()) ;
+    s.sigma2.assign(sigma2.begin(), sigma2.end()) ;
+    s.pi.assign(p.begin(), p.end()) ;
+    s.mu.assign(mu.begin(), mu.end()) ;
+    s.tau2.assign(tau2.begin(), tau2.end()) ;
+    s.nu0 = x["nu.0"] ;
+    s.sigma2_0 = x["sigma2.0"] ;
+    states.push_back(s) ;
+  }
+  return states ;
+}
+
+template <class Real>
+static Rcpp::List replicas_to_list(const std::vector<BasicMixtureState<Real> >& states) {
+  List reps(states.size()) ;
+  for(size_t j = 0; j < states.size(); ++j){
+    const BasicMixtureState<Real>& s = states[j] ;
+    IntegerVector z(s.N) ;
+    for(int i = 0; i < s.N; ++i) z[i] = s.z[i] + 1 ;
+    reps[j] = List::create(Named("temp") = s.temp,
+                           Named("z") = z,
+                           Named("u") = NumericVector(s.u.begin(), s.u.end()),
+                           Named("theta") = wrap(s.theta),
+                           Named("sigma2") = wrap(s.sigma2),
+                           Named("pi") = wrap(s.pi),
+                           Named("mu") = wrap(s.mu),
+                           Named("tau2") = wrap(s.tau2),
+                           Named("nu.0") = s.nu0,
+                           Named("sigma2.0") = s.sigma2_0) ;
+  }
+  return reps ;
+}
+
+int maxThin(Rcpp::S4 mcmcp) {
+  if(!mcmcp.hasSlot("adaptive_thin")) return 0 ;
+  LogicalVector adaptive = mcmcp.slot("adaptive_thin") ;
+  if(adaptive.size() == 0 || adaptive[0] != TRUE) return 0 ;
+  IntegerVector max_thin = mcmcp.slot("max_thin") ;
+  return max_thin.size() > 0 ? std::max(1, (int) max_thin[0]) : 1 ;
+}
+
+//
+// Checkpoint, progress, and interrupt after done iterations (see
+// monitor.h); true if the sampler should stop.
+//
+template <class V, class Real>
+static bool monitor_step(SamplerMonitor* mon, const BasicMixtureState<Real>& s,
+                         Rcpp::S4 model, int done) {
+  if(mon->checkpoint_due(done)){
+    state_to_model(s, model, V::pooled) ;
+    mon->checkpoint(model, done) ;
+  }
+  return mon->poll(done) ;
+}
+
+//
+// Sweeps start, ..., S - 1 of burnin; start > 0 when resuming from a
+// checkpoint.  The draws of theta and pi are added to acw unless it is
+// NULL.  The hot replicas of a ReplicaExchange continue from (and are
+// returned in) replicas.
+//
+template <class V, class L, class Real>
+static void burnin_kernel(BasicMixtureState<Real>& s, const MixtureHyper& h, int S,
+                          int start, const std::vector<double>& temps,
+                          std::vector<BasicMixtureState<Real> >& replicas,
+                          double& ll, double& lp, Rcpp::S4 model,
+                          AutocorrWindow* acw,
+                          SamplerProfile* prof, SamplerMonitor* mon) {
+  typedef MixtureSampler<V, L, Real> Sampler ;
+  if(L::normal) Sampler::update_u(s, h) ;
+  Sampler::tabulate(s) ;
+  ReplicaExchange<V, L, Real> rx(s, temps, samplerThreads()) ;
+  rx.restore(replicas) ;
+  std::vector<double> draw ;
+  for(int i = start; i < S; ++i){
+    rx.sweep(s, h, NULL, prof) ;
+    if(acw != NULL){
+      draw.assign(s.theta.begin(), s.theta.end()) ;
+      draw.insert(draw.end(), s.pi.begin(), s.pi.end()) ;
+      acw->add(draw.data()) ;
+    }
+    if(rx.size() > 1 && mon->checkpoint_due(i + 1)){
+      // the chains are shared with object
+      Rcpp::S4 chain(Rf_shallow_duplicate(model.slot("mcmc.chains"))) ;
+      if(chain.hasSlot("replicas")){
+        chain.slot("replicas") = replicas_to_list(rx.replicas()) ;
+        model.slot("mcmc.chains") = chain ;
+      }
+    }
+    if(monitor_step<V>(mon, s, model, i + 1)) break ;
+  }
+  replicas = rx.replicas() ;
+  ProfileTimer t(prof, PROF_LOGLIK) ;
+  ll = Sampler::loglik(s, h) ;
+  lp = Sampler::logprior(s, h) ;
+}
+
+//
+// Posterior summaries and modes of the saved iterations (summaries.h).
+// list() is the 'summary' slot of the chains; at a checkpoint it also
+// has the state of the accumulators ('accumulators'), which restore()
+// reads when the sampler is resumed.
+//
+template <class Real>
+struct ChainSummaries {
+  BlockSummary theta, sigma2, pi, mu, tau2, nu0, sigma2_0, loglik, logprior ;
+  MixtureMode<Real> mode ;
+  ChainSummaries(int BK, int nv, int K) :
+    theta(BK), sigma2(nv), pi(K), mu(K), tau2(K), nu0(1), sigma2_0(1),
+    loglik(1), logprior(1) {}
+
+  void add(const BasicMixtureState<Real>& s, double ll, double lp) {
+    theta.add(s.theta.data()) ;
+    sigma2.add(s.sigma2.data()) ;
+    pi.add(s.pi.data()) ;
+    mu.add(s.mu.data()) ;
+    tau2.add(s.tau2.data()) ;
+    nu0.add(&s.nu0) ;
+    sigma2_0.add(&s.sigma2_0) ;
+    loglik.add(&ll) ;
+    logprior.add(&lp) ;
+    mode.update(s, ll, lp) ;
+  }
+
+  // matrix is false when sigma2 has one element per batch
+  List modes(bool matrix) const {
+    const BasicMixtureState<Real>& m = mode.state ;
+    NumericMatrix theta_mode(m.B, m.K) ;
+    std::copy(m.theta.begin(), m.theta.end(), theta_mode.begin()) ;
+    SEXP sigma2_mode ;
+    if(!matrix) sigma2_mode = wrap(m.sigma2) ;
+    else {
+      NumericMatrix sm(m.B, m.K) ;
+      std::copy(m.sigma2.begin(), m.sigma2.end(), sm.begin()) ;
+      sigma2_mode = sm ;
+    }
+    return List::create(Named("theta") = theta_mode,
+                        Named("sigma2") = sigma2_mode,
+                        Named("mixprob") = wrap(m.pi),
+                        Named("mu") = wrap(m.mu),
+                        Named("tau2") = wrap(m.tau2),
+                        Named("nu0") = m.nu0,
+                        Named("sigma2.0") = m.sigma2_0,
+                        Named("zfreq") = wrap(m.zfreq),
+                        Named("loglik") = mode.loglik,
+                        Named("logprior") = mode.logprior) ;
+  }
+
+  List list(int iter, bool matrix) const {
+    return List::create(Named("theta") = theta.wrap(),
+                        Named("sigma2") = sigma2.wrap(),
+                        Named("pi") = pi.wrap(),
+                        Named("mu") = mu.wrap(),
+                        Named("tau2") = tau2.wrap(),
+                        Named("nu.0") = nu0.wrap(),
+                        Named("sigma2.0") = sigma2_0.wrap(),
+                        Named("loglik") = loglik.wrap(),
+                        Named("logprior") = logprior.wrap(),
+                        Named("iter") = iter,
+                        Named("modes") = modes(matrix)) ;
+  }
+
+  List accumulators(const std::vector<double>& exchange) const {
+    return List::create(Named("theta") = wrap(theta.save()),
+                        Named("sigma2") = wrap(sigma2.save()),
+                        Named("pi") = wrap(pi.save()),
+                        Named("mu") = wrap(mu.save()),
+                        Named("tau2") = wrap(tau2.save()),
+                        Named("nu.0") = wrap(nu0.save()),
+                        Named("sigma2.0") = wrap(sigma2_0.save()),
+                        Named("loglik") = wrap(loglik.save()),
+                        Named("logprior") = wrap(logprior.save()),
+                        Named("mode") = NumericVector::create(mode.found, mode.empty),
+                        Named("exchange") = wrap(exchange)) ;
+  }
+
+  //
+  // The accumulators and modes saved at a checkpoint, and the exchange
+  // state of the replicas.  Returns false (and leaves the summaries
+  // empty) if summary has no accumulators of the right size.
+  //
+  bool restore(List summary, const BasicMixtureState<Real>& s,
+               std::vector<double>& exchange) {
+    if(!summary.containsElementNamed("accumulators")) return false ;
+    List acc = summary["accumulators"] ;
+    BlockSummary* blocks[] = {&theta, &sigma2, &pi, &mu, &tau2, &nu0,
+                              &sigma2_0, &loglik, &logprior} ;
+    const char* names[] = {"theta", "sigma2", "pi", "mu", "tau2", "nu.0",
+                           "sigma2.0", "loglik", "logprior"} ;
+    std::vector<BlockSummary> saved ;
+    for(int j = 0; j < 9; ++j) saved.push_back(*blocks[j]) ;
+    for(int j = 0; j < 9; ++j){
+      if(!blocks[j]->load(as<std::vector<double> >(acc[names[j]]))){
+        for(int i = 0; i < 9; ++i) *blocks[i] = saved[i] ;
+        return false ;
+      }
+    }
+    NumericVector flags = acc["mode"] ;
+    List m = summary["modes"] ;
+    mode.found = flags[0] != 0 ;
+    mode.empty = flags[1] != 0 ;
+    mode.state.N = s.N ;
+    mode.state.B = s.B ;
+    mode.state.K = s.K ;
+    mode.state.theta = as<std::vector<double> >(m["theta"]) ;
+    mode.state.sigma2 = as<std::vector<double> >(m["sigma2"]) ;
+    mode.state.pi = as<std::vector<double> >(m["mixprob"]) ;
+    mode.state.mu = as<std::vector<double> >(m["mu"]) ;
+    mode.state.tau2 = as<std::vector<double> >(m["tau2"]) ;
+    mode.state.nu0 = as<double>(m["nu0"]) ;
+    mode.state.sigma2_0 = as<double>(m["sigma2.0"]) ;
+    mode.state.zfreq = as<std::vector<int> >(m["zfreq"]) ;
+    mode.loglik = as<double>(m["loglik"]) ;
+    mode.logprior = as<double>(m["logprior"]) ;
+    exchange = as<std::vector<double> >(acc["exchange"]) ;
+    return true ;
+  }
+} ;
+
+//
+// Chains are filled in place.  The row for iteration s holds the values
+// after the s-th saved sweep; T additional sweeps are run between saved
+// iterations for thinning.  Chains with fewer than S rows
+// (McmcParams(store_chains=FALSE)) are not written.  When resuming from
+// a checkpoint, the first start rows, the counts of probz, and the
+// summaries (ChainSummaries) are those of the checkpoint.
+//
+// Posterior summaries of the saved iterations are accumulated as the
+// chain runs (see summaries.h) and stored in the 'summary' slot of the
+// chains together with the modes -- the parameters at the first
+// iteration with the largest finite log likelihood, as in argMax.  The
+// time spent in each update is added to the 'mcmc' profile of the chains
+// when prof is enabled.  With more than one temperature, every sweep is
+// a scan of the replicas (ReplicaExchange) and the acceptance rates of
+// the exchanges are added to the summary.  The hot replicas continue
+// from (and are returned in) replicas.
+//
+template <class V, class L, class Real>
+static void mcmc_kernel(BasicMixtureState<Real>& s, const MixtureHyper& h, int S, int T,
+                        int start, const std::vector<double>& temps,
+                        std::vector<BasicMixtureState<Real> >& replicas,
+                        Rcpp::S4 model, Rcpp::S4 chain,
+                        SamplerProfile* prof, SamplerMonitor* mon) {
+  typedef MixtureSampler<V, L, Real> Sampler ;
+  NumericMatrix thetac = chain.slot("theta") ;
+  NumericMatrix sigma2c = chain.slot("sigma2") ;
+  NumericMatrix pmix = chain.slot("pi") ;
+  NumericMatrix zfreq = chain.slot("zfreq") ;
+  NumericMatrix mu = chain.slot("mu") ;
+  NumericMatrix tau2 = chain.slot("tau2") ;
+  NumericVector nu0 = chain.slot("nu.0") ;
+  NumericVector sigma2_0 = chain.slot("sigma2.0") ;
+  NumericVector loglik_ = chain.slot("loglik") ;
+  NumericVector logprior_ = chain.slot("logprior") ;
+  NumericMatrix predictive_ = chain.slot("predictive") ;
+  IntegerMatrix zstar_ = chain.slot("zstar") ;
+  IntegerMatrix probz = model.slot("probz") ;
+  const int BK = s.B * s.K ;
+  const int nv = s.sigma2.size() ;
+  const bool store = thetac.nrow() >= S ;
+  const bool matrix = !(V::pooled || V::single) ;
+  const bool summarize = chain.hasSlot("summary") ;
+  ChainSummaries<Real> sums(BK, nv, s.K) ;
+  double ll = 0.0 ;
+  double lp = 0.0 ;
+  int done = S ;
+  if(L::normal) Sampler::update_u(s, h) ;
+  Sampler::tabulate(s) ;
+  ReplicaExchange<V, L, Real> rx(s, temps, samplerThreads()) ;
+  rx.restore(replicas) ;
+  // the summaries of the iterations before a checkpoint
+  int first = 0 ;
+  if(start > 0 && summarize){
+    std::vector<double> exchange ;
+    if(sums.restore(chain.slot("summary"), s, exchange)){
+      rx.restore_exchange(exchange) ;
+    } else first = start ;
+  }
+  for(int iter = start; iter < S; ++iter){
+    rx.sweep(s, h, probz.begin(), prof) ;
+    {
+      ProfileTimer t(prof, PROF_LOGLIK) ;
+      ll = Sampler::loglik(s, h) ;
+      lp = Sampler::logprior(s, h) ;
+    }
+    {
+      ProfileTimer t(prof, PROF_PREDICTIVE) ;
+      Sampler::update_predictive(s, h) ;
+    }
+    sums.add(s, ll, lp) ;
+    if(store){
+      for(int k = 0; k < s.K; ++k){
+        zfreq(iter, k) = s.zfreq[k] ;
+        pmix(iter, k) = s.pi[k] ;
+        mu(iter, k) = s.mu[k] ;
+        tau2(iter, k) = s.tau2[k] ;
+      }
+      for(int j = 0; j < BK; ++j){
+        thetac(iter, j) = s.theta[j] ;
+        predictive_(iter, j) = s.ystar[j] ;
+        zstar_(iter, j) = s.zstar[j] ;
+      }
+      for(int j = 0; j < nv; ++j) sigma2c(iter, j) = s.sigma2[j] ;
+      nu0[iter] = s.nu0 ;
+      sigma2_0[iter] = s.sigma2_0 ;
+      loglik_[iter] = ll ;
+      logprior_[iter] = lp ;
+    }
+    //
+    // There is no thinning if thin parameter is less than 1
+    // (T = thin parameter -1)
+    //
+    for(int t = 0; t < T; ++t) rx.sweep(s, h, NULL, prof) ;
+    if(mon->checkpoint_due(iter + 1)){
+      model.slot("loglik") = NumericVector::create(ll) ;
+      model.slot("logprior") = NumericVector::create(lp) ;
+      if(summarize){
+        List summary = sums.list(iter + 1 - first, matrix) ;
+        summary.push_back(sums.accumulators(rx.exchange_state()), "accumulators") ;
+        chain.slot("summary") = summary ;
+      }
+      if(rx.size() > 1 && chain.hasSlot("replicas")){
+        chain.slot("replicas") = replicas_to_list(rx.replicas()) ;
+      }
+    }
+    if(monitor_step<V>(mon, s, model, iter + 1)){
+      done = iter + 1 ;
+      break ;
+    }
+  }
+  replicas = rx.replicas() ;
+  model.slot("loglik") = NumericVector::create(ll) ;
+  model.slot("logprior") = NumericVector::create(lp) ;
+  model.slot("probz") = probz ;
+  model.slot("predictive") = wrap(s.ystar) ;
+  model.slot("zstar") = wrap(s.zstar) ;
+  if(summarize){
+    List summary = sums.list(done - first, matrix) ;
+    if(rx.size() > 1) summary.push_back(wrap(rx.swap_rates()), "swap_rate") ;
+    chain.slot("summary") = summary ;
+  }
+  if(prof->enabled && chain.hasSlot("profile")){
+    chain.slot("profile") = prof->add_to(chain.slot("profile"), "mcmc") ;
+  }
+  model.slot("mcmc.chains") = chain ;
+}
+
+//
+// Variance structure: pooled (one variance per batch), single batch,
+// or one variance per batch and component.  Likelihood: normal limit
+// when dfr >= NORMAL_LIMIT_DF, otherwise Student-t.  run_burnin
+// returns the adapted thin, or 0 if max_thin is 0 or there were too few
+// draws.
+//
+template <class Real>
+static int run_burnin(Rcpp::S4 model, int S, int start, bool pooled,
+                      const std::vector<double>& temps, int max_thin,
+                      SamplerProfile* prof, SamplerMonitor* mon) {
+  MixtureHyper h = hyper_from_model(model) ;
+  BasicMixtureState<Real> s = state_from_model<Real>(model, pooled) ;
+  bool normal = h.df >= NORMAL_LIMIT_DF ;
+  double ll ;
+  double lp ;
+  AutocorrWindow window(s.B * s.K + s.K, THIN_WINDOW) ;
+  AutocorrWindow* acw = max_thin > 0 ? &window : NULL ;
+  Rcpp::S4 chain(model.slot("mcmc.chains")) ;
+  std::vector<BasicMixtureState<Real> > reps = replicas_from_chain(chain, s, temps) ;
+  if(pooled){
+    if(normal) burnin_kernel<PooledVariance, NormalLimit>(s, h, S, start, temps, reps, ll, lp, model, acw, prof, mon) ;
+    else burnin_kernel<PooledVariance, StudentT>(s, h, S, start, temps, reps, ll, lp, model, acw, prof, mon) ;
+  } else if(s.B == 1){
+    if(normal) burnin_kernel<SingleBatchVariance, NormalLimit>(s, h, S, start, temps, reps, ll, lp, model, acw, prof, mon) ;
+    else burnin_kernel<SingleBatchVariance, StudentT>(s, h, S, start, temps, reps, ll, lp, model, acw, prof, mon) ;
+  } else {
+    if(normal) burnin_kernel<ComponentVariance, NormalLimit>(s, h, S, start, temps, reps, ll, lp, model, acw, prof, mon) ;
+    else burnin_kernel<ComponentVariance, StudentT>(s, h, S, start, temps, reps, ll, lp, model, acw, prof, mon) ;
+  }
+  state_to_model(s, model, pooled) ;
+  if(!reps.empty() && chain.hasSlot("replicas")){
+    // the chains are shared with object
+    Rcpp::S4 ch(Rf_shallow_duplicate(chain)) ;
+    ch.slot("replicas") = replicas_to_list(reps) ;
+    model.slot("mcmc.chains") = ch ;
+  }
+  // log likelihood and log prior from the last iteration of burnin
+  model.slot("loglik") = NumericVector::create(ll) ;
+  model.slot("logprior") = NumericVector::create(lp) ;
+  if(acw == NULL || acw->size() < THIN_MIN_DRAWS) return 0 ;
+  return (int) std::min((double) max_thin, std::ceil(acw->max_iat())) ;
+}
+
+template <class Real>
+static void run_mcmc(Rcpp::S4 model, int S, int T, int start, bool pooled,
+                     const std::vector<double>& temps,
+                     SamplerProfile* prof, SamplerMonitor* mon) {
+  Rcpp::S4 chain(model.slot("mcmc.chains")) ;
+  MixtureHyper h = hyper_from_model(model) ;
+  BasicMixtureState<Real> s = state_from_model<Real>(model, pooled) ;
+  bool normal = h.df >= NORMAL_LIMIT_DF ;
+  std::vector<BasicMixtureState<Real> > reps = replicas_from_chain(chain, s, temps) ;
+  if(pooled){
+    if(normal) mcmc_kernel<PooledVariance, NormalLimit>(s, h, S, T, start, temps, reps, model, chain, prof, mon) ;
+    else mcmc_kernel<PooledVariance, StudentT>(s, h, S, T, start, temps, reps, model, chain, prof, mon) ;
+  } else if(s.B == 1){
+    if(normal) mcmc_kernel<SingleBatchVariance, NormalLimit>(s, h, S, T, start, temps, reps, model, chain, prof, mon) ;
+    else mcmc_kernel<SingleBatchVariance, StudentT>(s, h, S, T, start, temps, reps, model, chain, prof, mon) ;
+  } else {
+    if(normal) mcmc_kernel<ComponentVariance, NormalLimit>(s, h, S, T, start, temps, reps, model, chain, prof, mon) ;
+    else mcmc_kernel<ComponentVariance, StudentT>(s, h, S, T, start, temps, reps, model, chain, prof, mon) ;
+  }
+  state_to_model(s, model, pooled) ;
+  if(!reps.empty() && chain.hasSlot("replicas")){
+    chain.slot("replicas") = replicas_to_list(reps) ;
+    model.slot("mcmc.chains") = chain ;
+  }
+}
+
+//
+// The returned model is a shallow copy of object: the data, batch, and
+// other slots the sampler only reads are shared with object, and the
+// slots that state_to_model updates are replaced rather than modified.
+// probz and the chains are written in place during MCMC and are the
+// only slots duplicated.
+//
+static Rcpp::S4 sampler_copy(Rcpp::S4 object, bool mcmc) {
+  Rcpp::S4 model(Rf_shallow_duplicate(object)) ;
+  if(mcmc){
+    IntegerMatrix probz = object.slot("probz") ;
+    Rcpp::S4 chain(object.slot("mcmc.chains")) ;
+    model.slot("probz") = clone(probz) ;
+    model.slot("mcmc.chains") = clone(chain) ;
+  }
+  return model ;
+}
+
+Rcpp::S4 burnin_sampler(Rcpp::S4 object, Rcpp::S4 mcmcp, bool pooled, int start) {
+  RNGScope scope ;
+  Rcpp::S4 model(sampler_copy(object, false)) ;
+  int S = mcmcp.slot("burnin") ;
+  if(S < 1 || start >= S) return model ;
+  SamplerProfile prof(profiling(mcmcp)) ;
+  SamplerMonitor mon(mcmcp, "burnin", S) ;
+  std::vector<double> temps = temperatures(mcmcp) ;
+  int thin ;
+  if(singlePrecision(mcmcp)) thin = run_burnin<float>(model, S, start, pooled, temps, maxThin(mcmcp), &prof, &mon) ;
+  else thin = run_burnin<double>(model, S, start, pooled, temps, maxThin(mcmcp), &prof, &mon) ;
+  if(thin > 0){
+    // the parameters are shared with object
+    Rcpp::S4 mp(Rf_shallow_duplicate(model.slot("mcmc.params"))) ;
+    mp.slot("thin") = IntegerVector::create(thin) ;
+    model.slot("mcmc.params") = mp ;
+  }
+  if(prof.enabled){
+    // the chains are shared with object
+    Rcpp::S4 chain(Rf_shallow_duplicate(model.slot("mcmc.chains"))) ;
+    if(chain.hasSlot("profile")){
+      chain.slot("profile") = prof.add_to(chain.slot("profile"), "burnin") ;
+      model.slot("mcmc.chains") = chain ;
+    }
+  }
+  return model ;
+}
+
+Rcpp::S4 mcmc_sampler(Rcpp::S4 object, Rcpp::S4 mcmcp, bool pooled, int start) {
+  RNGScope scope ;
+  Rcpp::S4 model(sampler_copy(object, true)) ;
+  int S = mcmcp.slot("iter") ;
+  int T = mcmcp.slot("thin") ;
+  if(S < 1 || start >= S) return model ;
+  SamplerProfile prof(profiling(mcmcp)) ;
+  SamplerMonitor mon(mcmcp, "mcmc", S) ;
+  std::vector<double> temps = temperatures(mcmcp) ;
+  if(singlePrecision(mcmcp)) run_mcmc<float>(model, S, T - 1, start, pooled, temps, &prof, &mon) ;
+  else run_mcmc<double>(model, S, T - 1, start, pooled, temps, &prof, &mon) ;
+  return model ;
+}
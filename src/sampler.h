@@ -0,0 +1,958 @@
+#ifndef _sampler_H
+#define _sampler_H
+
+#include "rmath.h"
+#include "profile.h"
+#include <vector>
+#include <cmath>
+#include <stdexcept>
+#include <limits>
+#include <utility>
+#include <string>
+#include <algorithm>
+#include "conditionals.h"
+#include "rng.h"
+
+//
+// Gibbs sampler for the batch t-mixture, templated on
+//
+//   1. a variance-structure policy:
+//        ComponentVariance   -- sigma2 is B x K (MultiBatchModel)
+//        PooledVariance      -- sigma2 has length B (MultiBatchPooled)
+//        SingleBatchVariance -- B = 1 and sigma2 has length K (SB models)
+//
+//   2. a likelihood policy:
+//        StudentT            -- scale mixture of normals with df = dfr
+//        NormalLimit         -- normal limit used when dfr is large
+//
+// The policies are resolved at compile time so that each combination
+// gets its own kernels without per-observation branches.  The Rcpp
+// entry points (cpp_burnin, cpp_mcmc, burnin_multibatch_pvar,
+// mcmc_multibatch_pvar) pick the instantiation from the model.
+//
+
+struct ComponentVariance {
+  static const bool pooled = false ;
+  static const bool single = false ;
+} ;
+
+struct PooledVariance {
+  static const bool pooled = true ;
+  static const bool single = false ;
+} ;
+
+struct SingleBatchVariance {
+  static const bool pooled = false ;
+  static const bool single = true ;
+} ;
+
+// dfr at or above which the normal limit of the t-distribution is used
+const double NORMAL_LIMIT_DF = 1000.0 ;
+
+struct StudentT {
+  static const bool normal = false ;
+  // part of the log density that depends only on df
+  static double log_const(double df) {
+    return R::lgammafn(0.5 * (df + 1.0)) - R::lgammafn(0.5 * df) -
+      0.5 * log(df * M_PI) ;
+  }
+  // evaluated in the precision of the data (see BasicMixtureState)
+  template <class Real>
+  static Real log_kernel(Real r, Real df) {
+    return Real(-0.5) * (df + Real(1)) * std::log1p(r * r / df) ;
+  }
+  static double draw_u(double df) { return R::rchisq(df) ; }
+} ;
+
+struct NormalLimit {
+  static const bool normal = true ;
+  static double log_const(double /*df*/) { return -0.5 * log(2.0 * M_PI) ; }
+  template <class Real>
+  static Real log_kernel(Real r, Real /*df*/) { return Real(-0.5) * r * r ; }
+  // u/df is one in the limit
+  static double draw_u(double df) { return df ; }
+} ;
+
+struct MixtureHyper {
+  int K ;
+  double mu0 ;
+  double tau2_0 ;
+  double eta0 ;
+  double m2_0 ;
+  double beta ;
+  double a ;
+  double b ;
+  double df ;
+  int nu0_max ;
+  std::vector<double> alpha ;
+} ;
+
+//
+// Current values of the parameters.  Component labels are zero-based
+// and batches are zero-based row indices of theta.  theta (and sigma2
+// for ComponentVariance) are stored column-major, as in R.
+//
+// The data and the chi-square scale variables are stored as Real.  With
+// Real = float (McmcParams(precision="single")) the densities in the z
+// update and the log likelihood are evaluated in single precision;
+// sufficient statistics, accumulators and parameters remain double.
+//
+template <class Real>
+struct BasicMixtureState {
+  int N ;
+  int B ;
+  int K ;
+  std::vector<Real> y ;
+  std::vector<int> batch ;
+  std::vector<Real> u ;
+  std::vector<int> z ;
+  std::vector<double> theta ;
+  std::vector<double> sigma2 ;
+  std::vector<double> pi ;
+  std::vector<double> mu ;
+  std::vector<double> tau2 ;
+  double nu0 ;
+  double sigma2_0 ;
+  double constraint ;
+  int counter ;
+  // inverse temperature of the likelihood (1 except for the hot
+  // replicas of a ReplicaExchange)
+  double temp = 1.0 ;
+  // sufficient statistics for the current z and u
+  std::vector<int> zfreq ;     // K
+  std::vector<double> n ;      // B x K
+  std::vector<double> sum_u ;  // B x K
+  std::vector<double> sum_uy ; // B x K
+  // posterior predictive draws (B x K)
+  std::vector<double> ystar ;
+  std::vector<int> zstar ;
+} ;
+
+typedef BasicMixtureState<double> MixtureState ;
+typedef BasicMixtureState<float> MixtureStateF ;
+
+//
+// Small-K specialisations.  K is almost always between 1 and 6, so the
+// per-observation kernels are instantiated for K = 1, ..., MAX_UNROLLED_K
+// with the number of components as a template parameter; KK = 0 is the
+// generic fallback with K known only at runtime.
+//
+const int MAX_UNROLLED_K = 6 ;
+
+//
+// The densities of z and of the log likelihood are computed for blocks
+// of LANE_BLOCK observations, one contiguous lane per component, so
+// that the residuals vectorize (#pragma omp simd) in float as well as
+// in double.  The draws stay in the order of the observations.
+//
+const int LANE_BLOCK = 256 ;
+
+//
+// Scratch space for the K components: a fixed array for KK > 0 and a
+// vector of K elements for the generic KK = 0.  KK is a compile-time
+// constant, so the branch in operator[] is folded away.
+//
+template <int KK, class T = double>
+struct KBuffer {
+  T fixed[KK > 0 ? KK : 1] ;
+  std::vector<T> heap ;
+  explicit KBuffer(int K) : heap(KK > 0 ? 0 : K) {}
+  T& operator[](int k) { return KK > 0 ? fixed[k] : heap[k] ; }
+} ;
+
+template <int KK>
+inline int k_size(int K) { return KK > 0 ? KK : K ; }
+
+//
+// Expands CALL(KK) with KK = K for K <= MAX_UNROLLED_K and KK = 0
+// otherwise.
+//
+#define DISPATCH_K(K, CALL)                         \
+  switch(K){                                        \
+  case 1: CALL(1) ; break ;                         \
+  case 2: CALL(2) ; break ;                         \
+  case 3: CALL(3) ; break ;                         \
+  case 4: CALL(4) ; break ;                         \
+  case 5: CALL(5) ; break ;                         \
+  case 6: CALL(6) ; break ;                         \
+  default: CALL(0) ;                                \
+  }
+
+template <class V, class State>
+inline int batch_index(const State& s, int i) {
+  return V::single ? 0 : s.batch[i] ;
+}
+
+template <class V>
+inline int variance_index(int b, int k, int B) {
+  return V::pooled ? b : b + B * k ;
+}
+
+template <class V>
+inline int variance_size(int B, int K) {
+  return V::pooled ? B : B * K ;
+}
+
+//
+// Standardised residuals r[j] = (y[j] - theta(b_j, k)) / sigma(b_j, k) of
+// the n observations of a block for component k
+//
+template <class V, class Real>
+inline void residual_lane(const Real* y, const int* b, int n, int k, int B,
+                          const Real* theta, const Real* sigma, Real* r) {
+#ifdef _OPENMP
+#pragma omp simd
+#endif
+  for(int j = 0; j < n; ++j)
+    r[j] = (y[j] - theta[b[j] + B * k]) / sigma[variance_index<V>(b[j], k, B)] ;
+}
+
+template <class V, class L, class Real = double>
+class MixtureSampler {
+public:
+  typedef BasicMixtureState<Real> State ;
+
+  static void tabulate(State& s) {
+    const int B = s.B ;
+    const int K = s.K ;
+    s.zfreq.assign(K, 0) ;
+    s.n.assign(B * K, 0.0) ;
+    s.sum_u.assign(B * K, 0.0) ;
+    s.sum_uy.assign(B * K, 0.0) ;
+    for(int i = 0; i < s.N; ++i){
+      int j = batch_index<V>(s, i) + B * s.z[i] ;
+      s.zfreq[s.z[i]] += 1 ;
+      s.n[j] += 1.0 ;
+      s.sum_u[j] += s.u[i] ;
+      s.sum_uy[j] += double(s.u[i]) * s.y[i] ;
+    }
+  }
+
+  //
+  // z is not updated if the proposal leaves a batch-component cell with
+  // fewer than two observations.  The t-density is raised to the power
+  // s.temp (1 except for the hot replicas of a ReplicaExchange).
+  //
+  static void update_z(State& s, const MixtureHyper& h) {
+    RGenerator g ;
+    update_z(s, h, g) ;
+  }
+
+  template <class G>
+  static void update_z(State& s, const MixtureHyper& h, G& g) {
+#define UPDATE_Z(KK) update_z_k<KK>(s, h, g)
+    DISPATCH_K(s.K, UPDATE_Z)
+#undef UPDATE_Z
+  }
+
+  template <int KK, class G>
+  static void update_z_k(State& s, const MixtureHyper& h, G& g) {
+    const int B = s.B ;
+    const int K = k_size<KK>(s.K) ;
+    const int nv = variance_size<V>(B, K) ;
+    const Real df = h.df ;
+    std::vector<Real> theta(s.theta.begin(), s.theta.end()) ;
+    const Real temp = s.temp ;
+    std::vector<Real> sigma(nv) ;
+    std::vector<Real> lsigma(nv) ;
+    for(int v = 0; v < nv; ++v){
+      sigma[v] = sqrt(s.sigma2[v]) ;
+      lsigma[v] = temp * log(sqrt(s.sigma2[v])) ;
+    }
+    KBuffer<KK, Real> lpi(K) ;
+    for(int k = 0; k < K; ++k) lpi[k] = log(s.pi[k]) ;
+    std::vector<int> znew(s.N) ;
+    std::vector<int> freq(B * K, 0) ;
+    KBuffer<KK, Real> lp(K) ;
+    std::vector<int> bl(LANE_BLOCK) ;
+    std::vector<Real> lanes(K * LANE_BLOCK) ;
+    for(int i0 = 0; i0 < s.N; i0 += LANE_BLOCK){
+      const int n = std::min(LANE_BLOCK, s.N - i0) ;
+      for(int j = 0; j < n; ++j) bl[j] = batch_index<V>(s, i0 + j) ;
+      for(int k = 0; k < K; ++k){
+        Real* x = &lanes[k * LANE_BLOCK] ;
+        residual_lane<V>(&s.y[i0], &bl[0], n, k, B, &theta[0], &sigma[0], x) ;
+        const Real lpk = lpi[k] ;
+#ifdef _OPENMP
+#pragma omp simd
+#endif
+        for(int j = 0; j < n; ++j)
+          x[j] = lpk - lsigma[variance_index<V>(bl[j], k, B)] +
+            temp * L::log_kernel(x[j], df) ;
+      }
+      for(int j = 0; j < n; ++j){
+        const int i = i0 + j ;
+        const int b = bl[j] ;
+        Real maxlp = -std::numeric_limits<Real>::infinity() ;
+        for(int k = 0; k < K; ++k){
+          lp[k] = lanes[k * LANE_BLOCK + j] ;
+          if(lp[k] > maxlp) maxlp = lp[k] ;
+        }
+        double total = 0.0 ;
+        for(int k = 0; k < K; ++k){
+          lp[k] = std::exp(lp[k] - maxlp) ;
+          total += lp[k] ;
+        }
+        double u = g.unif() * total ;
+        double acc = 0.0 ;
+        int zi = K - 1 ;
+        for(int k = 0; k < K; ++k){
+          acc += lp[k] ;
+          if(u < acc){
+            zi = k ;
+            break ;
+          }
+        }
+        znew[i] = zi ;
+        freq[b + B * zi] += 1 ;
+      }
+    }
+    for(int j = 0; j < B * K; ++j){
+      if(freq[j] <= 1){
+        s.counter++ ;
+        return ;
+      }
+    }
+    s.z.swap(znew) ;
+  }
+
+  //
+  // The updates of the parameters draw from g, an RGenerator or a
+  // Substream (rng.h); the two-argument versions use R's generator.
+  //
+  static void update_theta(State& s, const MixtureHyper& h) {
+    RGenerator g ;
+    update_theta(s, h, g) ;
+  }
+
+  template <class G>
+  static void update_theta(State& s, const MixtureHyper& h, G& g) {
+    const int B = s.B ;
+    const int K = s.K ;
+    for(int k = 0; k < K; ++k){
+      double tau2_tilde = 1.0 / s.tau2[k] ;
+      for(int b = 0; b < B; ++b){
+        int j = b + B * k ;
+        double sigma2_tilde = 1.0 / s.sigma2[variance_index<V>(b, k, B)] ;
+        double heavyn = s.sum_u[j] / h.df ;
+        // the data enter with weight temp (1 unless tempered)
+        double tn = s.temp * heavyn ;
+        double post_prec = tau2_tilde + tn * sigma2_tilde ;
+        if (post_prec == R_PosInf) {
+          throw std::runtime_error("Bad simulation. Run again with different start.");
+        }
+        double w1 = tau2_tilde / post_prec ;
+        double w2 = tn * sigma2_tilde / post_prec ;
+        double heavy_mean = s.sum_uy[j] / heavyn / h.df ;
+        double mu_n = w1 * s.mu[k] + w2 * heavy_mean ;
+        s.theta[j] = draw_norm(g, mu_n, sqrt(1.0 / post_prec)) ;
+      }
+    }
+  }
+
+  static void update_sigma2(State& s, const MixtureHyper& h) {
+    RGenerator g ;
+    update_sigma2(s, h, g) ;
+  }
+
+  template <class G>
+  static void update_sigma2(State& s, const MixtureHyper& h, G& g) {
+    const int B = s.B ;
+    const int K = s.K ;
+    const int nv = variance_size<V>(B, K) ;
+    std::vector<double> ss(nv, 0.0) ;
+    std::vector<double> nn(nv, 0.0) ;
+    for(int i = 0; i < s.N; ++i){
+      int b = batch_index<V>(s, i) ;
+      double r = s.y[i] - s.theta[b + B * s.z[i]] ;
+      ss[variance_index<V>(b, s.z[i], B)] += s.u[i] * r * r ;
+    }
+    for(int k = 0; k < K; ++k){
+      for(int b = 0; b < B; ++b){
+        nn[variance_index<V>(b, k, B)] += s.n[b + B * k] ;
+      }
+    }
+    for(int v = 0; v < nv; ++v){
+      double nu_n = s.nu0 + s.temp * nn[v] ;
+      double sigma2_nh = 1.0 / nu_n * (s.nu0 * s.sigma2_0 + s.temp * ss[v] / h.df) ;
+      double shape = 0.5 * nu_n ;
+      double rate = shape * sigma2_nh ;
+      s.sigma2[v] = 1.0 / draw_gamma(g, shape, 1.0 / rate) ;
+    }
+  }
+
+  static void update_p(State& s, const MixtureHyper& h) {
+    RGenerator g ;
+    update_p(s, h, g) ;
+  }
+
+  template <class G>
+  static void update_p(State& s, const MixtureHyper& h, G& g) {
+    double total = 0.0 ;
+    for(int k = 0; k < s.K; ++k){
+      s.pi[k] = draw_gamma(g, h.alpha[k] + s.zfreq[k], 1.0) ;
+      total += s.pi[k] ;
+    }
+    for(int k = 0; k < s.K; ++k) s.pi[k] /= total ;
+  }
+
+  static void update_mu(State& s, const MixtureHyper& h) {
+    RGenerator g ;
+    update_mu(s, h, g) ;
+  }
+
+  template <class G>
+  static void update_mu(State& s, const MixtureHyper& h, G& g) {
+    const int B = s.B ;
+    double tau2_0_tilde = 1.0 / h.tau2_0 ;
+    for(int k = 0; k < s.K; ++k){
+      double tau2_tilde = 1.0 / s.tau2[k] ;
+      double tau2_B_tilde = tau2_0_tilde + B * tau2_tilde ;
+      double w1 = tau2_0_tilde / tau2_B_tilde ;
+      double w2 = B * tau2_tilde / tau2_B_tilde ;
+      double n_k = 0.0 ;
+      double colsumtheta = 0.0 ;
+      for(int b = 0; b < B; ++b){
+        colsumtheta += s.n[b + B * k] * s.theta[b + B * k] ;
+        n_k += s.n[b + B * k] ;
+      }
+      double mu_n = w1 * h.mu0 + w2 * colsumtheta / n_k ;
+      double m = draw_norm(g, mu_n, sqrt(1.0 / tau2_B_tilde)) ;
+      // simulate from prior if NAs
+      if(ISNAN(m)) m = draw_norm(g, h.mu0, sqrt(h.tau2_0)) ;
+      s.mu[k] = m ;
+    }
+  }
+
+  static void update_tau2(State& s, const MixtureHyper& h) {
+    RGenerator g ;
+    update_tau2(s, h, g) ;
+  }
+
+  template <class G>
+  static void update_tau2(State& s, const MixtureHyper& h, G& g) {
+    const int B = s.B ;
+    double eta_B = h.eta0 + B ;
+    for(int k = 0; k < s.K; ++k){
+      double s2_k = 0.0 ;
+      for(int b = 0; b < B; ++b){
+        double d = s.theta[b + B * k] - s.mu[k] ;
+        s2_k += d * d ;
+      }
+      double m2_k = 1.0 / eta_B * (h.eta0 * h.m2_0 + s2_k) ;
+      s.tau2[k] = 1.0 / draw_gamma(g, 0.5 * eta_B, 2.0 / (eta_B * m2_k)) ;
+    }
+  }
+
+  static void update_sigma20(State& s, const MixtureHyper& h) {
+    RGenerator g ;
+    update_sigma20(s, h, g) ;
+  }
+
+  template <class G>
+  static void update_sigma20(State& s, const MixtureHyper& h, G& g) {
+    double prec = 0.0 ;
+    for(size_t v = 0; v < s.sigma2.size(); ++v) prec += 1.0 / s.sigma2[v] ;
+    double shape ;
+    double rate ;
+    sigma20_conditional(h.a, h.b, s.B * s.K, s.nu0, prec, shape, rate) ;
+    double s20 = draw_gamma(g, shape, 1.0 / rate) ;
+    if(s.constraint > 0 && s20 < s.constraint) return ;
+    s.sigma2_0 = s20 ;
+  }
+
+  static void update_nu0(State& s, const MixtureHyper& h) {
+    RGenerator g ;
+    update_nu0(s, h, g) ;
+  }
+
+  template <class G>
+  static void update_nu0(State& s, const MixtureHyper& h, G& g) {
+    double prec = 0.0 ;
+    double lprec = 0.0 ;
+    for(size_t v = 0; v < s.sigma2.size(); ++v){
+      prec += 1.0 / s.sigma2[v] ;
+      lprec += log(1.0 / s.sigma2[v]) ;
+    }
+    const Nu0Grid& grid = nu0_grid(h.nu0_max) ;
+    s.nu0 = grid.sample(s.B * s.K, s.sigma2_0, prec, lprec, h.beta, g.unif()) ;
+  }
+
+  // u from its prior (as in the original sampler, u is not updated
+  // given the data)
+  static void update_u(State& s, const MixtureHyper& h) {
+    RGenerator g ;
+    update_u(s, h, g) ;
+  }
+
+  template <class G>
+  static void update_u(State& s, const MixtureHyper& h, G& g) {
+    for(int i = 0; i < s.N; ++i) s.u[i] = L::normal ? h.df : g.chisq(h.df) ;
+  }
+
+  //
+  // log likelihood using the batch-specific empirical mixing
+  // proportions, plus the stage two log likelihood of theta and sigma2
+  //
+  static double loglik(const State& s, const MixtureHyper& h) {
+    double ll = 0.0 ;
+#define LOGLIK(KK) ll = loglik_k<KK>(s, h)
+    DISPATCH_K(s.K, LOGLIK)
+#undef LOGLIK
+    return ll ;
+  }
+
+  template <int KK>
+  static double loglik_k(const State& s, const MixtureHyper& h) {
+    const int B = s.B ;
+    const int K = k_size<KK>(s.K) ;
+    const int nv = variance_size<V>(B, K) ;
+    const Real df = h.df ;
+    std::vector<Real> theta(s.theta.begin(), s.theta.end()) ;
+    std::vector<Real> sigma(nv) ;
+    for(int v = 0; v < nv; ++v) sigma[v] = sqrt(s.sigma2[v]) ;
+    // P(b, k) * density constant / sigma for each batch and component
+    std::vector<double> w(B * K) ;
+    double c = exp(L::log_const(h.df)) ;
+    for(int b = 0; b < B; ++b){
+      double rowsum = 0.0 ;
+      for(int k = 0; k < K; ++k) rowsum += s.n[b + B * k] ;
+      for(int k = 0; k < K; ++k){
+        double sd = sqrt(s.sigma2[variance_index<V>(b, k, B)]) ;
+        w[b + B * k] = s.n[b + B * k] / rowsum * c / sd ;
+      }
+    }
+    double ll = 0.0 ;
+    std::vector<int> bl(LANE_BLOCK) ;
+    std::vector<Real> r(LANE_BLOCK) ;
+    std::vector<double> lik(LANE_BLOCK) ;
+    for(int i0 = 0; i0 < s.N; i0 += LANE_BLOCK){
+      const int n = std::min(LANE_BLOCK, s.N - i0) ;
+      for(int j = 0; j < n; ++j){
+        bl[j] = batch_index<V>(s, i0 + j) ;
+        lik[j] = 0.0 ;
+      }
+      for(int k = 0; k < K; ++k){
+        residual_lane<V>(&s.y[i0], &bl[0], n, k, B, &theta[0], &sigma[0], &r[0]) ;
+#ifdef _OPENMP
+#pragma omp simd
+#endif
+        for(int j = 0; j < n; ++j)
+          lik[j] += w[bl[j] + B * k] * std::exp(L::log_kernel(r[j], df)) ;
+      }
+      for(int j = 0; j < n; ++j) ll += log(lik[j]) ;
+    }
+    double shape = 0.5 * s.nu0 ;
+    double scale = 1.0 / (0.5 * s.nu0 * s.sigma2_0) ;
+    for(int k = 0; k < K; ++k){
+      double tau = sqrt(s.tau2[k]) ;
+      for(int b = 0; b < B; ++b){
+        ll += R::dnorm(s.theta[b + B * k], s.mu[k], tau, 1) ;
+        ll += R::dgamma(1.0 / s.sigma2[variance_index<V>(b, k, B)],
+                        shape, scale, 1) ;
+      }
+    }
+    return ll ;
+  }
+
+  //
+  // log likelihood given z, the part of the posterior that is raised to
+  // the power temp in a ReplicaExchange, up to a constant
+  //
+  static double tempered_loglik(const State& s, const MixtureHyper& h) {
+    const int B = s.B ;
+    const int nv = variance_size<V>(B, s.K) ;
+    std::vector<double> sigma(nv) ;
+    std::vector<double> lsigma(nv) ;
+    for(int v = 0; v < nv; ++v){
+      sigma[v] = sqrt(s.sigma2[v]) ;
+      lsigma[v] = log(sigma[v]) ;
+    }
+    double ll = 0.0 ;
+    for(int i = 0; i < s.N; ++i){
+      int b = batch_index<V>(s, i) ;
+      int v = variance_index<V>(b, s.z[i], B) ;
+      double r = (s.y[i] - s.theta[b + B * s.z[i]]) / sigma[v] ;
+      ll += L::log_kernel(r, h.df) - lsigma[v] ;
+    }
+    return ll ;
+  }
+
+  static double logprior(const State& s, const MixtureHyper& h) {
+    double lp = 0.0 ;
+    for(int k = 0; k < s.K; ++k) lp += R::dnorm(s.mu[k], h.mu0, sqrt(h.tau2_0), 1) ;
+    lp += R::dgamma(s.sigma2_0, h.a, 1.0 / h.b, 1) ;
+    lp += R::dgeom(s.nu0, h.beta, 1) ;
+    return lp ;
+  }
+
+  //
+  // One draw from the posterior predictive per batch and component.
+  // Mixture probabilities are assumed to be the same for each batch.
+  //
+  static void update_predictive(State& s, const MixtureHyper& h) {
+    const int B = s.B ;
+    const int K = s.K ;
+    s.ystar.resize(B * K) ;
+    s.zstar.resize(B * K) ;
+    int j = 0 ;
+    for(int k = 0; k < K; ++k){
+      double u = R::unif_rand() ;
+      double acc = 0.0 ;
+      int index = K - 1 ;
+      for(int l = 0; l < K; ++l){
+        acc += s.pi[l] ;
+        if(u < acc){
+          index = l ;
+          break ;
+        }
+      }
+      for(int b = 0; b < B; ++b){
+        double sigma = sqrt(s.sigma2[variance_index<V>(b, index, B)]) ;
+        double w = L::draw_u(h.df) ;
+        s.ystar[j] = s.theta[b + B * index] + sigma * norm_rand() * sqrt(h.df / w) ;
+        s.zstar[j] = index ;
+        j++ ;
+      }
+    }
+  }
+
+  //
+  // Counts for probz: the component with the lowest mean in the first
+  // batch is column 1, the second lowest is column 2, etc.
+  //
+  static void update_probz(const State& s, int* probz) {
+    const int K = s.K ;
+    std::vector<int> cn(K, 0) ;
+    for(int k = 0; k < K; ++k){
+      for(int l = 0; l < K; ++l){
+        if(s.theta[s.B * l] < s.theta[s.B * k]) cn[k]++ ;
+      }
+    }
+    for(int i = 0; i < s.N; ++i){
+      probz[i + s.N * cn[s.z[i]]] += 1 ;
+    }
+  }
+
+  //
+  // One Gibbs scan.  If probz is not NULL, the counts for the ordered
+  // components are updated after z is drawn.  If prof is not NULL and
+  // enabled, each update is timed (profile.h).
+  //
+  static void sweep(State& s, const MixtureHyper& h, int* probz = NULL,
+                    SamplerProfile* prof = NULL) {
+    RGenerator g ;
+    tempered_sweep(s, h, g, probz, prof) ;
+  }
+
+  //
+  // The scan of sweep at s.temp, drawing from g.  The likelihood is
+  // raised to the power temp in the z, theta, and sigma2 updates; with
+  // temp = 1 this is sweep.
+  //
+  template <class G>
+  static void tempered_sweep(State& s, const MixtureHyper& h, G& g,
+                             int* probz = NULL, SamplerProfile* prof = NULL) {
+    {
+      ProfileTimer t(prof, PROF_Z) ;
+      update_z(s, h, g) ;
+      tabulate(s) ;
+    }
+    if(probz != NULL){
+      ProfileTimer t(prof, PROF_PROBZ) ;
+      update_probz(s, probz) ;
+    }
+    { ProfileTimer t(prof, PROF_THETA) ; update_theta(s, h, g) ; }
+    { ProfileTimer t(prof, PROF_SIGMA2) ; update_sigma2(s, h, g) ; }
+    { ProfileTimer t(prof, PROF_PI) ; update_p(s, h, g) ; }
+    { ProfileTimer t(prof, PROF_MU) ; update_mu(s, h, g) ; }
+    { ProfileTimer t(prof, PROF_TAU2) ; update_tau2(s, h, g) ; }
+    { ProfileTimer t(prof, PROF_NU0) ; update_nu0(s, h, g) ; }
+    { ProfileTimer t(prof, PROF_SIGMA20) ; update_sigma20(s, h, g) ; }
+    { ProfileTimer t(prof, PROF_U) ; update_u(s, h, g) ; }
+  }
+} ;
+
+//
+// Exchanges the parameters and sufficient statistics of two states.
+// The data, the temperature, the counter of rejected z updates, and the
+// posterior predictive draws stay with their state.
+//
+template <class Real>
+void swap_parameters(BasicMixtureState<Real>& a, BasicMixtureState<Real>& b) {
+  a.z.swap(b.z) ;
+  a.u.swap(b.u) ;
+  a.theta.swap(b.theta) ;
+  a.sigma2.swap(b.sigma2) ;
+  a.pi.swap(b.pi) ;
+  a.mu.swap(b.mu) ;
+  a.tau2.swap(b.tau2) ;
+  std::swap(a.nu0, b.nu0) ;
+  std::swap(a.sigma2_0, b.sigma2_0) ;
+  a.zfreq.swap(b.zfreq) ;
+  a.n.swap(b.n) ;
+  a.sum_u.swap(b.sum_u) ;
+  a.sum_uy.swap(b.sum_uy) ;
+}
+
+//
+// Replica exchange (parallel tempering).  Replica j runs the scan of
+// MixtureSampler::sweep with the likelihood raised to the power
+// temps[j] (tempered_sweep), where temps[0] = 1 is the cold chain -- the
+// state passed to sweep, which samples the same posterior as the
+// untempered sampler -- and 1 > temps[1] > ... > 0.  After each scan of all replicas,
+// the parameters of neighbouring temperatures are proposed to be
+// exchanged (even pairs after even scans, odd pairs after odd scans) and
+// accepted with probability
+//
+//   min(1, exp((temps[j] - temps[j + 1]) * (l[j + 1] - l[j])))
+//
+// where l is tempered_loglik.  Only the cold chain is recorded.
+//
+// The replicas are scanned in parallel on up to nthreads threads.  The
+// replica at temperature j draws from Substream(seed, j), so that the
+// results do not depend on the number of threads; the exchanges use R's
+// generator.  The hot replicas start from the cold state unless they
+// are restored (replicas() and restore()) from an earlier run.  With a
+// single temperature, sweep is MixtureSampler::sweep.
+//
+template <class V, class L, class Real = double>
+class ReplicaExchange {
+public:
+  typedef BasicMixtureState<Real> State ;
+  typedef MixtureSampler<V, L, Real> Sampler ;
+
+  ReplicaExchange(const State& cold, const std::vector<double>& temperatures,
+                  int nthreads = 1) :
+    temps(temperatures), nthreads(std::max(1, nthreads)), parity(0) {
+    if(temps.empty()) temps.push_back(1.0) ;
+    if(temps.size() == 1) return ;
+    uint64_t seed = substream_seed() ;
+    for(size_t j = 0; j < temps.size(); ++j) rng.push_back(Substream(seed, j)) ;
+    for(size_t j = 1; j < temps.size(); ++j){
+      hot.push_back(cold) ;
+      hot.back().temp = temps[j] ;
+      hot.back().counter = 0 ;
+    }
+    accepted.assign(temps.size() - 1, 0.0) ;
+    proposed.assign(temps.size() - 1, 0.0) ;
+  }
+
+  int size() const { return temps.size() ; }
+
+  const std::vector<State>& replicas() const { return hot ; }
+
+  //
+  // Sets the parameters of the hot replicas.  states must have one
+  // element per hot replica; only their parameters are used.
+  //
+  void restore(std::vector<State>& states) {
+    if(states.size() != hot.size()) return ;
+    for(size_t j = 0; j < hot.size(); ++j){
+      swap_parameters(hot[j], states[j]) ;
+      Sampler::tabulate(hot[j]) ;
+    }
+  }
+
+  void sweep(State& cold, const MixtureHyper& h, int* probz = NULL,
+             SamplerProfile* prof = NULL) {
+    if(hot.empty()){
+      Sampler::sweep(cold, h, probz, prof) ;
+      return ;
+    }
+    const int R = temps.size() ;
+    std::vector<State*> reps(R) ;
+    std::vector<double> ll(R) ;
+    std::vector<std::string> error(R) ;
+    reps[0] = &cold ;
+    cold.temp = temps[0] ;
+    for(int j = 1; j < R; ++j) reps[j] = &hot[j - 1] ;
+    // only the cold replica is profiled
+#ifdef _OPENMP
+#pragma omp parallel for schedule(static, 1) num_threads(std::min(nthreads, R))
+#endif
+    for(int j = 0; j < R; ++j){
+      try {
+        Sampler::tempered_sweep(*reps[j], h, rng[j], j == 0 ? probz : NULL,
+                                j == 0 ? prof : NULL) ;
+        ll[j] = Sampler::tempered_loglik(*reps[j], h) ;
+      } catch(std::exception& e){
+        error[j] = e.what() ;
+      }
+    }
+    for(int j = 0; j < R; ++j){
+      if(!error[j].empty()) throw std::runtime_error(error[j]) ;
+    }
+    for(int j = parity; j + 1 < R; j += 2){
+      proposed[j] += 1.0 ;
+      double a = (temps[j] - temps[j + 1]) * (ll[j + 1] - ll[j]) ;
+      if(a >= 0.0 || log(R::unif_rand()) < a){
+        swap_parameters(*reps[j], *reps[j + 1]) ;
+        accepted[j] += 1.0 ;
+      }
+    }
+    parity = 1 - parity ;
+  }
+
+  // the exchange counts and parity, saved at a checkpoint
+  std::vector<double> exchange_state() const {
+    std::vector<double> x(accepted) ;
+    x.insert(x.end(), proposed.begin(), proposed.end()) ;
+    x.push_back(parity) ;
+    return x ;
+  }
+
+  void restore_exchange(const std::vector<double>& x) {
+    const size_t n = accepted.size() ;
+    if(n == 0 || x.size() != 2 * n + 1) return ;
+    std::copy(x.begin(), x.begin() + n, accepted.begin()) ;
+    std::copy(x.begin() + n, x.begin() + 2 * n, proposed.begin()) ;
+    parity = (int) x[2 * n] ;
+  }
+
+  // acceptance rate of the exchanges between temperatures j and j + 1
+  std::vector<double> swap_rates() const {
+    std::vector<double> rate(accepted.size()) ;
+    for(size_t j = 0; j < rate.size(); ++j){
+      rate[j] = proposed[j] > 0 ? accepted[j] / proposed[j] : NA_REAL ;
+    }
+    return rate ;
+  }
+
+private:
+  std::vector<double> temps ;
+  int nthreads ;
+  std::vector<Substream> rng ;
+  std::vector<State> hot ;
+  std::vector<double> accepted ;
+  std::vector<double> proposed ;
+  int parity ;
+} ;
+
+//
+// Posterior probabilities of component membership for M observations
+// with t-likelihood:
+//
+//    P(i, k) proportional to weight(i, k) * f(x[i] | theta(b, k), sigma2(b, k))
+//
+// where b = batch[i] (zero-based).  weight(i, k) = w[i * wr + k * wc],
+// so that wr = 0 gives weights shared by all observations (the mixing
+// proportions) and wr = 1, wc = M a per-observation M x K matrix (the
+// Mendelian transmission probabilities).  theta and sigma2 are B x K
+// column-major; P is M x K column-major.  If rows is not NULL, the i-th
+// observation is x[rows[i]] in batch[rows[i]], so that a subset of the
+// data (e.g., the offspring of a trio model) is used without copying.
+//
+template <class L, int KK>
+void component_probs_k(int K, int M, int B, const double* x, const int* batch,
+                       const double* theta, const double* sigma2,
+                       const double* w, int wr, int wc, double df,
+                       double* P, const int* rows) {
+  K = k_size<KK>(K) ;
+  std::vector<double> sigma(B * K) ;
+  for(int j = 0; j < B * K; ++j) sigma[j] = sqrt(sigma2[j]) ;
+  KBuffer<KK> d(K) ;
+  for(int i = 0; i < M; ++i){
+    int row = rows ? rows[i] : i ;
+    int b = batch[row] ;
+    double xi = x[row] ;
+    double total = 0.0 ;
+    for(int k = 0; k < K; ++k){
+      double r = (xi - theta[b + B * k]) / sigma[b + B * k] ;
+      d[k] = w[i * wr + k * wc] * exp(L::log_kernel(r, df)) / sigma[b + B * k] ;
+      total += d[k] ;
+    }
+    for(int k = 0; k < K; ++k) P[i + M * k] = d[k] / total ;
+  }
+}
+
+template <class L>
+void component_probs(int K, int M, int B, const double* x, const int* batch,
+                     const double* theta, const double* sigma2,
+                     const double* w, int wr, int wc, double df,
+                     double* P, const int* rows = NULL) {
+#define COMPONENT_PROBS(KK) component_probs_k<L, KK>(K, M, B, x, batch, theta, \
+                                                     sigma2, w, wr, wc, df, P, rows)
+  DISPATCH_K(K, COMPONENT_PROBS)
+#undef COMPONENT_PROBS
+}
+
+//
+// The parameters at the first iteration with the largest finite log
+// likelihood -- the first iteration if none is finite -- as in argMax.
+// Only the parameters of state are set.
+//
+template <class Real>
+struct MixtureMode {
+  BasicMixtureState<Real> state ;
+  double loglik ;
+  double logprior ;
+  bool found ;
+  bool empty ;
+  MixtureMode() : loglik(R_NegInf), logprior(NA_REAL), found(false), empty(true) {}
+  void update(const BasicMixtureState<Real>& s, double ll, double lp) {
+    bool finite = std::isfinite(ll) ;
+    if(!empty && !(finite && (!found || ll > loglik))) return ;
+    if(finite) found = true ;
+    empty = false ;
+    state.N = s.N ;
+    state.B = s.B ;
+    state.K = s.K ;
+    state.theta = s.theta ;
+    state.sigma2 = s.sigma2 ;
+    state.pi = s.pi ;
+    state.mu = s.mu ;
+    state.tau2 = s.tau2 ;
+    state.nu0 = s.nu0 ;
+    state.sigma2_0 = s.sigma2_0 ;
+    state.zfreq = s.zfreq ;
+    loglik = ll ;
+    logprior = lp ;
+  }
+} ;
+
+#ifndef CNPBAYES_STANDALONE
+
+// Conversion between the S4 model and the native state (sampler.cpp)
+MixtureHyper hyper_from_model(Rcpp::S4 model) ;
+template <class Real>
+BasicMixtureState<Real> state_from_model(Rcpp::S4 model, bool pooled) ;
+template <class Real>
+void state_to_model(const BasicMixtureState<Real>& s, Rcpp::S4 model, bool pooled) ;
+
+// TRUE if McmcParams requests single-precision data and densities
+bool singlePrecision(Rcpp::S4 mcmcp) ;
+
+// TRUE if McmcParams requests the timing of the updates (profile.h)
+bool profiling(Rcpp::S4 mcmcp) ;
+
+// inverse temperatures of the replicas (ReplicaExchange); 1 if not
+// tempered
+std::vector<double> temperatures(Rcpp::S4 mcmcp) ;
+
+// threads for the replicas of a ReplicaExchange
+// (options(CNPBayes.nthreads=), default 1)
+int samplerThreads() ;
+
+//
+// Adaptive thinning (McmcParams(adaptive_thin=TRUE)): the burnin keeps
+// the last THIN_WINDOW draws of theta and pi and, if there are at least
+// THIN_MIN_DRAWS, sets the thin of the model's McmcParams to the largest
+// integrated autocorrelation time (AutocorrWindow), rounded up and at
+// most McmcParams(max_thin=).  maxThin returns 0 when thinning is not
+// adaptive.
+//
+const int THIN_WINDOW = 2000 ;
+const int THIN_MIN_DRAWS = 100 ;
+
+int maxThin(Rcpp::S4 mcmcp) ;
+
+// burnin, thin, iter, precision, temperatures and adaptive thinning are
+// taken from mcmcp.  start is the number of iterations completed before
+// a checkpoint (monitor.h).
+Rcpp::S4 burnin_sampler(Rcpp::S4 object, Rcpp::S4 mcmcp, bool pooled, int start = 0) ;
+Rcpp::S4 mcmc_sampler(Rcpp::S4 object, Rcpp::S4 mcmcp, bool pooled, int start = 0) ;
+
+#endif
+
+#endif
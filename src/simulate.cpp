@@ -0,0 +1,253 @@
+#include "simulate.h"
+#include "sampler.h"
+#include "rng.h"
+#include <cmath>
+#include <algorithm>
+#include <stdexcept>
+#ifdef _OPENMP
+#include <omp.h>
+#endif
+
+namespace {
+
+void check_design(const SimulationDesign& d) {
+  if(d.B < 1 || d.K < 1) throw std::invalid_argument("B and K must be positive") ;
+  if((int) d.theta.size() != d.B * d.K) throw std::invalid_argument("theta must be B x K") ;
+  const int nv = d.pooled ? d.B : d.B * d.K ;
+  if((int) d.sigma2.size() != nv) throw std::invalid_argument("sigma2 must be B x K (length B if pooled)") ;
+  for(int j = 0; j < nv; ++j){
+    if(!(d.sigma2[j] > 0.0)) throw std::invalid_argument("sigma2 must be positive") ;
+  }
+  if((int) d.p.size() != d.K) throw std::invalid_argument("p must have length K") ;
+  double total = 0.0 ;
+  for(int k = 0; k < d.K; ++k){
+    if(!(d.p[k] >= 0.0)) throw std::invalid_argument("p must be non-negative") ;
+    total += d.p[k] ;
+  }
+  if(!(total > 0.0)) throw std::invalid_argument("p must have a positive sum") ;
+  if(!(d.df > 0.0)) throw std::invalid_argument("df must be positive") ;
+  if(!(d.outlier_prob >= 0.0 && d.outlier_prob <= 1.0))
+    throw std::invalid_argument("outlier_prob must be in [0, 1]") ;
+  if(d.outlier_prob > 0.0 && !(d.outlier_upper >= d.outlier_lower))
+    throw std::invalid_argument("outlier range must be increasing") ;
+}
+
+void check_batch(const int* batch, int n, int B) {
+  for(int i = 0; i < n; ++i){
+    if(batch[i] < 0 || batch[i] >= B) throw std::invalid_argument("batch codes must be in 1, ..., B") ;
+  }
+}
+
+// cumulative proportions, normalized to sum to one
+std::vector<double> cumulative(const double* p, int K) {
+  std::vector<double> cp(K) ;
+  double total = 0.0 ;
+  for(int k = 0; k < K; ++k){
+    total += p[k] ;
+    cp[k] = total ;
+  }
+  for(int k = 0; k < K; ++k) cp[k] /= total ;
+  cp[K - 1] = 1.0 ;
+  return cp ;
+}
+
+inline int draw_label(const double* cp, int K, double u) {
+  int k = 0 ;
+  while(k < K - 1 && u > cp[k]) ++k ;
+  return k ;
+}
+
+// observation of component k in batch b; sets outlier
+template <class L>
+inline double draw_y(const SimulationDesign& d, int b, int k, Substream& rng,
+                     int& outlier) {
+  if(d.outlier_prob > 0.0 && rng.unif() < d.outlier_prob){
+    outlier = 1 ;
+    return d.outlier_lower + (d.outlier_upper - d.outlier_lower) * rng.unif() ;
+  }
+  outlier = 0 ;
+  const double sigma = std::sqrt(d.sigma2[d.pooled ? b : b + d.B * k]) ;
+  double e = rng.norm() ;
+  if(!L::normal) e *= std::sqrt(d.df / rng.chisq(d.df)) ;
+  return d.theta[b + d.B * k] + sigma * e ;
+}
+
+template <class L>
+void mixture_kernel(const SimulationDesign& d, const int* batch, int N,
+                    int nthreads, uint64_t seed, SimulatedData& out) {
+  const std::vector<double> cp = cumulative(d.p.data(), d.K) ;
+#ifdef _OPENMP
+#pragma omp parallel for schedule(static, SIM_BLOCK) num_threads(std::max(1, nthreads))
+#endif
+  for(int i = 0; i < N; ++i){
+    Substream rng(seed, i) ;
+    int k = draw_label(cp.data(), d.K, rng.unif()) ;
+    out.z[i] = k ;
+    out.y[i] = draw_y<L>(d, batch[i], k, rng, out.outlier[i]) ;
+  }
+}
+
+template <class L>
+void trio_kernel(const SimulationDesign& d, const double* tensor,
+                 double nonmendelian, const int* batch, int T, int nthreads,
+                 uint64_t seed, SimulatedData& out) {
+  const int K = d.K ;
+  const std::vector<double> cp = cumulative(d.p.data(), K) ;
+  std::vector<double> ct(K * K * K) ;
+  for(int j = 0; j < K * K; ++j){
+    std::vector<double> c = cumulative(tensor + K * j, K) ;
+    std::copy(c.begin(), c.end(), ct.begin() + K * j) ;
+  }
+#ifdef _OPENMP
+#pragma omp parallel for schedule(static, SIM_BLOCK) num_threads(std::max(1, nthreads))
+#endif
+  for(int t = 0; t < T; ++t){
+    Substream rng(seed, t) ;
+    const int m = 3 * t ;
+    const int f = m + 1 ;
+    const int o = m + 2 ;
+    int zm = draw_label(cp.data(), K, rng.unif()) ;
+    int zf = draw_label(cp.data(), K, rng.unif()) ;
+    int mendel = nonmendelian > 0.0 && rng.unif() < nonmendelian ? 0 : 1 ;
+    const double* co = mendel == 1 ? &ct[K * (zf + K * zm)] : cp.data() ;
+    int zo = draw_label(co, K, rng.unif()) ;
+    out.z[m] = zm ;
+    out.z[f] = zf ;
+    out.z[o] = zo ;
+    out.mendelian[t] = mendel ;
+    out.y[m] = draw_y<L>(d, batch[m], zm, rng, out.outlier[m]) ;
+    out.y[f] = draw_y<L>(d, batch[f], zf, rng, out.outlier[f]) ;
+    out.y[o] = draw_y<L>(d, batch[o], zo, rng, out.outlier[o]) ;
+  }
+}
+
+}
+
+void simulate_mixture(const SimulationDesign& d, const int* batch, int N,
+                      int nthreads, uint64_t seed, SimulatedData& out) {
+  check_design(d) ;
+  check_batch(batch, N, d.B) ;
+  out.y.assign(N, 0.0) ;
+  out.z.assign(N, 0) ;
+  out.outlier.assign(N, 0) ;
+  out.mendelian.clear() ;
+  if(d.df >= NORMAL_LIMIT_DF) mixture_kernel<NormalLimit>(d, batch, N, nthreads, seed, out) ;
+  else mixture_kernel<StudentT>(d, batch, N, nthreads, seed, out) ;
+}
+
+void simulate_trios(const SimulationDesign& d, const double* tensor,
+                    double nonmendelian, const int* batch, int T,
+                    int nthreads, uint64_t seed, SimulatedData& out) {
+  check_design(d) ;
+  check_batch(batch, 3 * T, d.B) ;
+  if(!(nonmendelian >= 0.0 && nonmendelian <= 1.0))
+    throw std::invalid_argument("nonmendelian must be in [0, 1]") ;
+  const int K = d.K ;
+  for(int j = 0; j < K * K; ++j){
+    double total = 0.0 ;
+    for(int o = 0; o < K; ++o){
+      if(!(tensor[o + K * j] >= 0.0)) throw std::invalid_argument("transmission probabilities must be non-negative") ;
+      total += tensor[o + K * j] ;
+    }
+    if(!(total > 0.0)) throw std::invalid_argument("each parental pair needs a positive transmission probability") ;
+  }
+  out.y.assign(3 * T, 0.0) ;
+  out.z.assign(3 * T, 0) ;
+  out.outlier.assign(3 * T, 0) ;
+  out.mendelian.assign(T, 1) ;
+  if(d.df >= NORMAL_LIMIT_DF) trio_kernel<NormalLimit>(d, tensor, nonmendelian, batch, T, nthreads, seed, out) ;
+  else trio_kernel<StudentT>(d, tensor, nonmendelian, batch, T, nthreads, seed, out) ;
+}
+
+#ifndef CNPBAYES_STANDALONE
+using namespace Rcpp ;
+
+static SimulationDesign design_from(NumericMatrix theta, NumericVector sigma2,
+                                    NumericVector p, bool pooled, double df,
+                                    double outlier_prob,
+                                    NumericVector outlier_range) {
+  SimulationDesign d ;
+  d.B = theta.nrow() ;
+  d.K = theta.ncol() ;
+  d.theta.assign(theta.begin(), theta.end()) ;
+  d.sigma2.assign(sigma2.begin(), sigma2.end()) ;
+  d.p.assign(p.begin(), p.end()) ;
+  d.pooled = pooled ;
+  d.df = df ;
+  d.outlier_prob = outlier_prob ;
+  if(outlier_range.size() != 2) stop("outlier_range must have length 2") ;
+  d.outlier_lower = outlier_range[0] ;
+  d.outlier_upper = outlier_range[1] ;
+  return d ;
+}
+
+static std::vector<int> batch0(IntegerVector batch) {
+  std::vector<int> b(batch.size()) ;
+  for(int i = 0; i < batch.size(); ++i) b[i] = batch[i] - 1 ;
+  return b ;
+}
+
+static List simulated_list(const SimulatedData& out) {
+  IntegerVector z(out.z.size()) ;
+  for(size_t i = 0; i < out.z.size(); ++i) z[i] = out.z[i] + 1 ;
+  LogicalVector outlier(out.outlier.begin(), out.outlier.end()) ;
+  return List::create(Named("y") = wrap(out.y),
+                      Named("z") = z,
+                      Named("outlier") = outlier,
+                      Named("mendelian") = wrap(out.mendelian)) ;
+}
+
+//
+// Batch t-mixture (see simulate_mixture).  batch contains codes 1, ...,
+// nrow(theta); sigma2 is a matrix like theta, or has one variance per
+// batch when pooled.  Returns a list with elements y, z (1-based), and
+// outlier.
+//
+// [[Rcpp::export]]
+Rcpp::List sim_batch_data(Rcpp::IntegerVector batch, Rcpp::NumericMatrix theta,
+                          Rcpp::NumericVector sigma2, Rcpp::NumericVector p,
+                          bool pooled, double df, double outlier_prob,
+                          Rcpp::NumericVector outlier_range, int nthreads = 1) {
+  RNGScope scope ;
+  SimulationDesign d = design_from(theta, sigma2, p, pooled, df, outlier_prob,
+                                   outlier_range) ;
+  std::vector<int> b = batch0(batch) ;
+  const uint64_t seed = substream_seed() ;
+  SimulatedData out ;
+  try {
+    simulate_mixture(d, b.data(), b.size(), nthreads, seed, out) ;
+  } catch(std::invalid_argument& e) {
+    stop(e.what()) ;
+  }
+  return simulated_list(out) ;
+}
+
+//
+// Trios (see simulate_trios); tensor is the K x K x K array of
+// .transmission_tensor.  Rows are ordered mother, father, offspring
+// within each trio.  The list also has the Mendelian indicators of the
+// trios.
+//
+// [[Rcpp::export]]
+Rcpp::List sim_trio_data(Rcpp::IntegerVector batch, Rcpp::NumericMatrix theta,
+                         Rcpp::NumericVector sigma2, Rcpp::NumericVector p,
+                         Rcpp::NumericVector tensor, double nonmendelian,
+                         double df, double outlier_prob,
+                         Rcpp::NumericVector outlier_range, int nthreads = 1) {
+  RNGScope scope ;
+  SimulationDesign d = design_from(theta, sigma2, p, false, df, outlier_prob,
+                                   outlier_range) ;
+  if(batch.size() % 3 != 0) stop("batch must have 3 elements per trio") ;
+  if(tensor.size() != d.K * d.K * d.K) stop("tensor must be K x K x K") ;
+  std::vector<int> b = batch0(batch) ;
+  const uint64_t seed = substream_seed() ;
+  SimulatedData out ;
+  try {
+    simulate_trios(d, tensor.begin(), nonmendelian, b.data(), b.size() / 3,
+                   nthreads, seed, out) ;
+  } catch(std::invalid_argument& e) {
+    stop(e.what()) ;
+  }
+  return simulated_list(out) ;
+}
+#endif
@@ -0,0 +1,66 @@
+#ifndef _simulate_H
+#define _simulate_H
+#include "rmath.h"
+#include <vector>
+#include <stdint.h>
+
+//
+// Simulation of copy number data for the batch, pooled, and trio
+// designs.  An observation in batch b with component k is drawn from
+// the t-distribution with location theta(b, k), scale sigma(b, k) (or
+// sigma(b) for pooled variances), and df degrees of freedom -- the
+// scale mixture y = theta + sigma * e * sqrt(df / u) with e standard
+// normal and u chi-square on df degrees of freedom; for df >=
+// NORMAL_LIMIT_DF the draw is normal.  With probability outlier_prob
+// the observation is replaced by a uniform draw on (outlier_lower,
+// outlier_upper).
+//
+// Observations (or trios) are drawn in parallel, each from its own
+// Substream, so the data do not depend on the number of threads.
+//
+struct SimulationDesign {
+  int B ;
+  int K ;
+  std::vector<double> theta ;   // B x K, column-major
+  std::vector<double> sigma2 ;  // B x K, or length B when pooled
+  std::vector<double> p ;       // mixing proportions (length K)
+  bool pooled ;
+  double df ;
+  double outlier_prob ;
+  double outlier_lower ;
+  double outlier_upper ;
+} ;
+
+// number of consecutive observations (or trios) assigned to a thread
+const int SIM_BLOCK = 1024 ;
+
+//
+// y, the 0-based components z, and the outlier indicators.  For trios
+// the rows are ordered mother, father, offspring within each trio and
+// mendelian has one indicator per trio.
+//
+struct SimulatedData {
+  std::vector<double> y ;
+  std::vector<int> z ;
+  std::vector<int> outlier ;
+  std::vector<int> mendelian ;
+} ;
+
+//
+// N observations with 0-based batch codes batch[i] < B.  Throws
+// std::invalid_argument for a bad design.
+//
+void simulate_mixture(const SimulationDesign& d, const int* batch, int N,
+                      int nthreads, uint64_t seed, SimulatedData& out) ;
+
+//
+// T trios (3T observations; batch has length 3T).  The parents'
+// components are drawn from p and the offspring's component from the
+// transmission tensor, tensor[o + K * (f + K * m)] = p(offspring o |
+// father f, mother m), or -- with probability nonmendelian -- from p.
+//
+void simulate_trios(const SimulationDesign& d, const double* tensor,
+                    double nonmendelian, const int* batch, int T,
+                    int nthreads, uint64_t seed, SimulatedData& out) ;
+
+#endif
@@ -0,0 +1,384 @@
+#include "starts.h"
+#include "sampler.h"
+#include "rng.h"
+#include <cmath>
+#include <algorithm>
+#include <stdexcept>
+#ifdef _OPENMP
+#include <omp.h>
+#endif
+
+namespace {
+
+struct StartData {
+  const double* y ;
+  const int* batch ;  // 0-based
+  int N ;
+  int B ;
+  int K ;
+  double df ;
+  bool pooled ;
+  double vy ;         // variance of y
+  double floor ;      // smallest variance of a start
+} ;
+
+//
+// k-means++: the first center is drawn uniformly from the data and each
+// subsequent center with probability proportional to the squared
+// distance to the nearest center drawn so far.
+//
+void seed_centers(const StartData& d, Substream& rng, std::vector<double>& centers) {
+  const int N = d.N ;
+  std::vector<double> D2(N, R_PosInf) ;
+  centers.resize(d.K) ;
+  int j = std::min((int) (rng.unif() * N), N - 1) ;
+  centers[0] = d.y[j] ;
+  for(int k = 1; k < d.K; ++k){
+    double total = 0.0 ;
+    for(int i = 0; i < N; ++i){
+      double r = d.y[i] - centers[k - 1] ;
+      if(r * r < D2[i]) D2[i] = r * r ;
+      total += D2[i] ;
+    }
+    if(total > 0.0){
+      double u = rng.unif() * total ;
+      double cum = D2[0] ;
+      j = 0 ;
+      while(cum < u && j < N - 1) cum += D2[++j] ;
+    } else {
+      j = std::min((int) (rng.unif() * N), N - 1) ;
+    }
+    centers[k] = d.y[j] ;
+  }
+  std::sort(centers.begin(), centers.end()) ;
+}
+
+//
+// Hard assignment to the nearest center.  Every batch starts from the
+// centers; the variance of a component is the mean squared distance of
+// its members (all batches).
+//
+void start_from_centers(const StartData& d, const std::vector<double>& centers,
+                        StartState& s) {
+  const int K = d.K ;
+  const int B = d.B ;
+  std::vector<double> n(K, 0.0) ;
+  std::vector<double> ss(K, 0.0) ;
+  for(int i = 0; i < d.N; ++i){
+    int best = 0 ;
+    double dmin = R_PosInf ;
+    for(int k = 0; k < K; ++k){
+      double r = d.y[i] - centers[k] ;
+      if(r * r < dmin){
+        dmin = r * r ;
+        best = k ;
+      }
+    }
+    n[best] += 1.0 ;
+    ss[best] += dmin ;
+  }
+  s.theta.resize(B * K) ;
+  s.p.resize(K) ;
+  double ss_all = 0.0 ;
+  for(int k = 0; k < K; ++k){
+    for(int b = 0; b < B; ++b) s.theta[b + B * k] = centers[k] ;
+    s.p[k] = (n[k] + 1.0) / (d.N + K) ;
+    ss_all += ss[k] ;
+  }
+  if(d.pooled){
+    s.sigma2.assign(B, std::max(ss_all / d.N, d.floor)) ;
+  } else {
+    s.sigma2.resize(B * K) ;
+    for(int k = 0; k < K; ++k){
+      double v = n[k] >= 2.0 ? ss[k] / n[k] : d.vy ;
+      for(int b = 0; b < B; ++b) s.sigma2[b + B * k] = std::max(v, d.floor) ;
+    }
+  }
+  s.z.assign(d.N, 0) ;
+}
+
+//
+// iters EM steps followed by an E-step for the log likelihood (up to
+// the constant L::log_const(df) per observation) and the most probable
+// component of each observation.
+//
+template <class L>
+void em_steps(const StartData& d, int iters, StartState& s) {
+  const int N = d.N ;
+  const int B = d.B ;
+  const int K = d.K ;
+  const int BK = B * K ;
+  const double df = d.df ;
+  std::vector<double> lp(K) ;
+  std::vector<double> sr(BK) ;
+  std::vector<double> srw(BK) ;
+  std::vector<double> srwy(BK) ;
+  std::vector<double> srwyy(BK) ;
+  for(int it = 0; ; ++it){
+    std::fill(sr.begin(), sr.end(), 0.0) ;
+    std::fill(srw.begin(), srw.end(), 0.0) ;
+    std::fill(srwy.begin(), srwy.end(), 0.0) ;
+    std::fill(srwyy.begin(), srwyy.end(), 0.0) ;
+    double ll = 0.0 ;
+    for(int i = 0; i < N; ++i){
+      const int b = d.batch[i] ;
+      const double y = d.y[i] ;
+      double lmax = R_NegInf ;
+      int best = 0 ;
+      for(int k = 0; k < K; ++k){
+        const int bk = b + B * k ;
+        const double s2 = d.pooled ? s.sigma2[b] : s.sigma2[bk] ;
+        const double r = (y - s.theta[bk]) / std::sqrt(s2) ;
+        lp[k] = std::log(s.p[k]) - 0.5 * std::log(s2) + L::log_kernel(r, df) ;
+        if(lp[k] > lmax){
+          lmax = lp[k] ;
+          best = k ;
+        }
+      }
+      double total = 0.0 ;
+      for(int k = 0; k < K; ++k){
+        lp[k] = std::exp(lp[k] - lmax) ;
+        total += lp[k] ;
+      }
+      ll += lmax + std::log(total) ;
+      s.z[i] = best ;
+      if(it == iters) continue ;
+      for(int k = 0; k < K; ++k){
+        const int bk = b + B * k ;
+        const double resp = lp[k] / total ;
+        double w = 1.0 ;
+        if(!L::normal){
+          const double s2 = d.pooled ? s.sigma2[b] : s.sigma2[bk] ;
+          const double r2 = (y - s.theta[bk]) * (y - s.theta[bk]) / s2 ;
+          w = (df + 1.0) / (df + r2) ;
+        }
+        sr[bk] += resp ;
+        srw[bk] += resp * w ;
+        srwy[bk] += resp * w * y ;
+        srwyy[bk] += resp * w * y * y ;
+      }
+    }
+    s.loglik = ll ;
+    if(it == iters) break ;
+    //
+    // M-step
+    //
+    double ptot = 0.0 ;
+    for(int k = 0; k < K; ++k){
+      double nk = 0.0 ;
+      double nw = 0.0 ;
+      double nwy = 0.0 ;
+      double nwyy = 0.0 ;
+      for(int b = 0; b < B; ++b){
+        const int bk = b + B * k ;
+        nk += sr[bk] ;
+        nw += srw[bk] ;
+        nwy += srwy[bk] ;
+        nwyy += srwyy[bk] ;
+      }
+      s.p[k] = nk + 1.0 ;
+      ptot += s.p[k] ;
+      // component estimates from all batches
+      const double mk = nw > 0.0 ? nwy / nw : R_NaN ;
+      const double vk = nk >= 2.0 ? (nwyy - nwy * mk) / nk : R_NaN ;
+      for(int b = 0; b < B; ++b){
+        const int bk = b + B * k ;
+        if(sr[bk] >= 2.0) s.theta[bk] = srwy[bk] / srw[bk] ;
+        else if(mk == mk) s.theta[bk] = mk ;
+        const double m = s.theta[bk] ;
+        // sum of resp * w * (y - m)^2, kept for the pooled variances
+        srwyy[bk] = std::max(srwyy[bk] - 2.0 * m * srwy[bk] + m * m * srw[bk], 0.0) ;
+        if(!d.pooled){
+          const double v = sr[bk] >= 2.0 ? srwyy[bk] / sr[bk] : vk ;
+          if(v == v) s.sigma2[bk] = std::max(v, d.floor) ;
+        }
+      }
+    }
+    for(int k = 0; k < K; ++k) s.p[k] /= ptot ;
+    if(d.pooled){
+      for(int b = 0; b < B; ++b){
+        double nb = 0.0 ;
+        double ssb = 0.0 ;
+        for(int k = 0; k < K; ++k){
+          nb += sr[b + B * k] ;
+          ssb += srwyy[b + B * k] ;
+        }
+        if(nb >= 2.0) s.sigma2[b] = std::max(ssb / nb, d.floor) ;
+      }
+    }
+  }
+}
+
+// order components by their mean across batches
+void relabel(const StartData& d, StartState& s) {
+  const int B = d.B ;
+  const int K = d.K ;
+  std::vector< std::pair<double, int> > order(K) ;
+  for(int k = 0; k < K; ++k){
+    double m = 0.0 ;
+    for(int b = 0; b < B; ++b) m += s.theta[b + B * k] ;
+    order[k] = std::make_pair(m / B, k) ;
+  }
+  std::sort(order.begin(), order.end()) ;
+  std::vector<int> label(K) ;
+  for(int k = 0; k < K; ++k) label[order[k].second] = k ;
+  std::vector<double> theta(s.theta) ;
+  std::vector<double> sigma2(s.sigma2) ;
+  std::vector<double> p(s.p) ;
+  for(int k = 0; k < K; ++k){
+    const int j = order[k].second ;
+    s.p[k] = p[j] ;
+    for(int b = 0; b < B; ++b){
+      s.theta[b + B * k] = theta[b + B * j] ;
+      if(!d.pooled) s.sigma2[b + B * k] = sigma2[b + B * j] ;
+    }
+  }
+  for(int i = 0; i < d.N; ++i) s.z[i] = label[s.z[i]] ;
+}
+
+struct ByLoglik {
+  const std::vector<StartState>* cand ;
+  bool operator()(int a, int b) const {
+    const double la = (*cand)[a].loglik ;
+    const double lb = (*cand)[b].loglik ;
+    if(la != lb) return la > lb ;
+    return a < b ;
+  }
+} ;
+
+bool same_start(const StartState& a, const StartState& b, double tol) {
+  for(size_t j = 0; j < a.theta.size(); ++j){
+    if(std::fabs(a.theta[j] - b.theta[j]) > tol) return false ;
+  }
+  return true ;
+}
+
+}
+
+//
+// A candidate whose means are within 1e-3 standard deviations of a
+// better candidate is used only if there are too few distinct starts.
+// The log likelihoods returned include the density constants.
+//
+std::vector<StartState> find_starts(const double* y, const int* batch, int N,
+                                    int K, int nstarts, int ncandidates,
+                                    int em_iter, double df, bool pooled,
+                                    int nthreads, uint64_t seed) {
+  if(N < 1) throw std::invalid_argument("no data") ;
+  if(K < 1) throw std::invalid_argument("K must be positive") ;
+  if(nstarts < 1) throw std::invalid_argument("nstarts must be positive") ;
+  if(ncandidates < nstarts) ncandidates = nstarts ;
+  if(em_iter < 0) em_iter = 0 ;
+  int B = 0 ;
+  double ybar = 0.0 ;
+  for(int i = 0; i < N; ++i){
+    if(batch[i] < 0) throw std::invalid_argument("batch codes must be positive integers") ;
+    if(batch[i] + 1 > B) B = batch[i] + 1 ;
+    ybar += y[i] ;
+  }
+  ybar /= N ;
+  double vy = 0.0 ;
+  for(int i = 0; i < N; ++i) vy += (y[i] - ybar) * (y[i] - ybar) ;
+  vy = N > 1 ? vy / (N - 1) : 1.0 ;
+  if(!(vy > 0.0)) vy = 1.0 ;
+  StartData d = {y, batch, N, B, K, df, pooled, vy, 1e-4 * vy} ;
+
+  std::vector<StartState> cand(ncandidates) ;
+  const bool normal = df >= NORMAL_LIMIT_DF ;
+#ifdef _OPENMP
+#pragma omp parallel for schedule(dynamic) num_threads(nthreads)
+#endif
+  for(int c = 0; c < ncandidates; ++c){
+    Substream rng(seed, c) ;
+    std::vector<double> centers ;
+    seed_centers(d, rng, centers) ;
+    start_from_centers(d, centers, cand[c]) ;
+    if(normal) em_steps<NormalLimit>(d, em_iter, cand[c]) ;
+    else em_steps<StudentT>(d, em_iter, cand[c]) ;
+    relabel(d, cand[c]) ;
+  }
+
+  std::vector<int> ranked ;
+  for(int c = 0; c < ncandidates; ++c){
+    if(std::isfinite(cand[c].loglik)) ranked.push_back(c) ;
+  }
+  ByLoglik by_loglik = {&cand} ;
+  std::sort(ranked.begin(), ranked.end(), by_loglik) ;
+  if((int) ranked.size() < nstarts) throw std::runtime_error("problem identifying starting values") ;
+  const double tol = 1e-3 * std::sqrt(vy) ;
+  std::vector<int> keep ;
+  std::vector<bool> used(ranked.size(), false) ;
+  for(size_t r = 0; r < ranked.size() && (int) keep.size() < nstarts; ++r){
+    bool dup = false ;
+    for(size_t j = 0; j < keep.size() && !dup; ++j){
+      dup = same_start(cand[ranked[r]], cand[keep[j]], tol) ;
+    }
+    if(dup) continue ;
+    keep.push_back(ranked[r]) ;
+    used[r] = true ;
+  }
+  for(size_t r = 0; r < ranked.size() && (int) keep.size() < nstarts; ++r){
+    if(!used[r]) keep.push_back(ranked[r]) ;
+  }
+  std::sort(keep.begin(), keep.end(), by_loglik) ;
+
+  const double lc = N * (normal ? NormalLimit::log_const(df) : StudentT::log_const(df)) ;
+  std::vector<StartState> out(nstarts) ;
+  for(int j = 0; j < nstarts; ++j){
+    out[j] = cand[keep[j]] ;
+    out[j].loglik += lc ;
+  }
+  return out ;
+}
+
+#ifndef CNPBAYES_STANDALONE
+//
+// Starting values for a batch mixture (see find_starts).  batch
+// contains integer codes 1, ..., B.
+//
+// Returns a list of nstarts lists with elements theta, sigma2, p, z
+// (1-based), and loglik.
+//
+// [[Rcpp::export]]
+Rcpp::List init_starts(Rcpp::NumericVector y, Rcpp::IntegerVector batch, int K,
+                       int nstarts, int ncandidates, int em_iter, double df,
+                       bool pooled = false, int nthreads = 1) {
+  using namespace Rcpp ;
+  RNGScope scope ;
+  const int N = y.size() ;
+  if(batch.size() != N) stop("y and batch must be the same length") ;
+  std::vector<int> b0(N) ;
+  int B = 0 ;
+  for(int i = 0; i < N; ++i){
+    if(batch[i] < 1) stop("batch codes must be positive integers") ;
+    if(batch[i] > B) B = batch[i] ;
+    b0[i] = batch[i] - 1 ;
+  }
+  const uint64_t seed = substream_seed() ;
+  std::vector<StartState> starts =
+    find_starts(y.begin(), N > 0 ? &b0[0] : NULL, N, K, nstarts, ncandidates,
+                em_iter, df, pooled, nthreads, seed) ;
+  List out(nstarts) ;
+  for(int j = 0; j < nstarts; ++j){
+    const StartState& s = starts[j] ;
+    NumericMatrix theta(B, K) ;
+    std::copy(s.theta.begin(), s.theta.end(), theta.begin()) ;
+    IntegerVector z(N) ;
+    for(int i = 0; i < N; ++i) z[i] = s.z[i] + 1 ;
+    SEXP sigma2 ;
+    if(pooled){
+      sigma2 = wrap(s.sigma2) ;
+    } else {
+      NumericMatrix s2(B, K) ;
+      std::copy(s.sigma2.begin(), s.sigma2.end(), s2.begin()) ;
+      sigma2 = s2 ;
+    }
+    out[j] = List::create(Named("theta") = theta,
+                          Named("sigma2") = sigma2,
+                          Named("p") = wrap(s.p),
+                          Named("z") = z,
+                          Named("loglik") = s.loglik) ;
+  }
+  return out ;
+}
+#endif
@@ -0,0 +1,46 @@
+#ifndef _starts_H
+#define _starts_H
+#include "rmath.h"
+#include <vector>
+#include <stdint.h>
+
+//
+// Starting values for the batch mixture models.  A candidate start is
+// seeded by k-means++ on the pooled data (every batch begins from the
+// same K centers) and refined by a few EM steps for the batch
+// t-mixture with the degrees of freedom fixed at dfr.  The E-step
+// computes the responsibilities and the conditional expectations of
+// the t-weights, (df + 1) / (df + r^2); the M-step updates the mixing
+// proportions, the batch-specific means, and the variances (pooled
+// over components for MultiBatchPooled).  A (batch, component) cell
+// with fewer than two expected observations borrows the estimates of
+// the component from all batches.
+//
+// Candidates are refined independently, in parallel, each with its own
+// Substream; the result does not depend on the number of threads.
+//
+// theta and sigma2 are B x K column-major (sigma2 has length B when the
+// variances are pooled), z is 0-based, and components are ordered by
+// their mean across batches.
+//
+struct StartState {
+  std::vector<double> theta ;
+  std::vector<double> sigma2 ;
+  std::vector<double> p ;
+  std::vector<int> z ;
+  double loglik ;
+} ;
+
+//
+// nstarts starting values ranked by log likelihood from ncandidates
+// k-means++ seeds, each refined by em_iter EM steps.  batch is 0-based;
+// the candidates use the streams Substream(seed, c).  Throws
+// std::invalid_argument for bad arguments and std::runtime_error if
+// there are fewer than nstarts candidates with a finite log likelihood.
+//
+std::vector<StartState> find_starts(const double* y, const int* batch, int N,
+                                    int K, int nstarts, int ncandidates,
+                                    int em_iter, double df, bool pooled,
+                                    int nthreads, uint64_t seed) ;
+
+#endif
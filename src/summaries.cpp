@@ -0,0 +1,193 @@
+#include "summaries.h"
+#include <algorithm>
+#include <array>
+
+P2Quantile::P2Quantile(double prob) : p(prob), count(0) {
+  for(int i = 0; i < 5; ++i){
+    q[i] = 0.0 ;
+    n[i] = i + 1.0 ;
+  }
+  np[0] = 1.0 ;
+  np[1] = 1.0 + 2.0 * p ;
+  np[2] = 1.0 + 4.0 * p ;
+  np[3] = 3.0 + 2.0 * p ;
+  np[4] = 5.0 ;
+  dn[0] = 0.0 ;
+  dn[1] = p / 2.0 ;
+  dn[2] = p ;
+  dn[3] = (1.0 + p) / 2.0 ;
+  dn[4] = 1.0 ;
+}
+
+double P2Quantile::parabolic(int i, double d) const {
+  return q[i] + d / (n[i + 1] - n[i - 1]) *
+    ((n[i] - n[i - 1] + d) * (q[i + 1] - q[i]) / (n[i + 1] - n[i]) +
+     (n[i + 1] - n[i] - d) * (q[i] - q[i - 1]) / (n[i] - n[i - 1])) ;
+}
+
+double P2Quantile::linear(int i, int d) const {
+  return q[i] + d * (q[i + d] - q[i]) / (n[i + d] - n[i]) ;
+}
+
+void P2Quantile::add(double x) {
+  if(count < 5){
+    q[count++] = x ;
+    if(count == 5) std::sort(q, q + 5) ;
+    return ;
+  }
+  ++count ;
+  int k ;
+  if(x < q[0]){
+    q[0] = x ;
+    k = 0 ;
+  } else if(x >= q[4]){
+    q[4] = x ;
+    k = 3 ;
+  } else {
+    k = 0 ;
+    while(k < 3 && x >= q[k + 1]) ++k ;
+  }
+  for(int i = k + 1; i < 5; ++i) n[i] += 1.0 ;
+  for(int i = 0; i < 5; ++i) np[i] += dn[i] ;
+  for(int i = 1; i < 4; ++i){
+    double d = np[i] - n[i] ;
+    if((d >= 1.0 && n[i + 1] - n[i] > 1.0) || (d <= -1.0 && n[i - 1] - n[i] < -1.0)){
+      int ds = d > 0 ? 1 : -1 ;
+      double qp = parabolic(i, ds) ;
+      if(q[i - 1] < qp && qp < q[i + 1]) q[i] = qp ;
+      else q[i] = linear(i, ds) ;
+      n[i] += ds ;
+    }
+  }
+}
+
+double P2Quantile::value() const {
+  if(count == 0) return NA_REAL ;
+  if(count >= 5) return q[2] ;
+  // exact quantile (type 7) of the first observations
+  // insertion sort: std::sort on a 5-element array trips -Warray-bounds
+  std::array<double, 5> v ;
+  for(int i = 0; i < count; ++i){
+    int j = i ;
+    for(; j > 0 && v[j - 1] > q[i]; --j) v[j] = v[j - 1] ;
+    v[j] = q[i] ;
+  }
+  double h = (count - 1) * p ;
+  int lo = (int) h ;
+  int hi = std::min(lo + 1, (int) count - 1) ;
+  return v[lo] + (h - lo) * (v[hi] - v[lo]) ;
+}
+
+// p and the increments dn are set by the constructor
+void P2Quantile::save(std::vector<double>& out) const {
+  out.push_back(count) ;
+  out.insert(out.end(), q, q + 5) ;
+  out.insert(out.end(), n, n + 5) ;
+  out.insert(out.end(), np, np + 5) ;
+}
+
+const double* P2Quantile::load(const double* x) {
+  count = (long) x[0] ;
+  std::copy(x + 1, x + 6, q) ;
+  std::copy(x + 6, x + 11, n) ;
+  std::copy(x + 11, x + 16, np) ;
+  return x + 16 ;
+}
+
+BlockSummary::BlockSummary(int L) :
+  moments(L), lower(L, P2Quantile(0.025)), median(L, P2Quantile(0.5)),
+  upper(L, P2Quantile(0.975)) {}
+
+void BlockSummary::add(const double* x) {
+  const int L = moments.size() ;
+  for(int j = 0; j < L; ++j){
+    moments[j].add(x[j]) ;
+    lower[j].add(x[j]) ;
+    median[j].add(x[j]) ;
+    upper[j].add(x[j]) ;
+  }
+}
+
+std::vector<double> BlockSummary::save() const {
+  std::vector<double> out ;
+  for(size_t j = 0; j < moments.size(); ++j){
+    moments[j].save(out) ;
+    lower[j].save(out) ;
+    median[j].save(out) ;
+    upper[j].save(out) ;
+  }
+  return out ;
+}
+
+bool BlockSummary::load(const std::vector<double>& x) {
+  const size_t L = moments.size() ;
+  if(x.size() != L * (3 + 3 * 16)) return false ;
+  const double* p = x.data() ;
+  for(size_t j = 0; j < L; ++j){
+    p = moments[j].load(p) ;
+    p = lower[j].load(p) ;
+    p = median[j].load(p) ;
+    p = upper[j].load(p) ;
+  }
+  return true ;
+}
+
+void AutocorrWindow::add(const double* x) {
+  std::copy(x, x + L, draws.begin() + (size_t) pos * L) ;
+  pos = (pos + 1) % W ;
+  if(count < W) ++count ;
+}
+
+double AutocorrWindow::iat(int j) const {
+  const int n = count ;
+  if(n < 2) return 1.0 ;
+  // the draws of parameter j in the order they were added
+  const int first = count < W ? 0 : pos ;
+  std::vector<double> x(n) ;
+  double mean = 0.0 ;
+  for(int t = 0; t < n; ++t){
+    x[t] = draws[(size_t) ((first + t) % W) * L + j] ;
+    mean += x[t] ;
+  }
+  mean /= n ;
+  double c0 = 0.0 ;
+  for(int t = 0; t < n; ++t){
+    x[t] -= mean ;
+    c0 += x[t] * x[t] ;
+  }
+  if(!(c0 > 0.0)) return 1.0 ;
+  double tau = 1.0 ;
+  for(int lag = 1; lag < n; ++lag){
+    double c = 0.0 ;
+    for(int t = lag; t < n; ++t) c += x[t] * x[t - lag] ;
+    tau += 2.0 * c / c0 ;
+    if(lag >= IAT_WINDOW_C * tau) break ;
+  }
+  return std::max(tau, 1.0) ;
+}
+
+double AutocorrWindow::max_iat() const {
+  double tau = 1.0 ;
+  for(int j = 0; j < L; ++j) tau = std::max(tau, iat(j)) ;
+  return tau ;
+}
+
+#ifndef CNPBAYES_STANDALONE
+Rcpp::List BlockSummary::wrap() const {
+  using namespace Rcpp ;
+  const int L = moments.size() ;
+  NumericVector mn(L), v(L), lo(L), md(L), hi(L) ;
+  for(int j = 0; j < L; ++j){
+    mn[j] = mean(j) ;
+    v[j] = var(j) ;
+    lo[j] = q025(j) ;
+    md[j] = q50(j) ;
+    hi[j] = q975(j) ;
+  }
+  return List::create(Named("mean") = mn,
+                      Named("var") = v,
+                      Named("q2.5") = lo,
+                      Named("q50") = md,
+                      Named("q97.5") = hi) ;
+}
+#endif
@@ -0,0 +1,118 @@
+#ifndef _summaries_H
+#define _summaries_H
+#include "rmath.h"
+#include <vector>
+
+//
+// Posterior summaries accumulated while sampling, so that the modes and
+// the posterior means, variances, medians, and 95% credible intervals
+// of the parameters are available without the stored chains.
+//
+//   RunningMoments  mean and variance (Welford's algorithm)
+//   P2Quantile      the P^2 estimator of a quantile (Jain and Chlamtac,
+//                   1985): five markers, constant memory; exact for
+//                   fewer than five observations
+//   AutocorrWindow  integrated autocorrelation times over the last W
+//                   draws of a parameter block
+//
+// save() appends the state of an accumulator to a vector of doubles
+// and load() restores it, returning the position after the state, so
+// that a sampler resumed from a checkpoint continues its summaries.
+//
+class RunningMoments {
+  long count ;
+  double mean_ ;
+  double m2 ;
+public:
+  RunningMoments() : count(0), mean_(0.0), m2(0.0) {}
+  void add(double x) {
+    ++count ;
+    double d = x - mean_ ;
+    mean_ += d / count ;
+    m2 += d * (x - mean_) ;
+  }
+  double mean() const { return count > 0 ? mean_ : NA_REAL ; }
+  double var() const { return count > 1 ? m2 / (count - 1) : NA_REAL ; }
+  void save(std::vector<double>& out) const {
+    out.push_back(count) ;
+    out.push_back(mean_) ;
+    out.push_back(m2) ;
+  }
+  const double* load(const double* x) {
+    count = (long) x[0] ;
+    mean_ = x[1] ;
+    m2 = x[2] ;
+    return x + 3 ;
+  }
+} ;
+
+class P2Quantile {
+  double p ;
+  long count ;
+  double q[5] ;   // marker heights
+  double n[5] ;   // marker positions
+  double np[5] ;  // desired marker positions
+  double dn[5] ;  // increments of the desired positions
+  double parabolic(int i, double d) const ;
+  double linear(int i, int d) const ;
+public:
+  explicit P2Quantile(double prob = 0.5) ;
+  void add(double x) ;
+  double value() const ;
+  void save(std::vector<double>& out) const ;
+  const double* load(const double* x) ;
+} ;
+
+//
+// Summaries of one parameter block (e.g., the B x K means) of length L.
+//
+class BlockSummary {
+  std::vector<RunningMoments> moments ;
+  std::vector<P2Quantile> lower ;
+  std::vector<P2Quantile> median ;
+  std::vector<P2Quantile> upper ;
+public:
+  explicit BlockSummary(int L = 0) ;
+  void add(const double* x) ;
+  int size() const { return moments.size() ; }
+  double mean(int j) const { return moments[j].mean() ; }
+  double var(int j) const { return moments[j].var() ; }
+  double q025(int j) const { return lower[j].value() ; }
+  double q50(int j) const { return median[j].value() ; }
+  double q975(int j) const { return upper[j].value() ; }
+  // the accumulators of all parameters; load returns false if x does
+  // not have the length of the state of this block
+  std::vector<double> save() const ;
+  bool load(const std::vector<double>& x) ;
+#ifndef CNPBAYES_STANDALONE
+  // list with elements mean, var, q2.5, q50, q97.5
+  Rcpp::List wrap() const ;
+#endif
+} ;
+
+//
+// The last W draws of L parameters, kept in a ring buffer.  iat(j) is
+// the integrated autocorrelation time tau = 1 + 2 sum_t rho(t) of the
+// j-th parameter, with the sum over lags t <= M for the smallest M >=
+// IAT_WINDOW_C * tau(M) (Sokal's automatic window).  A constant
+// parameter has tau = 1.
+//
+const double IAT_WINDOW_C = 5.0 ;
+
+class AutocorrWindow {
+  int L ;
+  int W ;
+  int pos ;
+  int count ;
+  std::vector<double> draws ;  // W x L, row-major
+public:
+  AutocorrWindow(int L_, int W_) :
+    L(L_), W(W_), pos(0), count(0), draws((size_t) L_ * W_) {}
+  void add(const double* x) ;
+  int size() const { return count ; }
+  double iat(int j) const ;
+  // the largest iat over the parameters
+  double max_iat() const ;
+} ;
+
+#endif
@@ -0,0 +1,241 @@
+#include "surrogates.h"
+#include <Rmath.h>
+#include <cmath>
+#include <queue>
+#include <algorithm>
+#ifdef _OPENMP
+#include <omp.h>
+#endif
+
+using namespace Rcpp ;
+
+double psmirnov2x(double d, int m, int n) {
+  if(m > n){
+    int i = n ;
+    n = m ;
+    m = i ;
+  }
+  double md = m ;
+  double nd = n ;
+  double q = (0.5 + floor(d * md * nd - 1e-7)) / (md * nd) ;
+  std::vector<double> u(n + 1) ;
+  for(int j = 0; j <= n; ++j){
+    u[j] = ((j / nd) > q) ? 0 : 1 ;
+  }
+  for(int i = 1; i <= m; ++i){
+    double w = (double)(i) / ((double)(i + n)) ;
+    if((i / md) > q) u[0] = 0 ;
+    else u[0] = w * u[0] ;
+    for(int j = 1; j <= n; ++j){
+      if(fabs(i / md - j / nd) > q) u[j] = 0 ;
+      else u[j] = w * u[j] + u[j - 1] ;
+    }
+  }
+  return u[n] ;
+}
+
+double pkstwo(double x, double tol) {
+  if(x <= 0) return 0.0 ;
+  if(x < 1){
+    int k_max = (int) sqrt(2 - log(tol)) ;
+    double z = - (M_PI_2 * M_PI_4) / (x * x) ;
+    double w = log(x) ;
+    double s = 0 ;
+    for(int k = 1; k < k_max; k += 2) s += exp(k * k * z - w) ;
+    return s / M_1_SQRT_2PI ;
+  }
+  double z = -2 * x * x ;
+  double s = -1 ;
+  int k = 1 ;
+  double old = 0 ;
+  double val = 1 ;
+  while(fabs(old - val) > tol){
+    old = val ;
+    val += 2 * s * exp(z * k * k) ;
+    s *= -1 ;
+    k++ ;
+  }
+  return val ;
+}
+
+KSResult ks_sorted(const std::vector<double>& a, const std::vector<double>& b) {
+  const int m = a.size() ;
+  const int n = b.size() ;
+  KSResult res ;
+  if(m == 0 || n == 0){
+    res.statistic = NA_REAL ;
+    res.pvalue = NA_REAL ;
+    return res ;
+  }
+  int i = 0 ;
+  int j = 0 ;
+  double D = 0.0 ;
+  bool ties = false ;
+  while(i < m && j < n){
+    // advance past all observations equal to the next value so that
+    // ties are evaluated as in ks.test
+    double v = std::min(a[i], b[j]) ;
+    bool ina = false ;
+    bool inb = false ;
+    while(i < m && a[i] == v){
+      if(ina) ties = true ;
+      ina = true ;
+      ++i ;
+    }
+    while(j < n && b[j] == v){
+      if(inb) ties = true ;
+      inb = true ;
+      ++j ;
+    }
+    if(ina && inb) ties = true ;
+    double diff = fabs((double) i / m - (double) j / n) ;
+    if(diff > D) D = diff ;
+  }
+  // once one sample is exhausted the difference can only decrease;
+  // check the remainder of the other sample for ties
+  for(int r = i + 1; r < m && !ties; ++r) if(a[r] == a[r - 1]) ties = true ;
+  for(int r = j + 1; r < n && !ties; ++r) if(b[r] == b[r - 1]) ties = true ;
+  res.statistic = D ;
+  bool exact = ((double) m * n < 10000) && !ties ;
+  double p ;
+  if(exact){
+    p = 1.0 - psmirnov2x(D, m, n) ;
+  } else {
+    p = 1.0 - pkstwo(sqrt((double) m * n / (m + n)) * D) ;
+  }
+  res.pvalue = std::min(1.0, std::max(0.0, p)) ;
+  return res ;
+}
+
+namespace {
+
+struct PairTest {
+  double pvalue ;
+  double statistic ;
+  int i ;
+  int j ;
+  int version_i ;
+  int version_j ;
+} ;
+
+// largest p-value first; ties broken by the smaller statistic and then
+// by the order of the batches
+struct PairOrder {
+  bool operator()(const PairTest& x, const PairTest& y) const {
+    if(x.pvalue != y.pvalue) return x.pvalue < y.pvalue ;
+    if(x.statistic != y.statistic) return x.statistic > y.statistic ;
+    if(x.i != y.i) return x.i > y.i ;
+    return x.j > y.j ;
+  }
+} ;
+
+void test_pairs(const std::vector< std::vector<double> >& samples,
+                std::vector<PairTest>& pairs, int nthreads) {
+  const int n = pairs.size() ;
+#ifdef _OPENMP
+#pragma omp parallel for schedule(dynamic) num_threads(nthreads)
+#endif
+  for(int r = 0; r < n; ++r){
+    KSResult ks = ks_sorted(samples[pairs[r].i], samples[pairs[r].j]) ;
+    pairs[r].statistic = ks.statistic ;
+    pairs[r].pvalue = ks.pvalue ;
+  }
+}
+
+}
+
+//
+// Greedy agglomeration of batches: the pair with the largest KS p-value
+// is merged while that p-value is at least THR.  batch contains integer
+// codes 1, ..., G; ties between pairs are broken in favor of lower
+// codes, so the codes define the preferred order of comparison.
+//
+// All G * (G - 1) / 2 pairs are tested once.  After a merge only the
+// pairs involving the merged batch are re-tested; outdated entries in
+// the priority queue are skipped when popped.
+//
+// Returns the sequence of merges: batch 'from' is merged into batch
+// 'into' (codes refer to the input batches; after a merge 'into'
+// denotes the combined batch).
+//
+// [[Rcpp::export]]
+Rcpp::List ks_merge_batches(Rcpp::NumericVector x, Rcpp::IntegerVector batch,
+                            double THR, int nthreads = 1) {
+  int N = x.size() ;
+  if(batch.size() != N) stop("x and batch must be the same length") ;
+  int G = 0 ;
+  for(int i = 0; i < N; ++i){
+    if(batch[i] < 1) stop("batch codes must be positive integers") ;
+    if(batch[i] > G) G = batch[i] ;
+  }
+  std::vector< std::vector<double> > samples(G) ;
+  for(int i = 0; i < N; ++i) samples[batch[i] - 1].push_back(x[i]) ;
+  for(int g = 0; g < G; ++g) std::sort(samples[g].begin(), samples[g].end()) ;
+  std::vector<int> version(G, 0) ;
+  std::vector<bool> alive(G) ;
+  for(int g = 0; g < G; ++g) alive[g] = samples[g].size() > 0 ;
+
+  std::priority_queue<PairTest, std::vector<PairTest>, PairOrder> queue ;
+  std::vector<PairTest> pairs ;
+  for(int i = 0; i < G; ++i){
+    if(!alive[i]) continue ;
+    for(int j = i + 1; j < G; ++j){
+      if(!alive[j]) continue ;
+      PairTest p = {0.0, 0.0, i, j, 0, 0} ;
+      pairs.push_back(p) ;
+    }
+  }
+  test_pairs(samples, pairs, nthreads) ;
+  for(size_t r = 0; r < pairs.size(); ++r) queue.push(pairs[r]) ;
+
+  std::vector<int> into ;
+  std::vector<int> from ;
+  std::vector<double> pval ;
+  std::vector<double> stat ;
+  while(!queue.empty()){
+    PairTest top = queue.top() ;
+    queue.pop() ;
+    if(!alive[top.i] || !alive[top.j]) continue ;
+    if(version[top.i] != top.version_i || version[top.j] != top.version_j) continue ;
+    if(!(top.pvalue >= THR)) break ;
+    // merge j into i
+    std::vector<double> merged(samples[top.i].size() + samples[top.j].size()) ;
+    std::merge(samples[top.i].begin(), samples[top.i].end(),
+               samples[top.j].begin(), samples[top.j].end(),
+               merged.begin()) ;
+    samples[top.i].swap(merged) ;
+    std::vector<double>().swap(samples[top.j]) ;
+    alive[top.j] = false ;
+    version[top.i]++ ;
+    into.push_back(top.i + 1) ;
+    from.push_back(top.j + 1) ;
+    pval.push_back(top.pvalue) ;
+    stat.push_back(top.statistic) ;
+    pairs.clear() ;
+    for(int l = 0; l < G; ++l){
+      if(!alive[l] || l == top.i) continue ;
+      int a = std::min(l, top.i) ;
+      int b = std::max(l, top.i) ;
+      PairTest p = {0.0, 0.0, a, b, version[a], version[b]} ;
+      pairs.push_back(p) ;
+    }
+    test_pairs(samples, pairs, nthreads) ;
+    for(size_t r = 0; r < pairs.size(); ++r) queue.push(pairs[r]) ;
+  }
+  return List::create(Named("into") = wrap(into),
+                      Named("from") = wrap(from),
+                      Named("p.value") = wrap(pval),
+                      Named("statistic") = wrap(stat)) ;
+}
+
+// KS statistic and p-value for two samples (compare with stats::ks.test)
+// [[Rcpp::export]]
+Rcpp::NumericVector ks_two_sample(Rcpp::NumericVector x, Rcpp::NumericVector y) {
+  std::vector<double> a(x.begin(), x.end()) ;
+  std::vector<double> b(y.begin(), y.end()) ;
+  std::sort(a.begin(), a.end()) ;
+  std::sort(b.begin(), b.end()) ;
+  KSResult ks = ks_sorted(a, b) ;
+  return NumericVector::create(Named("statistic") = ks.statistic,
+                               Named("p.value") = ks.pvalue) ;
+}
@@ -0,0 +1,30 @@
+#ifndef _surrogates_H
+#define _surrogates_H
+#include <Rcpp.h>
+#include <vector>
+
+//
+// Two-sample Kolmogorov-Smirnov tests for combining batches (chemistry
+// plates) with similar distributions of the copy number summary.
+//
+// Each batch is sorted once.  The statistic for a pair of batches is
+// computed by walking the two sorted samples in step, and a merged
+// batch is the linear merge of its two parents.  The p-value follows
+// stats::ks.test: exact when m * n < 10000 and there are no ties,
+// otherwise the asymptotic Kolmogorov distribution.
+//
+struct KSResult {
+  double statistic ;
+  double pvalue ;
+} ;
+
+// a and b must be sorted in increasing order
+KSResult ks_sorted(const std::vector<double>& a, const std::vector<double>& b) ;
+
+// P(D < d) for the exact two-sample distribution (m, n observations)
+double psmirnov2x(double d, int m, int n) ;
+
+// limiting distribution of sqrt(m * n / (m + n)) * D
+double pkstwo(double x, double tol = 1e-6) ;
+
+#endif
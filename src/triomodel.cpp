@@ -4,6 +4,10 @@
 
 #include "miscfunctions.h" // for rdirichlet
 #include "multibatch.h" 
+#include "sampler.h"
+#include "triomodel.h"
+#include "rng.h"
+#include "monitor.h"
 #include <Rmath.h>
 #include <Rcpp.h>
 #include <iostream>
@@ -11,6 +15,9 @@
 #include <algorithm>
 #include <iterator>
 #include <list>
+#ifdef _OPENMP
+#include <omp.h>
+#endif
 
 using namespace Rcpp ;
 //using namespace RcppArmadillo;
@@ -18,8 +25,7 @@ using namespace Rcpp ;
 
 // [[Rcpp::export]]
 Rcpp::CharacterVector family_member(Rcpp::S4 object){
-  RNGScope scope ;
-  Rcpp::S4 model(clone(object)) ;
+  Rcpp::S4 model(object) ;
   Rcpp::DataFrame triodat(model.slot("triodata"));
   IntegerVector batch = model.slot("batch") ;
   int n=batch.size();
@@ -29,33 +35,174 @@ Rcpp::CharacterVector family_member(Rcpp::S4 object){
   return family_member;
 }
 
-// [[Rcpp::export]]
-Rcpp::NumericVector lookup_mprobs(Rcpp::S4 model, int father, int mother){
+TrioIndex trio_index(Rcpp::S4 model){
+  TrioIndex index ;
+  NumericVector x = model.slot("data") ;
+  index.N = x.size() ;
+  bool indexed = false ;
+  if(model.hasSlot("pedigree")){
+    // columns father, mother, and child (1-based rows)
+    IntegerMatrix ped = model.slot("pedigree") ;
+    if(ped.nrow() > 0 && ped.ncol() == 3){
+      index.T = ped.nrow() ;
+      index.father.resize(index.T) ;
+      index.mother.resize(index.T) ;
+      index.child.resize(index.T) ;
+      for(int t = 0; t < index.T; ++t){
+        index.father[t] = ped(t, 0) - 1 ;
+        index.mother[t] = ped(t, 1) - 1 ;
+        index.child[t] = ped(t, 2) - 1 ;
+      }
+      indexed = true ;
+    }
+  }
+  if(!indexed){
+    CharacterVector fam = family_member(model) ;
+    for(int i = 0; i < fam.size(); ++i){
+      if(fam[i] == "f") index.father.push_back(i) ;
+      else if(fam[i] == "m") index.mother.push_back(i) ;
+      else if(fam[i] == "o") index.child.push_back(i) ;
+    }
+    index.T = index.child.size() ;
+  }
+  std::vector<bool>& is_parent = index.is_parent ;
+  is_parent.assign(index.N, false) ;
+  for(size_t t = 0; t < index.father.size(); ++t) is_parent[index.father[t]] = true ;
+  for(size_t t = 0; t < index.mother.size(); ++t) is_parent[index.mother[t]] = true ;
+  index.parents.reserve(index.father.size() + index.mother.size()) ;
+  for(int i = 0; i < index.N; ++i){
+    if(is_parent[i]) index.parents.push_back(i) ;
+  }
+  return index ;
+}
+
+TrioStats trio_stats(Rcpp::S4 model, const TrioIndex& trios){
+  NumericVector x = model.slot("data") ;
+  IntegerVector z = model.slot("z") ;
+  IntegerVector batch = model.slot("batch") ;
+  NumericVector u = model.slot("u") ;
+  NumericMatrix theta = model.slot("theta") ;
+  NumericMatrix mn = model.slot("data.mean") ;
+  TrioStats st ;
+  st.B = theta.nrow() ;
+  st.K = theta.ncol() ;
+  const int BK = st.B * st.K ;
+  st.n.assign(BK, 0.0) ;
+  st.n_par.assign(BK, 0.0) ;
+  st.ss_mean.assign(BK, 0.0) ;
+  st.ss_theta.assign(BK, 0.0) ;
+  st.zfreq.assign(st.K, 0) ;
+  st.zfreq_par.assign(st.K, 0) ;
+  bool has_mean = mn.nrow() == st.B && mn.ncol() == st.K ;
+  for(int i = 0; i < trios.N; ++i){
+    int k = z[i] - 1 ;
+    int j = batch[i] - 1 + st.B * k ;
+    double r = x[i] - theta[j] ;
+    st.n[j] += 1 ;
+    st.zfreq[k] += 1 ;
+    st.ss_theta[j] += u[i] * r * r ;
+    if(has_mean){
+      double d = x[i] - mn[j] ;
+      st.ss_mean[j] += d * d ;
+    }
+    if(trios.is_parent[i]){
+      st.n_par[j] += 1 ;
+      st.zfreq_par[k] += 1 ;
+    }
+  }
+  return st ;
+}
+
+// logical vector of length N that is TRUE for the given rows
+static Rcpp::LogicalVector row_indicator(int N, const std::vector<int>& rows){
+  LogicalVector is_row(N) ;
+  for(size_t i = 0; i < rows.size(); ++i) is_row[rows[i]] = true ;
+  return is_row ;
+}
+
+//
+// Draws a component label for each of the given rows from P (rows x K),
+// in the same way as update_z.  The labels (1-based) are written to
+// znew; returns false if a batch x component cell among the rows has
+// one or fewer observations, in which case znew should be discarded.
+//
+static bool draw_rows(const std::vector<int>& rows, const Rcpp::NumericMatrix& P,
+                      const Rcpp::IntegerVector& batch, int B,
+                      std::vector<int>& znew){
+  int M = rows.size() ;
+  int K = P.ncol() ;
+  NumericVector u = runif(M) ;
+  std::vector<int> freq(B * K, 0) ;
+  znew.assign(M, 0) ;
+  for(int i = 0; i < M; i++){
+    //initialize accumulator ;
+    double acc = 0 ;
+    for(int k = 0; k < K; k++){
+      acc += P(i, k) ;
+      if( u[i] < acc ) {
+        znew[i] = k + 1 ;
+        freq[batch[rows[i]] - 1 + B * k] += 1 ;
+        break ;
+      }
+    }
+  }
+  for(int j = 0; j < B * K; ++j){
+    if(freq[j] <= 1) return false ;
+  }
+  return true ;
+}
+
+Transmission transmission_tensor(Rcpp::S4 model){
+  Transmission trans ;
+  if(model.hasSlot("transmission")){
+    NumericVector tensor = model.slot("transmission") ;
+    IntegerVector dims = tensor.attr("dim") ;
+    if(tensor.size() > 0 && dims.size() == 3){
+      trans.K = dims[0] ;
+      trans.Kp = dims[1] ;
+      trans.tensor = tensor ;
+      trans.data = trans.tensor.begin() ;
+      return trans ;
+    }
+  }
   Rcpp::NumericMatrix mprob = model.slot("mprob");
   IntegerVector f = model.slot("father");
   IntegerVector m = model.slot("mother");
   IntegerVector map = model.slot("maplabel");
-  int fat2 = father - 1;
-  int mot2 = mother - 1;
-  int f2 = map[fat2];
-  int m2 = map[mot2];
-  Rcpp::LogicalVector ind(m.size());
-  Rcpp::LogicalVector ind2(f.size());
-  ind = f == f2;
-  ind2 = m == m2;
-  Rcpp::LogicalVector is_parental_cn(ind.size());
-  is_parental_cn = (ind==TRUE) & (ind2==TRUE) ;
-  int nr=f.size();
-  int j = 0;
-  for(int i = 0; i < nr; i++){
-    if(is_parental_cn[i] == TRUE){
-      j = i ;
-      break;
+  int nr = f.size() ;
+  trans.K = mprob.ncol() ;
+  trans.Kp = map.size() ;
+  NumericVector tensor(trans.K * trans.Kp * trans.Kp) ;
+  for(int mo = 0; mo < trans.Kp; ++mo){
+    for(int fa = 0; fa < trans.Kp; ++fa){
+      // first row of mprob for the parental copy numbers
+      int j = -1 ;
+      for(int i = 0; i < nr; i++){
+        if(f[i] == map[fa] && m[i] == map[mo]){
+          j = i ;
+          break;
+        }
+      }
+      if(j < 0){
+        stop("mprob has no row for father copy number %d and mother copy number %d",
+             map[fa], map[mo]) ;
+      }
+      double* probs = tensor.begin() + trans.K * (fa + trans.Kp * mo) ;
+      for(int o = 0; o < trans.K; ++o) probs[o] = mprob(j, o) ;
     }
   }
-  Rcpp::NumericVector result(mprob.ncol());
-  result=mprob(j, _);
-  return result;
+  trans.tensor = tensor ;
+  trans.data = trans.tensor.begin() ;
+  return trans ;
+}
+
+// Transmission probabilities for the offspring of parents with
+// components father and mother (1-based)
+// [[Rcpp::export]]
+Rcpp::NumericVector lookup_mprobs(Rcpp::S4 model, int father, int mother){
+  Transmission trans = transmission_tensor(model) ;
+  const double* probs = trans.probs(father - 1, mother - 1) ;
+  return NumericVector(probs, probs + trans.K) ;
 }
 
 //
@@ -66,127 +213,89 @@ Rcpp::NumericVector lookup_mprobs(Rcpp::S4 model, int father, int mother){
 //
 // update_trioPr is the Mendelian prob lookup module
 
-// [[Rcpp::export]]
-Rcpp::NumericMatrix update_trioPr(Rcpp::S4 xmod){
-  RNGScope scope ;
-  Rcpp::S4 model(clone(xmod)) ;
-  Rcpp::DataFrame triodat(model.slot("triodata"));
+//
+// The exported kernels below build the pedigree index and the
+// transmission tensor once per call and pass them to static versions
+// that take them as arguments; the samplers (trios_burnin, trios_mcmc)
+// build them once per run.  The kernels read the model without copying
+// it.
+//
+static Rcpp::NumericMatrix trio_pr(Rcpp::S4 model, const TrioIndex& trios,
+                                   const Transmission& trans){
   Rcpp::S4 hypp(model.slot("hyperparams")) ;
   int K = getK(hypp) ;
   IntegerVector z = model.slot("z");
-  CharacterVector fam = family_member(xmod);
-  //std::string level = Rcpp::as<std::string>(level_of_species[0]);
-  Rcpp::LogicalVector fat_ind(fam.size());
-  Rcpp::LogicalVector mat_ind(fam.size());
-  // TODO: repeated with each MCMC
-  for (int i = 0; i < fam.size(); i++){
-    fat_ind[i] = (fam[i] == "f");
-    mat_ind[i] = (fam[i] == "m");
-  }
-  Rcpp::IntegerVector zf = z[fat_ind];
-  Rcpp::IntegerVector zm = z[mat_ind];
-  int trio_size = zf.size();
+  if(trans.K != K) stop("mprob must have one column per component") ;
+  int trio_size = trios.T ;
   Rcpp::NumericMatrix zo_prob(trio_size, K);
-  Rcpp::NumericVector trans_probs(K);
   for (int i = 0; i < trio_size; i++){
-    trans_probs = lookup_mprobs(xmod, zf[i], zm[i]);
-    zo_prob(i,_) = trans_probs ;
+    const double* probs = trans.probs(z[trios.father[i]] - 1, z[trios.mother[i]] - 1) ;
+    for(int k = 0; k < K; ++k) zo_prob(i, k) = probs[k] ;
   }
   return zo_prob;
 }
 
+// [[Rcpp::export]]
+Rcpp::NumericMatrix update_trioPr(Rcpp::S4 xmod){
+  return trio_pr(xmod, trio_index(xmod), transmission_tensor(xmod)) ;
+}
+
 // [[Rcpp::export]]
 Rcpp::LogicalVector is_father(Rcpp::S4 xmod){
-  RNGScope scope ;
-  Rcpp::S4 model(clone(xmod)) ;
-  CharacterVector fam = family_member(model);
-  int N = fam.size() ;
-  LogicalVector is_f(N) ;
-  for (int i = 0; i < N; i++){
-    is_f[i] = (fam[i] == "f");
-  }
-  return is_f ;
+  TrioIndex trios = trio_index(xmod) ;
+  return row_indicator(trios.N, trios.father) ;
 }
 
 // [[Rcpp::export]]
 Rcpp::LogicalVector is_mother(Rcpp::S4 xmod){
-  RNGScope scope ;
-  Rcpp::S4 model(clone(xmod)) ;
-  CharacterVector fam = family_member(model);
-  int N = fam.size() ;
-  LogicalVector is_f(N) ;
-  for (int i = 0; i < N; i++){
-    is_f[i] = (fam[i] == "m");
-  }
-  return is_f ;
+  TrioIndex trios = trio_index(xmod) ;
+  return row_indicator(trios.N, trios.mother) ;
 }
 
 // [[Rcpp::export]]
 Rcpp::LogicalVector is_child(Rcpp::S4 xmod){
-  RNGScope scope ;
-  Rcpp::S4 model(clone(xmod)) ;
-  CharacterVector fam = family_member(model);
-  int N = fam.size() ;
-  LogicalVector is_f(N) ;
-  for (int i = 0; i < N; i++){
-    is_f[i] = (fam[i] == "o");
-  }
-  return is_f ;
+  TrioIndex trios = trio_index(xmod) ;
+  return row_indicator(trios.N, trios.child) ;
 }
 
-// [[Rcpp::export]]
-Rcpp::NumericMatrix update_trioPr2(Rcpp::S4 xmod){
-  RNGScope scope ;
-  Rcpp::S4 model(clone(xmod)) ;
-  Rcpp::DataFrame triodat(model.slot("triodata"));
+static Rcpp::NumericMatrix trio_pr2(Rcpp::S4 model, const TrioIndex& trios,
+                                    const Transmission& trans){
   Rcpp::S4 hypp(model.slot("hyperparams")) ;
   IntegerVector is_mendelian=model.slot("is_mendelian") ;
   int K = getK(hypp) ;
   IntegerVector z = model.slot("z");
   NumericVector p = model.slot("pi");
-  CharacterVector fam = family_member(model);
-  LogicalVector is_f=is_father(model) ;
-  LogicalVector is_m=is_mother(model) ;
-  //LogicalVector is_o=is_child(model) ;
-  Rcpp::IntegerVector zf = z[is_f];
-  Rcpp::IntegerVector zm = z[is_m];
-  int T = zf.size();
+  if(trans.K != K) stop("mprob must have one column per component") ;
+  int T = trios.T ;
   Rcpp::NumericMatrix zo_prob(T, K);
-  Rcpp::NumericVector probs(K);
-  LogicalVector is_mendel(T);
-  is_mendel = is_mendelian == 1 ;
   for (int i = 0; i < T; i++){
-    if(is_mendel[i]){
-      probs = lookup_mprobs(model, zf[i], zm[i]) ;
-    } else {
-      probs = p ;
+    const double* probs = p.begin() ;
+    if(is_mendelian[i] == 1){
+      probs = trans.probs(z[trios.father[i]] - 1, z[trios.mother[i]] - 1) ;
     }
-    zo_prob(i, _) = probs ;
+    for(int k = 0; k < K; ++k) zo_prob(i, k) = probs[k] ;
   }
   return zo_prob;
 }
 
+// [[Rcpp::export]]
+Rcpp::NumericMatrix update_trioPr2(Rcpp::S4 xmod){
+  return trio_pr2(xmod, trio_index(xmod), transmission_tensor(xmod)) ;
+}
+
 // [[Rcpp::export]]
 Rcpp::IntegerVector update_mendelian(Rcpp::S4 xmod) {
   RNGScope scope ;
-  Rcpp::S4 model(clone(xmod)) ;
+  Rcpp::S4 model(xmod) ;
   IntegerVector z = model.slot("z");
-  CharacterVector fam = family_member(xmod);
-  Rcpp::LogicalVector child_ind(fam.size());
-  Rcpp::LogicalVector fat_ind(fam.size());
-  Rcpp::LogicalVector mat_ind(fam.size());
-  // TODO: repeated with each MCMC
-  for (int i = 0; i < fam.size(); i++){
-    child_ind[i] = (fam[i] == "o");
-  }
-  Rcpp::IntegerVector zo = z[child_ind];
+  TrioIndex trios = trio_index(model) ;
   // TODO: prior probability for mendelian indicator
-  double m_prior = 0.9 ;
+  double m_prior = MENDEL_PRIOR ;
   double numer;
   double denom;
-  NumericMatrix ptrio = update_trioPr(model) ;
+  NumericMatrix ptrio = trio_pr(model, trios, transmission_tensor(model)) ;
   NumericVector p = model.slot("pi_parents") ;
-  int T=zo.size() ;
+  int T=trios.T ;
   IntegerVector mendel(T);
   double prob_mendel ;
   NumericVector u(1) ;
@@ -195,7 +304,7 @@ Rcpp::IntegerVector update_mendelian(Rcpp::S4 xmod) {
   //                       p(M=1)/(p(z_0 | z_m, z_f, M=1)P(M=1) +
   //                       p(z_0 | M=0)P(M=0))
   for(int i=0; i < T; ++i){
-    cn = zo[i] - 1;
+    cn = z[trios.child[i]] - 1;
     numer=ptrio(i, _)[ cn ] * m_prior;
     denom=numer + p[ cn ] * (1-m_prior) ;
     prob_mendel = numer/denom ;
@@ -209,10 +318,7 @@ Rcpp::IntegerVector update_mendelian(Rcpp::S4 xmod) {
   return mendel;
 }
 
-// [[Rcpp::export]]
-Rcpp::NumericMatrix update_multinomialPrPar(Rcpp::S4 xmod) {
-  RNGScope scope ;
-  Rcpp::S4 model(clone(xmod)) ;
+static Rcpp::NumericMatrix parent_probs(Rcpp::S4 model, const TrioIndex& trios) {
   Rcpp::S4 hypp(model.slot("hyperparams")) ;
   int K = getK(hypp) ;
   IntegerVector batch = model.slot("batch") ;
@@ -225,176 +331,94 @@ Rcpp::NumericMatrix update_multinomialPrPar(Rcpp::S4 xmod) {
   NumericVector x = model.slot("data") ;
   IntegerVector nb = model.slot("batchElements") ;;
   double df = getDf(hypp) ;
-  CharacterVector fam = family_member(xmod);
-  Rcpp::LogicalVector child_ind(fam.size());
-  for (int i = 0; i < fam.size(); i++){
-    child_ind[i] = (fam[i] == "o");
-  }
-
-  Rcpp::NumericVector xp = x[!child_ind];
-  int M = xp.size() ;
-  NumericMatrix lik(M, K) ;
-  NumericVector this_batch(M) ;
-  NumericVector tmp(M) ;
-  NumericVector rowtotal(M) ;
-
-  for(int k = 0; k < K; ++k){
-    NumericVector dens(M) ;
-    for(int b = 0; b < B; ++b){
-      this_batch = batch == ub[b] ;
-      double sigma = sqrt(sigma2(b, k));
-      //tmp = p[k] * pp[k] * dlocScale_t(xp, df, theta(b, k), sigma) * this_batch ;
-      //tmp = ((p[k]+pp[k])/2) * dlocScale_t(xp, df, theta(b, k), sigma) * this_batch ;
-      tmp = p[k] * dlocScale_t(xp, df, theta(b, k), sigma) * this_batch ;
-      dens += tmp ;
-    }
-    lik(_, k) = dens ;
-    rowtotal += dens ;
-  }
-
+  int M = trios.parents.size() ;
+  std::vector<int> bindex(x.size()) ;
+  for(int i = 0; i < x.size(); ++i) bindex[i] = batch[i] - 1 ;
   NumericMatrix PP(M, K) ;
-  for(int k=0; k<K; ++k){
-    PP(_, k) = lik(_, k)/rowtotal ;
+  //tmp = p[k] * pp[k] * dlocScale_t(xp, df, theta(b, k), sigma) * this_batch ;
+  //tmp = ((p[k]+pp[k])/2) * dlocScale_t(xp, df, theta(b, k), sigma) * this_batch ;
+  if(df >= NORMAL_LIMIT_DF){
+    component_probs<NormalLimit>(K, M, B, x.begin(), bindex.data(), theta.begin(),
+                                 sigma2.begin(), p.begin(), 0, 1, df, PP.begin(),
+                                 trios.parents.data()) ;
+  } else {
+    component_probs<StudentT>(K, M, B, x.begin(), bindex.data(), theta.begin(),
+                              sigma2.begin(), p.begin(), 0, 1, df, PP.begin(),
+                              trios.parents.data()) ;
   }
   return PP ;
 }
 
+// [[Rcpp::export]]
+Rcpp::NumericMatrix update_multinomialPrPar(Rcpp::S4 xmod) {
+  return parent_probs(xmod, trio_index(xmod)) ;
+}
+
 // [[Rcpp::export]]
 Rcpp::IntegerVector update_parents(Rcpp::S4 xmod){
   RNGScope scope ;
-  Rcpp::S4 model(clone(xmod)) ;
-  Rcpp::S4 hypp(model.slot("hyperparams")) ;
-  int K = getK(hypp) ;
-  Rcpp::DataFrame triodat(model.slot("triodata"));
+  Rcpp::S4 model(xmod) ;
   NumericMatrix theta = model.slot("theta") ;
   IntegerVector batch = model.slot("batch") ;
   int B = theta.nrow() ;
-  CharacterVector fam = family_member(xmod);
-  Rcpp::LogicalVector child_ind(fam.size());
-  for (int i = 0; i < fam.size(); i++){
-    child_ind[i] = (fam[i] == "o");
-  }
   IntegerVector z = model.slot("z");
-  Rcpp::IntegerVector zp = z[!child_ind];
-  int parents_size = zp.size();
-  NumericMatrix p(parents_size, K);
-  p = update_multinomialPrPar(xmod) ;  // number trios x K
-  
-  //NumericMatrix cumP(n, K) ;
-  //  Make more efficient
-  //return cumP ;
-  NumericVector upar = runif(parents_size) ;
-  IntegerVector zpar_(parents_size) ;
-  IntegerVector zpar = clone(zpar_) ;
-  IntegerMatrix freq(B, K) ;
-  
-  int b ;
-  for(int i=0; i < parents_size; i++){
-    //initialize accumulator ;
-    double acc = 0 ;
-    for(int k = 0; k < K; k++){
-      acc += p(i, k) ;
-      if( upar[i] < acc ) {
-        zpar[i] = k + 1 ;
-        b = batch[i] - 1 ;
-        freq(b, k) += 1 ;
-        break ;
-      }
-    }
-  }
-  if(is_true(all(freq > 1))){
-    return zpar ;
-  } else{
-    return zp ;
+  TrioIndex trios = trio_index(model) ;
+  int parents_size = trios.parents.size() ;
+  NumericMatrix p = parent_probs(model, trios) ;  // number parents x K
+  std::vector<int> zpar ;
+  IntegerVector zp(parents_size) ;
+  if(draw_rows(trios.parents, p, batch, B, zpar)){
+    std::copy(zpar.begin(), zpar.end(), zp.begin()) ;
+  } else {
+    for(int i = 0; i < parents_size; i++) zp[i] = z[trios.parents[i]] ;
   }
-}  
+  return zp ;
+}
 
 // [[Rcpp::export]]
 Rcpp::IntegerVector update_zparents(Rcpp::S4 xmod) {
   RNGScope scope ;
-  Rcpp::S4 model(clone(xmod)) ;
-  Rcpp::IntegerVector ztrio = model.slot("z");
-  
-  //Rcpp::CharacterVector family_member=triodat["family_member"];
-  // Rcpp::LogicalVector is_offspring;
-  CharacterVector fam = family_member(xmod);
-  Rcpp::LogicalVector child_ind(fam.size());
-  for (int i = 0; i < fam.size(); i++){
-    child_ind[i] = (fam[i] == "o");
-  }
-  // return child_ind;
-  
-  IntegerVector zz_parents;
-  zz_parents = update_parents(model); 
-  int n = ztrio.size() ;
-  int j = 0;
-  for(int i = 0; i < n; i++){
-    if(child_ind[i] == FALSE){
-      ztrio[i] = zz_parents[j];
-      j++;
-    }
+  Rcpp::S4 model(xmod) ;
+  // the labels are returned in a copy
+  Rcpp::IntegerVector ztrio = clone(IntegerVector(model.slot("z")));
+  NumericMatrix theta = model.slot("theta") ;
+  IntegerVector batch = model.slot("batch") ;
+  TrioIndex trios = trio_index(model) ;
+  NumericMatrix p = parent_probs(model, trios) ;
+  std::vector<int> zpar ;
+  // labels are only replaced if every batch x component cell is
+  // represented by more than one parent
+  if(draw_rows(trios.parents, p, batch, theta.nrow(), zpar)){
+    for(size_t i = 0; i < zpar.size(); i++) ztrio[trios.parents[i]] = zpar[i] ;
   }
   return ztrio;
 }
 
 // [[Rcpp::export]]
 Rcpp::IntegerVector tableZpar(Rcpp::S4 xmod){
-  RNGScope scope ;
-  Rcpp::S4 model(clone(xmod)) ;
-  Rcpp::S4 hypp(model.slot("hyperparams")) ;
-  int K = getK(hypp) ;
-  CharacterVector fam = family_member(xmod);
-  Rcpp::LogicalVector child_ind(fam.size());
-  for (int i = 0; i < fam.size(); i++){
-    child_ind[i] = (fam[i] == "o");
-  }
-  IntegerVector z = model.slot("z");
-  Rcpp::IntegerVector zp = z[!child_ind];
-  
-  Rcpp::IntegerVector nn(K) ;
-  for(int k = 0; k < K; k++){
-    nn[k] = sum(zp == (k+1)) ;
-  }
-  return nn ;
+  Rcpp::S4 model(xmod) ;
+  TrioStats st = trio_stats(model, trio_index(model)) ;
+  return wrap(st.zfreq_par) ;
 }
 
 // [[Rcpp::export]]
 Rcpp::NumericMatrix tableBatchZpar(Rcpp::S4 xmod){
-  RNGScope scope ;
   Rcpp::S4 model(xmod) ;
-  int K = getK(model.slot("hyperparams")) ;
-  CharacterVector fam = family_member(xmod);
-  Rcpp::LogicalVector child_ind(fam.size());
-  for (int i = 0; i < fam.size(); i++){
-    child_ind[i] = (fam[i] == "o");
-  }
-  IntegerVector z = model.slot("z");
-  Rcpp::IntegerVector zp = z[!child_ind];
-  IntegerVector batch = model.slot("batch") ;
-  IntegerVector ub = unique_batch(batch) ;
-  int B = ub.size() ;
-  NumericMatrix nn(B, K) ;
-  for(int j = 0; j < B; ++j){
-    for(int k = 0; k < K; k++){
-      nn(j, k) = sum((zp == (k+1)) & (batch == ub[j]));
-    }
-  }
+  TrioStats st = trio_stats(model, trio_index(model)) ;
+  NumericMatrix nn(st.B, st.K) ;
+  std::copy(st.n_par.begin(), st.n_par.end(), nn.begin()) ;
   return nn ;
 }
 
 // this is update for pi_parents only
 
-// [[Rcpp::export]]
-Rcpp::NumericVector update_pp(Rcpp::S4 xmod) {
-  RNGScope scope ;
-  Rcpp::S4 model(clone(xmod)) ;
+static Rcpp::NumericVector draw_pp(Rcpp::S4 model, const TrioIndex& trios) {
   Rcpp::S4 hypp(model.slot("hyperparams")) ;
   int K = getK(hypp) ;
-  // IntegerVector z = model.slot("z") ;  
-  IntegerVector nn = model.slot("zfreq_parents");
+  TrioStats st = trio_stats(model, trios) ;
   IntegerVector alpha = hypp.slot("alpha") ;
   NumericVector alpha_n(K) ;  // really an integer vector, but rdirichlet expects numeric
-  for(int k=0; k < K; k++) alpha_n[k] = alpha[k] + nn[k] ;
+  for(int k=0; k < K; k++) alpha_n[k] = alpha[k] + st.zfreq_par[k] ;
   NumericVector pp(K) ;
   // pass by reference
   rdirichlet(alpha_n, pp) ;
@@ -402,6 +426,12 @@ Rcpp::NumericVector update_pp(Rcpp::S4 xmod) {
   //  return alpha_n ;
 }
 
+// [[Rcpp::export]]
+Rcpp::NumericVector update_pp(Rcpp::S4 xmod) {
+  RNGScope scope ;
+  return draw_pp(xmod, trio_index(xmod)) ;
+}
+
 
 
 //NumericVector mendelprobs(Rcpp::S4 xmod, int father, int mother, int offspring, NumericVector trioprob){
@@ -502,16 +532,14 @@ Rcpp::NumericVector update_pp(Rcpp::S4 xmod) {
 //   return mendelmat;
 // }
 
-// [[Rcpp::export]]
-Rcpp::NumericMatrix update_multinomialPrChild(Rcpp::S4 xmod) {
-  RNGScope scope ;
-  Rcpp::S4 model(clone(xmod)) ;
+static Rcpp::NumericMatrix child_probs(Rcpp::S4 model, const TrioIndex& trios,
+                                       const Transmission& trans) {
   Rcpp::S4 hypp(model.slot("hyperparams")) ;
   int K = getK(hypp) ;
   IntegerVector batch = model.slot("batch") ;
   IntegerVector ub = unique_batch(batch) ;
   // Mendelian transmission probability matrix
-  NumericMatrix ptrio = update_trioPr2(xmod) ;
+  NumericMatrix ptrio = trio_pr2(model, trios, trans) ;
   NumericVector p = model.slot("pi") ;
   // commented by RS: pp is not unused
   //NumericVector pp = model.slot("pi_parents") ;
@@ -521,116 +549,67 @@ Rcpp::NumericMatrix update_multinomialPrChild(Rcpp::S4 xmod) {
   NumericVector x = model.slot("data") ;
   IntegerVector nb = model.slot("batchElements") ;
   double df = getDf(hypp) ;
-  CharacterVector fam = family_member(xmod);
-  Rcpp::LogicalVector child_ind(fam.size());
   // TODO:
   // double p_mendel=0.9;
-  // TODO: we do this with each MCMC iteration
-  for (int i = 0; i < fam.size(); i++){
-    child_ind[i] = (fam[i] == "o");
-  }
-  Rcpp::NumericVector xo = x[child_ind];
   // Mendelian observations
-  int M = xo.size() ;
-  NumericMatrix lik(M, K) ;
-  NumericVector this_batch(M) ;
-  NumericVector tmp(M) ;
-  NumericVector tmp2(M) ;
-  NumericVector rowtotal(M) ;
-  // MC:  why do we multiply ptrio by p[k]?
-  for(int k = 0; k < K; ++k){
-    NumericVector dens(M) ;
-    for(int b = 0; b < B; ++b){
-      this_batch = batch == ub[b] ;
-      //tmp = p[k] * ptrio(_,k) *
-      //      dlocScale_t(xo, df, theta(b, k), sigma) * this_batch ;
-      double sigma = sqrt(sigma2(b, k));
-      NumericVector phi=dlocScale_t(xo, df, theta(b, k), sigma);
-      tmp = ptrio(_, k) * phi * this_batch ;
-      //tmp = ptrio(_, k) * phi * this_batch * (1 - p_mendel) ;
-      //tmp2 = p[k] * phi * this_batch * p_mendel ;
-      //tmp = tmp + tmp2 ;
-      dens += tmp ;
-    }
-    lik(_, k) = dens;
-    rowtotal += dens ;
-  }
+  int M = trios.T ;
+  std::vector<int> bindex(x.size()) ;
+  for(int i = 0; i < x.size(); ++i) bindex[i] = batch[i] - 1 ;
   NumericMatrix PC(M, K) ;
-  for(int k=0; k < K; ++k){
-    PC(_, k) = lik(_, k)/rowtotal ;
+  // weights are the Mendelian transmission probabilities (M x K)
+  if(df >= NORMAL_LIMIT_DF){
+    component_probs<NormalLimit>(K, M, B, x.begin(), bindex.data(), theta.begin(),
+                                 sigma2.begin(), ptrio.begin(), 1, M, df, PC.begin(),
+                                 trios.child.data()) ;
+  } else {
+    component_probs<StudentT>(K, M, B, x.begin(), bindex.data(), theta.begin(),
+                              sigma2.begin(), ptrio.begin(), 1, M, df, PC.begin(),
+                              trios.child.data()) ;
   }
   return PC;
 }
 
+// [[Rcpp::export]]
+Rcpp::NumericMatrix update_multinomialPrChild(Rcpp::S4 xmod) {
+  return child_probs(xmod, trio_index(xmod), transmission_tensor(xmod)) ;
+}
+
 
 // [[Rcpp::export]]
 Rcpp::IntegerVector update_offspring(Rcpp::S4 xmod){
   RNGScope scope ;
-  Rcpp::S4 model(clone(xmod)) ;
-  Rcpp::S4 hypp(model.slot("hyperparams")) ;
-  int K = getK(hypp) ;
-  Rcpp::DataFrame triodat(model.slot("triodata"));
+  Rcpp::S4 model(xmod) ;
   NumericMatrix theta = model.slot("theta") ;
   IntegerVector batch = model.slot("batch") ;
   int B = theta.nrow() ;
-  CharacterVector fam = family_member(xmod);
-  Rcpp::LogicalVector child_ind(fam.size());
-  // TODO: This is unchanging, yet we do it with each MCMC iteration
-  for (int i = 0; i < fam.size(); i++){
-    child_ind[i] = (fam[i] == "o");
-  }
   IntegerVector z = model.slot("z");
-  Rcpp::IntegerVector zo = z[child_ind];
-  int child_size = zo.size();
-  NumericMatrix p(child_size, K);
-  p = update_multinomialPrChild(xmod) ;
-  NumericVector uc = runif(child_size) ;
-  IntegerVector zc_(child_size) ;
-  IntegerVector zc = clone(zc_) ;
-  IntegerMatrix freq(B, K) ;
-  int b ;
-  for(int i=0; i < child_size; i++){
-    //initialize accumulator ;
-    double acc = 0 ;
-    for(int k = 0; k < K; k++){
-      acc += p(i, k) ;
-      if( uc[i] < acc ) {
-        zc[i] = k + 1 ;
-        b = batch[i] - 1 ;
-        freq(b, k) += 1 ;
-        break ;
-      }
-    }
-  }
-  if(is_true(all(freq > 1))){
-    return zc ;
+  TrioIndex trios = trio_index(model) ;
+  int child_size = trios.T ;
+  NumericMatrix p = child_probs(model, trios, transmission_tensor(model)) ;
+  std::vector<int> zchild ;
+  IntegerVector zc(child_size) ;
+  if(draw_rows(trios.child, p, batch, B, zchild)){
+    std::copy(zchild.begin(), zchild.end(), zc.begin()) ;
   } else {
-    return zo;
+    for(int i = 0; i < child_size; i++) zc[i] = z[trios.child[i]] ;
   }
+  return zc ;
 }
 
 
 // [[Rcpp::export]]
 Rcpp::IntegerVector update_zchild(Rcpp::S4 xmod) {
   RNGScope scope ;
-  S4 model(clone(xmod)) ;
-  IntegerVector ztrio = model.slot("z");
-  IntegerVector zz_offspring ;
-  CharacterVector fam = family_member(xmod);
-  LogicalVector child_ind(fam.size());
-  // TODO:  This is unchanging, yet we do it every MCMC iteration
-  for (int i = 0; i < fam.size(); i++){
-     child_ind[i] = (fam[i] == "o");
-  }
-  //
-  zz_offspring = update_offspring(model); // length 300
-  int n = ztrio.size() ;
-  int j = 0;
-  for(int i = 0; i < n; i++){
-    if(child_ind[i] == TRUE){
-      ztrio[i] = zz_offspring[j];
-      ++j;
-    }
+  S4 model(xmod) ;
+  // the labels are returned in a copy
+  IntegerVector ztrio = clone(IntegerVector(model.slot("z")));
+  NumericMatrix theta = model.slot("theta") ;
+  IntegerVector batch = model.slot("batch") ;
+  TrioIndex trios = trio_index(model) ;
+  NumericMatrix p = child_probs(model, trios, transmission_tensor(model)) ;
+  std::vector<int> zchild ;
+  if(draw_rows(trios.child, p, batch, theta.nrow(), zchild)){
+    for(size_t i = 0; i < zchild.size(); i++) ztrio[trios.child[i]] = zchild[i] ;
   }
   return ztrio;
 }
@@ -638,8 +617,7 @@ Rcpp::IntegerVector update_zchild(Rcpp::S4 xmod) {
 // [[Rcpp::export]]
 Rcpp::NumericVector update_mu2(Rcpp::S4 xmod){
   RNGScope scope ;
-  Rcpp::S4 model_(xmod);
-  Rcpp::S4 model = clone(model_);
+  Rcpp::S4 model(xmod);
   Rcpp::S4 hypp(model.slot("hyperparams")) ;
   int K = getK(hypp) ;
   double tau2_0 = hypp.slot("tau2.0") ;
@@ -648,14 +626,9 @@ Rcpp::NumericVector update_mu2(Rcpp::S4 xmod){
 
   NumericVector tau2 = model.slot("tau2") ;
   NumericVector tau2_tilde = 1/tau2 ;
-  IntegerVector z = model.slot("z") ;
   NumericMatrix theta = model.slot("theta") ;
-  // below line not referenced anywhere in function
-  // IntegerVector nn = model.slot("zfreq") ;
-  
-  IntegerVector batch = model.slot("batch") ;
-  IntegerVector ub = unique_batch(batch) ;
-  int B = ub.size() ;
+  TrioStats st = trio_stats(model, trio_index(model)) ;
+  int B = st.B ;
   
   NumericVector tau2_B_tilde(K) ;;
   for(int k = 0; k < K; ++k) tau2_B_tilde[k] = tau2_0_tilde + B*tau2_tilde[k] ;
@@ -666,16 +639,16 @@ Rcpp::NumericVector update_mu2(Rcpp::S4 xmod){
     w1[k] = tau2_0_tilde/(tau2_0_tilde + B*tau2_tilde[k]) ;
     w2[k] = B*tau2_tilde[k]/(tau2_0_tilde + B*tau2_tilde[k]) ;
   }
-  NumericMatrix n_b = tableBatchZpar(model) ;
+  // parents only
+  const double* n_b = st.n_par.data() ;
   NumericVector theta_bar(K) ;
-  NumericVector th(K) ;
   
   for(int k = 0; k < K; ++k){
     double n_k = 0.0 ; // number of observations for component k
     double colsumtheta = 0.0;
     for(int i = 0; i < B; ++i){
-      colsumtheta += n_b(i, k)*theta(i, k) ;
-      n_k += n_b(i, k) ;
+      colsumtheta += n_b[i + B * k]*theta(i, k) ;
+      n_k += n_b[i + B * k] ;
     }
     theta_bar[k] = colsumtheta/n_k ;
   }
@@ -701,34 +674,20 @@ Rcpp::NumericVector update_mu2(Rcpp::S4 xmod){
 
 // [[Rcpp::export]]
 Rcpp::NumericMatrix compute_vars2(Rcpp::S4 xmod) {
-  RNGScope scope ;
-  Rcpp::S4 model(clone(xmod)) ;
-  NumericVector x = model.slot("data") ;
-  int n = x.size() ;
-  IntegerVector z = model.slot("z") ;
-  Rcpp::S4 hypp(model.slot("hyperparams")) ;
-  int K = getK(hypp) ;
-  // line below not referenced anywhere here
-  // IntegerVector nn = model.slot("zfreq") ;
-  IntegerVector batch = model.slot("batch") ;
-  IntegerVector ub = unique_batch(batch) ;
-  int B = ub.size() ;
-  NumericMatrix vars(B, K) ;
-  NumericMatrix tabz = tableBatchZpar(model) ;
-  NumericMatrix mn = model.slot("data.mean") ;
-  NumericVector this_batch(n) ;
-  NumericVector is_z(n) ;
+  Rcpp::S4 model(xmod) ;
   NumericVector tau2 = model.slot("tau2") ;
-  NumericVector total(1) ;
+  TrioStats st = trio_stats(model, trio_index(model)) ;
+  int B = st.B ;
+  int K = st.K ;
+  NumericMatrix vars(B, K) ;
+  // sum of squares over all samples, degrees of freedom from the parents
   for(int b = 0; b < B; ++b){
-    this_batch = batch == ub[b] ;
     for(int k = 0; k < K; ++k){
-      is_z = z == (k + 1) ;
-      total[0] = sum(is_z * this_batch) ;
-      if(total[0] <= 1){
+      int j = b + B * k ;
+      if(st.n[j] <= 1){
         vars(b, k) = tau2[k] ;
       } else {
-        vars(b, k) = sum(pow(x - mn(b,k), 2.0) * this_batch * is_z) / (tabz(b, k) - 1) ;
+        vars(b, k) = st.ss_mean[j] / (st.n_par[j] - 1) ;
       }
     }
   }
@@ -737,8 +696,7 @@ Rcpp::NumericMatrix compute_vars2(Rcpp::S4 xmod) {
 
 // [[Rcpp::export]]
 Rcpp::NumericMatrix compute_prec2(Rcpp::S4 xmod){
-  RNGScope scope ;
-  Rcpp::S4 model(clone(xmod)) ;
+  Rcpp::S4 model(xmod) ;
   NumericMatrix vars = compute_vars2(model) ;
   int B = vars.nrow() ;
   int K = vars.ncol() ;
@@ -751,23 +709,17 @@ Rcpp::NumericMatrix compute_prec2(Rcpp::S4 xmod){
   return prec ;
 }
 
-// [[Rcpp::export]]
-Rcpp::IntegerMatrix update_probzpar(Rcpp::S4 xmod){
-  RNGScope scope ;
-  Rcpp::S4 model(clone(xmod)) ;
+//
+// Adds the current labels of the given rows to the counts pZ (rows x K)
+// in place, with columns ordered by the means of the first batch.
+//
+static void add_probz(Rcpp::S4 model, const std::vector<int>* rows,
+                      Rcpp::IntegerMatrix pZ){
   Rcpp::S4 hypp(model.slot("hyperparams")) ;
   int K = hypp.slot("k") ;
-  CharacterVector fam = family_member(xmod);
-  Rcpp::LogicalVector child_ind(fam.size());
-  // TODO:  this is re-computed at every MCMC iteration
-  for (int i = 0; i < fam.size(); i++){
-    child_ind[i] = (fam[i] == "o");
-  }
   IntegerVector z = model.slot("z");
-  Rcpp::IntegerVector zp = z[!child_ind];
   NumericMatrix theta = model.slot("theta") ;
-  int N = zp.size() ;
-  IntegerMatrix pZ = model.slot("probz_par") ;
+  int N = rows ? rows->size() : z.size() ;
   //
   // update probz such that the z value corresponding to the lowest
   // mean is 1, the second lowest mean is 2, etc.
@@ -781,12 +733,18 @@ Rcpp::IntegerMatrix update_probzpar(Rcpp::S4 xmod){
   cn = order_(means) ;
   for(int k = 0; k < K; ++k) cn[k] = cn[k] - 1 ;
   for(int i = 0; i < N; ++i){
-    for(int k = 0; k < K; ++k){
-      if(zp[i] == (k + 1)){
-        pZ(i, cn[k]) += 1;
-      }
-    }
+    int zi = z[rows ? (*rows)[i] : i] ;
+    pZ(i, cn[zi - 1]) += 1 ;
   }
+}
+
+// [[Rcpp::export]]
+Rcpp::IntegerMatrix update_probzpar(Rcpp::S4 xmod){
+  Rcpp::S4 model(xmod) ;
+  TrioIndex trios = trio_index(model) ;
+  // the counts are returned in a copy
+  IntegerMatrix pZ = clone(IntegerMatrix(model.slot("probz_par"))) ;
+  add_probz(model, &trios.parents, pZ) ;
   return pZ ;
 }
 
@@ -794,42 +752,16 @@ Rcpp::IntegerMatrix update_probzpar(Rcpp::S4 xmod){
 // [[Rcpp::export]]
 Rcpp::NumericMatrix update_sigma22(Rcpp::S4 xmod){
   Rcpp::RNGScope scope;
-  Rcpp::S4 model(clone(xmod)) ;
+  Rcpp::S4 model(xmod) ;
   // get model
   // get parameter estimates
-  Rcpp::NumericMatrix theta = model.slot("theta");
-  Rcpp::IntegerVector z = model.slot("z");
   double nu_0 = model.slot("nu.0");
   double sigma2_0 = model.slot("sigma2.0");
-  
-  // get data and size attributes
-  Rcpp::NumericVector x = model.slot("data");
-  int n = x.size();
-  int K = theta.ncol();
-  int B = theta.nrow();
-  NumericVector u = model.slot("u") ;
   double df = getDf(model.slot("hyperparams")) ;
-  
-  //IntegerVector nn = model.slot("zfreq");
-  // get batch info
-  Rcpp::NumericMatrix tabz = tableBatchZpar(model);
-  Rcpp::IntegerVector batch = model.slot("batch");
-  Rcpp::IntegerVector ub = unique_batch(batch);
-  Rcpp::NumericMatrix ss(B, K);
-  
-  for (int i = 0; i < n; ++i) {
-    for (int b = 0; b < B; ++b) {
-      if (batch[i] != ub[b]) {
-        continue;
-      }
-      for (int k = 0; k < K; ++k){
-        if((z[i] == k+1) & (batch[i] == b+1)){
-          ss(b, k) += u[i] * pow(x[i] - theta(b, k), 2);
-          //ss(b, k) += pow(x[i] - theta(b, k), 2);
-        }
-      }
-    }
-  }
+  // counts of parents and u-weighted sums of squares of all samples
+  TrioStats st = trio_stats(model, trio_index(model)) ;
+  int K = st.K ;
+  int B = st.B ;
   
   //NumericMatrix sigma2_nh(B, K);
   double shape;
@@ -840,8 +772,8 @@ Rcpp::NumericMatrix update_sigma22(Rcpp::S4 xmod){
   Rcpp::NumericMatrix sigma2_(B, K);
   for (int b = 0; b < B; ++b) {
     for (int k = 0; k < K; ++k) {
-      nu_n = nu_0 + tabz(b, k);
-      sigma2_nh = 1.0/nu_n*(nu_0*sigma2_0 + ss(b, k)/df);
+      nu_n = nu_0 + st.n_par[b + B * k];
+      sigma2_nh = 1.0/nu_n*(nu_0*sigma2_0 + st.ss_theta[b + B * k]/df);
       // sigma2_nh = 1.0/nu_n*(nu_0*sigma2_0 + ss(b, k));
       shape = 0.5 * nu_n;
       rate = shape * sigma2_nh;
@@ -872,10 +804,8 @@ Rcpp::IntegerVector sample_trio_components(Rcpp::IntegerVector x, int size, Rcpp
   return(z);
 }
 
-//[[Rcpp::export]]
-Rcpp::S4 predictive_trios(Rcpp::S4 xmod){
-  Rcpp::RNGScope scope;
-  Rcpp::S4 model(clone(xmod)) ;
+// sets the predictive and zstar slots of model
+static void trio_predictive(Rcpp::S4 model){
   Rcpp::NumericMatrix theta = model.slot("theta");
   Rcpp::NumericMatrix sigma2 = model.slot("sigma2");
   Rcpp::NumericVector prob = model.slot("pi");
@@ -910,44 +840,315 @@ Rcpp::S4 predictive_trios(Rcpp::S4 xmod){
   }
   model.slot("predictive") = yy;
   model.slot("zstar") = zz ;
+}
+
+//[[Rcpp::export]]
+Rcpp::S4 predictive_trios(Rcpp::S4 xmod){
+  Rcpp::RNGScope scope;
+  Rcpp::S4 model(Rf_shallow_duplicate(xmod)) ;
+  trio_predictive(model) ;
   return model ;
 }
 
+//
+// Draws a component for an observation x in batch b with prior weights
+// w; d is a work buffer of length K.  Returns the current label when
+// all of the weighted densities underflow.
+//
+template <class L>
+static inline int draw_component(double x, int b, int B, int K,
+                                 const double* theta, const double* sigma,
+                                 const double* w, double df, double u,
+                                 double* d, int current){
+  double total = 0.0 ;
+  for(int k = 0; k < K; ++k){
+    double r = (x - theta[b + B * k]) / sigma[b + B * k] ;
+    d[k] = w[k] * exp(L::log_kernel(r, df)) / sigma[b + B * k] ;
+    total += d[k] ;
+  }
+  if(!(total > 0)) return current ;
+  double target = u * total ;
+  double acc = 0.0 ;
+  for(int k = 0; k < K; ++k){
+    acc += d[k] ;
+    if(target < acc) return k ;
+  }
+  return K - 1 ;
+}
+
+//
+// TRUE if every batch x component cell of the per-thread counts nb
+// (nthr x BK) has more than one observation
+//
+static bool cells_filled(const std::vector<int>& nb, int nthr, int BK){
+  for(int j = 0; j < BK; ++j){
+    int n = 0 ;
+    for(int r = 0; r < nthr; ++r) n += nb[r * BK + j] ;
+    if(n <= 1) return false ;
+  }
+  return true ;
+}
+
+//
+// Given theta, sigma2, pi, and pi_parents, the families are
+// conditionally independent.  The labels are updated in three passes
+// over the families, as in the sequence update_z, update_zchild,
+// update_mendelian of the original sampler:
+//
+//   1. the components of all members are drawn from the mixture.  The
+//      new labels are rejected if a batch x component cell has one or
+//      fewer observations among all samples (update_z);
+//   2. the offspring's components are drawn with weights given by the
+//      transmission tensor at the parents' labels (or pi if the
+//      offspring is not Mendelian).  These are rejected if a cell has
+//      one or fewer offspring (update_zchild);
+//   3. the Mendelian indicators are drawn given the labels.
+//
+// Families are processed in blocks of TRIO_BLOCK per thread and the
+// cell counts are accumulated per thread.  Family t draws from the
+// Substream (seed, t + pass * T), so the result does not depend on
+// nthreads.  z and mendel (1-based labels and 0/1 indicators) are
+// updated in place; returns false if the first pass was rejected.
+//
+template <class L>
+static bool sweep_families(const TrioIndex& trios, const Transmission& trans,
+                           const double* x, const int* batch,
+                           const double* theta, const double* sigma,
+                           const double* p, const double* pp, int B, int K,
+                           double df, uint64_t seed, int nthreads,
+                           int* z, int* mendel){
+  const int T = trios.T ;
+  const int BK = B * K ;
+  int nthr = 1 ;
+#ifdef _OPENMP
+  nthr = std::max(1, nthreads) ;
+#endif
+  std::vector<int> zf(T), zm(T), zo(T) ;
+  std::vector<int> nb(nthr * BK, 0) ;
+  std::vector<int> nc(nthr * BK, 0) ;
+  // pass 1: all members from the mixture
+#ifdef _OPENMP
+#pragma omp parallel num_threads(nthr)
+#endif
+  {
+    int tid = 0 ;
+#ifdef _OPENMP
+    tid = omp_get_thread_num() ;
+#endif
+    int* cell = &nb[tid * BK] ;
+    std::vector<double> d(K) ;
+#ifdef _OPENMP
+#pragma omp for schedule(static, TRIO_BLOCK)
+#endif
+    for(int t = 0; t < T; ++t){
+      Substream rng(seed, t) ;
+      int f = trios.father[t] ;
+      int m = trios.mother[t] ;
+      int o = trios.child[t] ;
+      zf[t] = draw_component<L>(x[f], batch[f], B, K, theta, sigma, p, df,
+                                rng.unif(), d.data(), z[f] - 1) ;
+      zm[t] = draw_component<L>(x[m], batch[m], B, K, theta, sigma, p, df,
+                                rng.unif(), d.data(), z[m] - 1) ;
+      zo[t] = draw_component<L>(x[o], batch[o], B, K, theta, sigma, p, df,
+                                rng.unif(), d.data(), z[o] - 1) ;
+      cell[batch[f] + B * zf[t]] += 1 ;
+      cell[batch[m] + B * zm[t]] += 1 ;
+      cell[batch[o] + B * zo[t]] += 1 ;
+    }
+  }
+  bool ok = cells_filled(nb, nthr, BK) ;
+  if(ok){
+    for(int t = 0; t < T; ++t){
+      z[trios.father[t]] = zf[t] + 1 ;
+      z[trios.mother[t]] = zm[t] + 1 ;
+      z[trios.child[t]] = zo[t] + 1 ;
+    }
+  }
+  // pass 2: offspring given the parents
+#ifdef _OPENMP
+#pragma omp parallel num_threads(nthr)
+#endif
+  {
+    int tid = 0 ;
+#ifdef _OPENMP
+    tid = omp_get_thread_num() ;
+#endif
+    int* cell = &nc[tid * BK] ;
+    std::vector<double> d(K) ;
+#ifdef _OPENMP
+#pragma omp for schedule(static, TRIO_BLOCK)
+#endif
+    for(int t = 0; t < T; ++t){
+      Substream rng(seed, t + (uint64_t) T) ;
+      int o = trios.child[t] ;
+      const double* w = p ;
+      if(mendel[t] == 1){
+        w = trans.probs(z[trios.father[t]] - 1, z[trios.mother[t]] - 1) ;
+      }
+      zo[t] = draw_component<L>(x[o], batch[o], B, K, theta, sigma, w, df,
+                                rng.unif(), d.data(), z[o] - 1) ;
+      cell[batch[o] + B * zo[t]] += 1 ;
+    }
+  }
+  if(cells_filled(nc, nthr, BK)){
+    for(int t = 0; t < T; ++t) z[trios.child[t]] = zo[t] + 1 ;
+  }
+  // pass 3: Mendelian indicators
+#ifdef _OPENMP
+#pragma omp parallel for schedule(static, TRIO_BLOCK) num_threads(nthr)
+#endif
+  for(int t = 0; t < T; ++t){
+    Substream rng(seed, t + 2 * (uint64_t) T) ;
+    int cn = z[trios.child[t]] - 1 ;
+    const double* tp = trans.probs(z[trios.father[t]] - 1, z[trios.mother[t]] - 1) ;
+    double numer = tp[cn] * MENDEL_PRIOR ;
+    double denom = numer + pp[cn] * (1 - MENDEL_PRIOR) ;
+    mendel[t] = rng.unif() <= numer / denom ? 1 : 0 ;
+  }
+  return ok ;
+}
+
+void trio_sweep(Rcpp::S4 model, const TrioIndex& trios,
+                const Transmission& trans, int nthreads){
+  Rcpp::S4 hypp(model.slot("hyperparams")) ;
+  int K = getK(hypp) ;
+  double df = getDf(hypp) ;
+  NumericVector x = model.slot("data") ;
+  IntegerVector batch = model.slot("batch") ;
+  NumericMatrix theta = model.slot("theta") ;
+  NumericMatrix sigma2 = model.slot("sigma2") ;
+  NumericVector p = model.slot("pi") ;
+  NumericVector pp = model.slot("pi_parents") ;
+  IntegerVector z0 = model.slot("z") ;
+  IntegerVector mendel0 = model.slot("is_mendelian") ;
+  if(trans.K != K) stop("mprob must have one column per component") ;
+  int B = theta.nrow() ;
+  int N = x.size() ;
+  std::vector<int> bindex(N) ;
+  for(int i = 0; i < N; ++i) bindex[i] = batch[i] - 1 ;
+  std::vector<double> sigma(B * K) ;
+  for(int j = 0; j < B * K; ++j) sigma[j] = sqrt(sigma2[j]) ;
+  IntegerVector z = clone(z0) ;
+  IntegerVector mendel = clone(mendel0) ;
+  // the only draw from R's generator
+  uint64_t seed = substream_seed() ;
+  bool ok ;
+  if(df >= NORMAL_LIMIT_DF){
+    ok = sweep_families<NormalLimit>(trios, trans, x.begin(), bindex.data(),
+                                     theta.begin(), sigma.data(), p.begin(),
+                                     pp.begin(), B, K, df, seed, nthreads,
+                                     z.begin(), mendel.begin()) ;
+  } else {
+    ok = sweep_families<StudentT>(trios, trans, x.begin(), bindex.data(),
+                                  theta.begin(), sigma.data(), p.begin(),
+                                  pp.begin(), B, K, df, seed, nthreads,
+                                  z.begin(), mendel.begin()) ;
+  }
+  if(!ok){
+    //
+    // Don't update z if there are states with zero frequency.
+    //
+    int counter = model.slot(".internal.counter");
+    counter++;
+    model.slot(".internal.counter") = counter;
+  }
+  std::vector<int> zfreq_par(K, 0) ;
+  for(size_t i = 0; i < trios.parents.size(); ++i) zfreq_par[z[trios.parents[i]] - 1] += 1 ;
+  model.slot("z") = z ;
+  model.slot("is_mendelian") = mendel ;
+  model.slot("zfreq") = tableZ(K, z) ;
+  model.slot("zfreq_parents") = wrap(zfreq_par) ;
+}
+
+//
+// One family-parallel update of the component labels and Mendelian
+// indicators.  Threads are only used if the package was built with
+// OpenMP.
+//
 // [[Rcpp::export]]
-Rcpp::S4 trios_burnin(Rcpp::S4 object, Rcpp::S4 mcmcp) {
+Rcpp::S4 update_trios(Rcpp::S4 xmod, int nthreads = 1){
   RNGScope scope ;
-  Rcpp::S4 model(clone(object)) ;
+  Rcpp::S4 model(Rf_shallow_duplicate(xmod)) ;
+  trio_sweep(model, trio_index(model), transmission_tensor(model), nthreads) ;
+  return model ;
+}
+
+//
+// One scan of the trio sampler without saving: z, is_mendelian, zfreq,
+// and zfreq_parents (trio_sweep), then the parameters in the order of
+// trios_mcmc.  mu is drawn before tau2 during burnin and after it when
+// thinning.
+//
+static void trio_scan(Rcpp::S4 model, const TrioIndex& trios,
+                      const Transmission& trans, int nthreads, int N,
+                      double df, SamplerProfile* prof, bool tau2_first) {
+  { ProfileTimer t(prof, PROF_Z) ; trio_sweep(model, trios, trans, nthreads) ; }
+  { ProfileTimer t(prof, PROF_SIGMA2) ; model.slot("sigma2") = update_sigma2(model) ; }
+  { ProfileTimer t(prof, PROF_NU0) ; model.slot("nu.0") = update_nu0(model) ; }
+  { ProfileTimer t(prof, PROF_SIGMA20) ; model.slot("sigma2.0") = update_sigma20(model) ; }
+  { ProfileTimer t(prof, PROF_THETA) ; model.slot("theta") = update_theta(model) ; }
+  if(tau2_first){
+    { ProfileTimer t(prof, PROF_TAU2) ; model.slot("tau2") = update_tau2(model) ; }
+    { ProfileTimer t(prof, PROF_MU) ; model.slot("mu") = update_mu(model) ; }
+  } else {
+    { ProfileTimer t(prof, PROF_MU) ; model.slot("mu") = update_mu(model) ; }
+    { ProfileTimer t(prof, PROF_TAU2) ; model.slot("tau2") = update_tau2(model) ; }
+  }
+  {
+    ProfileTimer t(prof, PROF_PI) ;
+    model.slot("pi_parents") = draw_pp(model, trios) ;
+    model.slot("pi") = update_p(model) ;
+  }
+  { ProfileTimer t(prof, PROF_U) ; model.slot("u") = Rcpp::rchisq(N, df) ; }
+}
+
+// adds the timings to the chains of the (already copied) model
+static void add_trio_profile(Rcpp::S4 model, const SamplerProfile& prof,
+                             const std::string& phase) {
+  Rcpp::S4 chain(Rf_shallow_duplicate(model.slot("mcmc.chains"))) ;
+  if(!chain.hasSlot("profile")) return ;
+  chain.slot("profile") = prof.add_to(chain.slot("profile"), phase) ;
+  model.slot("mcmc.chains") = chain ;
+}
+
+//
+// The burnin runs burnin - 1 scans; start > 0 resumes after start scans
+// from a checkpoint (see resumeMcmc).
+//
+// [[Rcpp::export]]
+Rcpp::S4 trios_burnin(Rcpp::S4 object, Rcpp::S4 mcmcp, int nthreads = 1,
+                      int start = 0) {
+  RNGScope scope ;
+  // the slots are replaced rather than modified
+  Rcpp::S4 model(Rf_shallow_duplicate(object)) ;
   Rcpp::S4 hypp(model.slot("hyperparams")) ;
   int K = getK(hypp) ;
   Rcpp::S4 params(mcmcp) ;
   IntegerVector up = params.slot("param_updates") ;
   int S = params.slot("burnin") ;
+  TrioIndex trios = trio_index(model) ;
+  Transmission trans = transmission_tensor(model) ;
   NumericVector x = model.slot("data") ;
   int N = x.size() ;
   double df = getDf(model.slot("hyperparams")) ;
-  for(int s = 1; s < S; ++s){
-    model.slot("z") = update_z(model) ;
-    model.slot("zfreq_parents") = tableZpar(model) ;
-    model.slot("sigma2") = update_sigma2(model) ;
-    model.slot("nu.0") = update_nu0(model) ;
-    model.slot("sigma2.0") = update_sigma20(model) ;
-    model.slot("z") = update_zchild(model) ;
-    model.slot("is_mendelian") = update_mendelian(model) ;
-    model.slot("zfreq") = tableZ(K, model.slot("z")) ;
-    model.slot("theta") = update_theta(model) ;
-    model.slot("mu") = update_mu(model) ;
-    model.slot("tau2") = update_tau2(model) ;
-    model.slot("pi_parents") = update_pp(model) ;
-    model.slot("pi") = update_p(model) ;
-    model.slot("u") = Rcpp::rchisq(N, df) ;
+  SamplerProfile prof(profiling(mcmcp)) ;
+  SamplerMonitor mon(mcmcp, "burnin", S - 1) ;
+  for(int s = start + 1; s < S; ++s){
+    trio_scan(model, trios, trans, nthreads, N, df, &prof, false) ;
+    if(mon.checkpoint_due(s)) mon.checkpoint(model, s) ;
+    if(mon.poll(s)) break ;
   }
   NumericVector lls2(1);
   NumericVector ll(1);
-  lls2 = stageTwoLogLikBatch(model);
-  ll = compute_loglik(model);
-  ll = ll + lls2;
-  model.slot("loglik") = ll;
-  model.slot("logprior") = compute_logprior(model) ;
+  {
+    ProfileTimer t(&prof, PROF_LOGLIK) ;
+    lls2 = stageTwoLogLikBatch(model);
+    ll = compute_loglik(model);
+    ll = ll + lls2;
+    model.slot("loglik") = ll;
+    model.slot("logprior") = compute_logprior(model) ;
+  }
+  if(prof.enabled) add_trio_profile(model, prof, "burnin") ;
   return model ;
 }
 
@@ -963,9 +1164,19 @@ Rcpp::IntegerVector test_trio(Rcpp::S4 object) {
 }
 
 // [[Rcpp::export]]
-Rcpp::S4 trios_mcmc(Rcpp::S4 object, Rcpp::S4 mcmcp) {
+Rcpp::S4 trios_mcmc(Rcpp::S4 object, Rcpp::S4 mcmcp, int nthreads = 1,
+                    int start = 0) {
   RNGScope scope ;
-  Rcpp::S4 model(clone(object)) ;
+  // the chains and the counts of probz and probz_par are written in
+  // place; the other slots are replaced rather than modified
+  Rcpp::S4 model(Rf_shallow_duplicate(object)) ;
+  model.slot("mcmc.chains") = clone(Rcpp::S4(object.slot("mcmc.chains"))) ;
+  IntegerMatrix probz = clone(IntegerMatrix(object.slot("probz"))) ;
+  IntegerMatrix probz_par = clone(IntegerMatrix(object.slot("probz_par"))) ;
+  model.slot("probz") = probz ;
+  model.slot("probz_par") = probz_par ;
+  TrioIndex trios = trio_index(model) ;
+  Transmission trans = transmission_tensor(model) ;
   Rcpp::S4 chain(model.slot("mcmc.chains")) ;
   Rcpp::S4 hypp(model.slot("hyperparams")) ;
   Rcpp::S4 params(mcmcp) ;
@@ -1014,82 +1225,107 @@ Rcpp::S4 trios_mcmc(Rcpp::S4 object, Rcpp::S4 mcmcp) {
   IntegerVector zp(K) ;
   NumericVector ystar = NumericVector(B*K);
   IntegerVector zstar = IntegerVector(B*K);
-  for(int s = 0; s < (S + 1); ++s){
-    // update z for every one (independence)
-    z = update_z(model) ;
-    model.slot("z") = z ;
+  SamplerProfile prof(profiling(mcmcp)) ;
+  SamplerMonitor mon(mcmcp, "mcmc", S + 1) ;
+  for(int s = start; s < (S + 1); ++s){
+    // parents, offspring, and Mendelian indicators by family
+    {
+      ProfileTimer t(&prof, PROF_Z) ;
+      trio_sweep(model, trios, trans, nthreads) ;
+    }
     // z frequency of parents
-    tmp = tableZpar(model) ;
-    model.slot("zfreq_parents") = tmp ;
+    tmp = model.slot("zfreq_parents") ;
     zfreq_parents(s, _) = tmp ;
-    // updates integer matrix of slot probz for only the parents
-    model.slot("probz_par") = update_probzpar(model) ;
-    // updates z slot only for the offspring
-    z = update_zchild(model) ;
-    model.slot("z") = z ;
-    model.slot("probz") = update_probz(model) ;
-    tmp = tableZ(K, model.slot("z")) ;
-    // updates integer matrix of slot probz for all individuals
-    model.slot("zfreq") = tmp ;
+    {
+      ProfileTimer t(&prof, PROF_PROBZ) ;
+      // updates integer matrix of slot probz for only the parents
+      add_probz(model, &trios.parents, probz_par) ;
+      // updates integer matrix of slot probz for all individuals
+      add_probz(model, NULL, probz) ;
+    }
+    tmp = model.slot("zfreq") ;
     zfreq(s, _) = tmp ;
-    temp = update_mendelian(model) ;
-    model.slot("is_mendelian") = temp ;
+    temp = model.slot("is_mendelian") ;
     mendelian_ = mendelian_ + temp ;
 
-    model.slot("sigma2") = update_sigma2(model) ;
+    {
+      ProfileTimer t(&prof, PROF_SIGMA2) ;
+      model.slot("sigma2") = update_sigma2(model) ;
+    }
     sigma2c(s, _) = as<Rcpp::NumericVector>(model.slot("sigma2"));
-    n0 = update_nu0(model) ;
+    {
+      ProfileTimer t(&prof, PROF_NU0) ;
+      n0 = update_nu0(model) ;
+    }
     model.slot("nu.0") = n0 ;
     nu0[s] = n0[0] ;
-    s20 = update_sigma20(model) ;
+    {
+      ProfileTimer t(&prof, PROF_SIGMA20) ;
+      s20 = update_sigma20(model) ;
+    }
     model.slot("sigma2.0") = s20 ;
     sigma2_0[s] = s20[0] ;
-    model.slot("theta") = update_theta(model) ;
+    {
+      ProfileTimer t(&prof, PROF_THETA) ;
+      model.slot("theta") = update_theta(model) ;
+    }
     thetac(s, _) = as<Rcpp::NumericVector>(model.slot("theta")) ;
-    t2 = update_tau2(model) ;
+    {
+      ProfileTimer t(&prof, PROF_TAU2) ;
+      t2 = update_tau2(model) ;
+    }
     model.slot("tau2") = t2 ;
     tau2(s, _) = t2 ;
-    m = update_mu(model) ;
+    {
+      ProfileTimer t(&prof, PROF_MU) ;
+      m = update_mu(model) ;
+    }
     model.slot("mu") = m ;
     mu(s, _) = m ;
-    pp = update_pp(model) ;
-    model.slot("pi_parents") = pp ;
+    {
+      ProfileTimer t(&prof, PROF_PI) ;
+      pp = draw_pp(model, trios) ;
+      model.slot("pi_parents") = pp ;
+      p = update_p(model) ;
+    }
     //pmix_parents(s, _) = pp ;
-    p = update_p(model) ;
     model.slot("pi") = p ;
     pmix(s, _) = p ;
-    ll = compute_loglik(model) ;
-    lls2 = stageTwoLogLikBatch(model) ;
-    ll = ll + lls2 ;
+    {
+      ProfileTimer t(&prof, PROF_LOGLIK) ;
+      ll = compute_loglik(model) ;
+      lls2 = stageTwoLogLikBatch(model) ;
+      ll = ll + lls2 ;
+      lp = compute_logprior(model) ;
+    }
     loglik_[s] = ll[0] ;
     model.slot("loglik") = ll ;
-    lp = compute_logprior(model) ;
     logprior_[s] = lp[0] ;
     model.slot("logprior") = lp ;
-    u = Rcpp::rchisq(N, df) ;
+    {
+      ProfileTimer t(&prof, PROF_U) ;
+      u = Rcpp::rchisq(N, df) ;
+    }
     model.slot("u") = u;
-    model = predictive_trios(model);
+    {
+      ProfileTimer t(&prof, PROF_PREDICTIVE) ;
+      trio_predictive(model) ;
+    }
     ystar = model.slot("predictive");
     zstar = model.slot("zstar");
     predictive_(s, _) = ystar ;
     zstar_(s, _) = zstar ;
     // Thinning
     for(int t = 0; t < T; ++t){
-      model.slot("z") = update_z(model) ;
-      model.slot("zfreq_parents") = tableZpar(model) ;
-      model.slot("sigma2") = update_sigma2(model) ;
-      model.slot("nu.0") = update_nu0(model) ;
-      model.slot("sigma2.0") = update_sigma20(model) ;
-      model.slot("z") = update_zchild(model) ;
-      model.slot("is_mendelian") = update_mendelian(model) ;
-      model.slot("zfreq") = tableZ(K, model.slot("z")) ;
-      model.slot("theta") = update_theta(model) ;
-      model.slot("tau2") = update_tau2(model) ;
-      model.slot("mu") = update_mu(model) ;
-      model.slot("pi_parents") = update_pp(model) ;
-      model.slot("pi") = update_p(model) ;
-      model.slot("u") = Rcpp::rchisq(N, df) ;
+      trio_scan(model, trios, trans, nthreads, N, df, &prof, true) ;
     }
+    if(mon.checkpoint_due(s + 1)){
+      // the Mendelian counts are not updated in place
+      chain.slot("is_mendelian") = mendelian_ ;
+      model.slot("mcmc.chains") = chain ;
+      mon.checkpoint(model, s + 1) ;
+    }
+    if(mon.poll(s + 1)) break ;
   }
   //
   // assign chains back to object
@@ -1107,6 +1343,9 @@ Rcpp::S4 trios_mcmc(Rcpp::S4 object, Rcpp::S4 mcmcp) {
   chain.slot("loglik") = loglik_ ;
   chain.slot("logprior") = logprior_ ;
   chain.slot("is_mendelian") = mendelian_ ;
+  if(prof.enabled && chain.hasSlot("profile")){
+    chain.slot("profile") = prof.add_to(chain.slot("profile"), "mcmc") ;
+  }
   model.slot("mcmc.chains") = chain ;
   return model ;
 }
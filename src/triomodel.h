@@ -0,0 +1,87 @@
+#ifndef _triomodel_H
+#define _triomodel_H
+#include <Rcpp.h>
+#include <vector>
+
+//
+// Pedigree index of a TrioBatchModel.  Rows are 0-based indices into
+// the data; father[t], mother[t] and child[t] are the members of trio t.
+// parents lists the rows of all fathers and mothers in the order they
+// appear in the data -- the order used by the parent-specific vectors
+// and matrices (e.g., probz_par).  child is also in data order.
+//
+// The index is computed once in R (slot 'pedigree') when the model is
+// constructed.  Models without the slot fall back to a scan of the
+// family_member column of triodata.
+//
+struct TrioIndex {
+  int N ;
+  int T ;
+  std::vector<int> father ;
+  std::vector<int> mother ;
+  std::vector<int> child ;
+  std::vector<int> parents ;
+  std::vector<bool> is_parent ;
+} ;
+
+TrioIndex trio_index(Rcpp::S4 model) ;
+
+//
+// Mendelian transmission probabilities indexed by component (0-based):
+// probs(f, m)[o] is p(offspring component o | father f, mother m).
+// The K x Kp x Kp tensor is the 'transmission' slot computed in R at
+// construction; for models without the slot it is built here from
+// mprob, father, mother, and maplabel.
+//
+struct Transmission {
+  int K ;
+  int Kp ;
+  Rcpp::NumericVector tensor ;
+  const double* data ;
+  const double* probs(int f, int m) const {
+    return data + K * (f + Kp * m) ;
+  }
+} ;
+
+Transmission transmission_tensor(Rcpp::S4 model) ;
+
+//
+// Sufficient statistics of a trio model from one pass over the data.
+// Matrices are B x K column-major, indexed by (batch, component).  The
+// '_par' statistics are restricted to the parents.
+//
+//   n          counts, all samples
+//   n_par      counts, parents
+//   zfreq      component counts, all samples
+//   zfreq_par  component counts, parents
+//   ss_mean    sum of (x - data.mean(b, k))^2, all samples
+//   ss_theta   sum of u * (x - theta(b, k))^2, all samples
+//
+struct TrioStats {
+  int B ;
+  int K ;
+  std::vector<double> n ;
+  std::vector<double> n_par ;
+  std::vector<int> zfreq ;
+  std::vector<int> zfreq_par ;
+  std::vector<double> ss_mean ;
+  std::vector<double> ss_theta ;
+} ;
+
+TrioStats trio_stats(Rcpp::S4 model, const TrioIndex& trios) ;
+
+// prior probability that an offspring's copy number is Mendelian
+const double MENDEL_PRIOR = 0.9 ;
+
+// number of consecutive families assigned to a thread in trio_sweep
+const int TRIO_BLOCK = 64 ;
+
+//
+// Updates z (all members), is_mendelian, zfreq, zfreq_parents, and the
+// internal counter of model in place.  The index and the transmission
+// tensor are built once per sampler run.  See triomodel.cpp.
+//
+void trio_sweep(Rcpp::S4 model, const TrioIndex& trios,
+                const Transmission& trans, int nthreads) ;
+
+#endif